@@ -0,0 +1,85 @@
+#include "base/buffer.h"
+
+#include <errno.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace avrtc {
+
+/**
+ * 丢弃已经处理完的可读数据
+ * @param length 丢弃的字节数，不超过可读字节数
+ */
+void Buffer::Retrieve(size_t length) {
+    if (length < ReadableBytes()) {
+        read_index_ += length;
+    } else {
+        RetrieveAll();
+    }
+}
+
+/**
+ * 追加数据到缓冲区尾部
+ * @param data 数据地址
+ * @param length 数据长度
+ */
+void Buffer::Append(const char* data, size_t length) {
+    EnsureWritable(length);
+    memcpy(BeginWrite(), data, length);
+    HasWritten(length);
+}
+
+/**
+ * 保证至少有length字节的可写空间
+ * 优先把可读数据挪到头部复用已读空间，不够时才扩容
+ * @param length 需要的可写字节数
+ */
+void Buffer::EnsureWritable(size_t length) {
+    if (WritableBytes() >= length) {
+        return;
+    }
+    size_t readable = ReadableBytes();
+    if (read_index_ + WritableBytes() >= length) {
+        memmove(buffer_.data(), Peek(), readable);
+    } else {
+        std::vector<char> grown(
+            std::max(buffer_.size() * 2, readable + length));
+        memcpy(grown.data(), Peek(), readable);
+        buffer_.swap(grown);
+    }
+    read_index_ = 0;
+    write_index_ = readable;
+}
+
+/**
+ * 从文件描述符读取数据到缓冲区尾部
+ * 使用readv同时读入缓冲区剩余空间和栈上的临时空间，
+ * 一次系统调用尽量读完内核中的数据，又不必预先分配大块内存
+ * @param fd 文件描述符
+ * @param saved_errno 读取失败时保存errno
+ * @return 读取的字节数，0表示对端关闭，-1表示失败
+ */
+ssize_t Buffer::ReadFd(int fd, int* saved_errno) {
+    char extra_buffer[65536];
+    struct iovec vec[2];
+    size_t writable = WritableBytes();
+    vec[0].iov_base = BeginWrite();
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extra_buffer;
+    vec[1].iov_len = sizeof(extra_buffer);
+
+    ssize_t n = readv(fd, vec, 2);
+    if (n < 0) {
+        *saved_errno = errno;
+    } else if (static_cast<size_t>(n) <= writable) {
+        HasWritten(n);
+    } else {
+        HasWritten(writable);
+        Append(extra_buffer, n - writable);
+    }
+    return n;
+}
+
+}  // namespace avrtc
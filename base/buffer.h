@@ -0,0 +1,54 @@
+#ifndef BASE_BUFFER_H
+#define BASE_BUFFER_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace avrtc {
+
+// 引用计数的只读数据块，同一份数据可以排入多个连接的发送队列而不拷贝
+using SharedBuffer = std::shared_ptr<const std::string>;
+
+/**
+ * 可增长的字节缓冲区，维护读写两个下标
+ * 可读区间为 [read_index_, write_index_)，可写区间为 [write_index_, size)
+ * 已读部分在空间不足时被整理到头部复用，避免频繁扩容
+ */
+class Buffer {
+ public:
+  static constexpr size_t kInitialSize = 4096;
+
+  explicit Buffer(size_t initial_size = kInitialSize)
+      : buffer_(initial_size) {}
+
+  size_t ReadableBytes() const { return write_index_ - read_index_; }
+  size_t WritableBytes() const { return buffer_.size() - write_index_; }
+
+  // 可读数据的起始地址，在下一次写入之前有效
+  char* Peek() { return buffer_.data() + read_index_; }
+  const char* Peek() const { return buffer_.data() + read_index_; }
+
+  void Retrieve(size_t length);
+  void RetrieveAll() { read_index_ = write_index_ = 0; }
+
+  void Append(const char* data, size_t length);
+  void EnsureWritable(size_t length);
+
+  char* BeginWrite() { return buffer_.data() + write_index_; }
+  void HasWritten(size_t length) { write_index_ += length; }
+
+  ssize_t ReadFd(int fd, int* saved_errno);
+
+ private:
+  std::vector<char> buffer_;
+  size_t read_index_ = 0;
+  size_t write_index_ = 0;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_BUFFER_H
@@ -28,6 +28,78 @@ void CheckFfmpeg(const void* ret) {
     }
 }
 
+namespace {
+
+int ReadMappedFile(void* opaque, uint8_t* buf, int buf_size) {
+    auto* reader = static_cast<MappedFileReader*>(opaque);
+    size_t n = reader->Read(buf, static_cast<size_t>(buf_size));
+    return n > 0 ? static_cast<int>(n) : AVERROR_EOF;
+}
+
+int64_t SeekMappedFile(void* opaque, int64_t offset, int whence) {
+    auto* reader = static_cast<MappedFileReader*>(opaque);
+    if (whence & AVSEEK_SIZE) {
+        return static_cast<int64_t>(reader->GetFile()->GetSize());
+    }
+    int64_t position = reader->Seek(offset, whence & ~AVSEEK_FORCE);
+    return position >= 0 ? position : AVERROR(EINVAL);
+}
+
+}  // namespace
+
+/**
+ * Constructor for PacketRing class.
+ * @param capacity The maximum number of queued packets.
+ */
+PacketRing::PacketRing(size_t capacity) : slots_(capacity) {
+    CHECK_GT(capacity, 0u);
+    for (AVPacket*& slot : slots_) {
+        CheckFfmpeg(slot = av_packet_alloc());
+    }
+}
+
+PacketRing::~PacketRing() {
+    for (AVPacket*& slot : slots_) {
+        av_packet_free(&slot);
+    }
+}
+
+/**
+ * Move a packet reference into the ring. Producer thread only.
+ * @param packet The packet to enqueue; left blank on success.
+ * @return false if the ring is full, the packet is left untouched.
+ */
+bool PacketRing::Push(AVPacket* packet) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+        return false;
+    }
+    av_packet_move_ref(slots_[tail % slots_.size()], packet);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Move the oldest packet reference out of the ring. Consumer thread only.
+ * @param packet Receives the packet; its previous reference is released.
+ * @return false if the ring is empty.
+ */
+bool PacketRing::Pop(AVPacket* packet) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    av_packet_unref(packet);
+    av_packet_move_ref(packet, slots_[head % slots_.size()]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+size_t PacketRing::Size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+}
+
 /**
  * Constructor for FormatContext class.
  * @param fileName The name of the input file to open.
@@ -41,32 +113,210 @@ FormatContext::FormatContext(const std::string& fileName) {
 /**
  * Initialize the format context by opening the input file
  *       and finding the stream information.
+ * @param fileName A local file, read through a MappedFile, or any URL
+ *     FFmpeg can open.
+ * @note On failure the streams are NULL and no packets are returned.
  */
 void FormatContext::InitInCtx(const std::string& fileName) {
-    int video_stream_index_, audio_stream_index_;
-    CheckFfmpeg(
-        avformat_open_input(&format_ctx_, "test_data/oceans.mp4", NULL, NULL));
+    streams_.assign(2, nullptr);
+    CheckFfmpeg(format_ctx_ = avformat_alloc_context());
+    if (format_ctx_ == NULL)
+        return;
+    std::shared_ptr<MappedFile> file;
+    if (fileName.find("://") == std::string::npos)
+        file = MappedFile::Open(fileName);
+    if (file) {
+        reader_.reset(new MappedFileReader(file));
+        unsigned char* buffer =
+            static_cast<unsigned char*>(av_malloc(kIoBufferSize));
+        CheckFfmpeg(buffer);
+        io_ctx_ = avio_alloc_context(buffer, kIoBufferSize, 0, reader_.get(),
+                                     ReadMappedFile, NULL, SeekMappedFile);
+        CheckFfmpeg(io_ctx_);
+        if (io_ctx_ == NULL) {
+            av_free(buffer);
+        } else {
+            format_ctx_->pb = io_ctx_;
+            format_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+    }
+    // Frees format_ctx_ and sets it to NULL on failure.
+    int ret = avformat_open_input(&format_ctx_, fileName.c_str(), NULL, NULL);
+    if (ret < 0) {
+        CheckFfmpeg(ret);
+        return;
+    }
     CheckFfmpeg(avformat_find_stream_info(format_ctx_, NULL));
-    CheckFfmpeg(video_stream_index_ = av_find_best_stream(
-                    format_ctx_, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0));
-    CheckFfmpeg(audio_stream_index_ = av_find_best_stream(
-                    format_ctx_, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0));
-    streams_.push_back(format_ctx_->streams[video_stream_index_]);
-    streams_.push_back(format_ctx_->streams[audio_stream_index_]);
+    const AVMediaType types[] = {AVMEDIA_TYPE_VIDEO, AVMEDIA_TYPE_AUDIO};
+    for (int i = 0; i < 2; ++i) {
+        int index = av_find_best_stream(format_ctx_, types[i], -1, -1, NULL, 0);
+        if (index >= 0)
+            streams_[i] = format_ctx_->streams[index];
+    }
 }
 
-AVStream* FormatContext::GetStream(MediaType) {
-    return streams_[static_cast<int>(MediaType::VIDEO)];
+/**
+ * Get the best stream of a media type.
+ * @return The stream, or NULL if the input has none.
+ */
+AVStream* FormatContext::GetStream(MediaType type) {
+    return streams_[static_cast<int>(type)];
 }
 
 AVPacket* FormatContext::GetNextPacket() {
-    if (av_read_frame(format_ctx_, packet) < 0)
+    CHECK(!demux_thread_) << "GetNextPacket() called in read-ahead mode";
+    if (format_ctx_ == NULL || av_read_frame(format_ctx_, packet) < 0)
         return nullptr;
     return packet;
 }
 
+/**
+ * Start demuxing on a background thread into per-stream packet rings.
+ * @param options Queue depth and demux thread options.
+ * @return false if read-ahead is already running.
+ * @note Packets of streams other than the selected video and audio
+ *     streams are dropped. The demux thread waits while the ring of the
+ *     packet it just read is full, so consumers must keep popping every
+ *     stream they opened to avoid stalling the other one.
+ */
+bool FormatContext::StartReadAhead(const ReadAheadOptions& options) {
+    if (demux_thread_) {
+        LOG(ERROR) << "Read-ahead is already running.";
+        return false;
+    }
+    if (format_ctx_ == NULL) {
+        LOG(ERROR) << "Read-ahead on an input that failed to open.";
+        return false;
+    }
+    for (auto& ring : rings_) {
+        ring.reset(new PacketRing(options.queue_depth));
+    }
+    stopping_.store(false, std::memory_order_relaxed);
+    eof_.store(false, std::memory_order_relaxed);
+    read_error_.store(0, std::memory_order_relaxed);
+    ThreadOptions thread_options = options.thread_options;
+    if (thread_options.name.empty()) {
+        thread_options.name = "demux";
+    }
+    demux_thread_.reset(new Thread(thread_options));
+    demux_thread_->AddTask([this]() { ReadAheadLoop(); });
+    return true;
+}
+
+/**
+ * Stop the demux thread and wait for it to exit. Queued packets are kept
+ * and can still be popped.
+ */
+void FormatContext::StopReadAhead() {
+    if (!demux_thread_) {
+        return;
+    }
+    stopping_.store(true, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (demux_waiting_.exchange(0, std::memory_order_relaxed) != 0) {
+        FutexWake(&demux_waiting_);
+    }
+    demux_thread_.reset();
+}
+
+/**
+ * Pop the next packet of a stream without blocking. Each stream must be
+ * popped from a single thread.
+ * @param type The stream to pop from.
+ * @param packet Receives the packet; its previous reference is released.
+ * @return 0 on success, AVERROR(EAGAIN) if the demux thread has not read
+ *     the next packet yet, AVERROR_EOF after the last packet, or the
+ *     av_read_frame() error that stopped the demux thread once the packets
+ *     read before it are drained.
+ */
+int FormatContext::PopPacket(MediaType type, AVPacket* packet) {
+    PacketRing* ring = rings_[static_cast<int>(type)].get();
+    CHECK(ring != nullptr) << "PopPacket() called before StartReadAhead()";
+    // Packets pushed before the end of input was flagged are still drained.
+    bool eof = eof_.load(std::memory_order_acquire);
+    if (!ring->Pop(packet)) {
+        if (!eof) {
+            return AVERROR(EAGAIN);
+        }
+        int error = read_error_.load(std::memory_order_relaxed);
+        return error != 0 ? error : AVERROR_EOF;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (demux_waiting_.load(std::memory_order_relaxed) != 0 &&
+        demux_waiting_.exchange(0, std::memory_order_relaxed) != 0) {
+        FutexWake(&demux_waiting_);
+    }
+    return 0;
+}
+
+size_t FormatContext::GetQueuedPackets(MediaType type) const {
+    const PacketRing* ring = rings_[static_cast<int>(type)].get();
+    return ring != nullptr ? ring->Size() : 0;
+}
+
+void FormatContext::ReadAheadLoop() {
+    Thread::MarkCurrentTaskAsLoop();
+    AVPacket* read_packet = av_packet_alloc();
+    while (!stopping_.load(std::memory_order_acquire)) {
+        int ret = av_read_frame(format_ctx_, read_packet);
+        if (ret < 0) {
+            if (ret != AVERROR_EOF) {
+                CheckFfmpeg(ret);
+                // Published by the release store of eof_ below.
+                read_error_.store(ret, std::memory_order_relaxed);
+            }
+            break;
+        }
+        PacketRing* ring = nullptr;
+        for (size_t i = 0; i < streams_.size(); ++i) {
+            if (streams_[i] != NULL &&
+                streams_[i]->index == read_packet->stream_index) {
+                ring = rings_[i].get();
+                break;
+            }
+        }
+        if (ring == nullptr) {
+            av_packet_unref(read_packet);
+            continue;
+        }
+        if (!PushOrWait(ring, read_packet)) {
+            break;
+        }
+    }
+    av_packet_free(&read_packet);
+    eof_.store(true, std::memory_order_release);
+}
+
+/**
+ * Push a packet, sleeping on a futex while the ring is full.
+ * @return false if read-ahead was stopped while waiting.
+ */
+bool FormatContext::PushOrWait(PacketRing* ring, AVPacket* packet) {
+    while (!ring->Push(packet)) {
+        // Announce the wait before re-checking, consumers check the flag
+        // after popping, so a pop in between cannot be missed.
+        demux_waiting_.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ring->Full() && !stopping_.load(std::memory_order_acquire)) {
+            FutexWait(&demux_waiting_, 1);
+        }
+        demux_waiting_.store(0, std::memory_order_relaxed);
+        if (stopping_.load(std::memory_order_acquire)) {
+            av_packet_unref(packet);
+            return false;
+        }
+    }
+    return true;
+}
+
 FormatContext::~FormatContext() {
+    StopReadAhead();
     avformat_close_input(&format_ctx_);
+    // avformat_close_input() leaves custom I/O contexts to the caller.
+    if (io_ctx_ != NULL) {
+        av_freep(&io_ctx_->buffer);
+        avio_context_free(&io_ctx_);
+    }
     av_packet_free(&packet);
 }
 
@@ -82,13 +332,44 @@ Codec::Codec(AVCodecID id) {
 }
 
 /**
- * Copy codec parameters from the given AVStream to the codec context.
+ * Set the decoder threading options.
+ * @param options The options, used by the next CopyParamsFromStream().
+ */
+void Codec::SetDecoderOptions(const DecoderOptions& options) {
+    decoder_options_ = options;
+}
+
+/**
+ * Copy codec parameters from the given AVStream to the codec context
+ *     and open the decoder with the decoder options.
  * @param stream The AVStream from which to copy parameters.
  */
 void Codec::CopyParamsFromStream(AVStream* stream) {
     CheckFfmpeg(avcodec_parameters_to_context(codec_ctx, stream->codecpar));
+    codec_ctx->thread_count = decoder_options_.thread_count;
+    codec_ctx->thread_type = decoder_options_.thread_type;
+    if (decoder_options_.low_delay) {
+        if (stream->codecpar->video_delay == 0)
+            codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        else
+            LOG(INFO) << "Low delay ignored, the stream reorders "
+                      << stream->codecpar->video_delay << " frames.";
+    }
+    if ((decoder_options_.thread_type & FF_THREAD_SLICE) &&
+        !(decoder_options_.thread_type & FF_THREAD_FRAME) &&
+        !(codec->capabilities & AV_CODEC_CAP_SLICE_THREADS))
+        LOG(WARNING) << "Decoder " << codec->name
+                     << " does not support slice threading.";
     CheckFfmpeg(avcodec_open2(codec_ctx, codec, NULL));
 }
+
+/**
+ * Get the threading type the opened decoder actually uses.
+ * @return FF_THREAD_FRAME, FF_THREAD_SLICE, or 0 if single-threaded.
+ */
+int Codec::GetActiveThreadType() const {
+    return codec_ctx->active_thread_type;
+}
 void Codec::SetOnDecodeCallback(OnDecodeNewFrameCallback cb) {
     onDeFrameCb_ = cb;
 }
@@ -5,13 +5,17 @@
 #include <glog/logging.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <cstring>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "base/codec_type.h"
+#include "base/mapped_file.h"
+#include "base/thread.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -25,22 +29,119 @@ namespace avrtc {
 void CheckFfmpeg(int ret);
 void CheckFfmpeg(const void* ret);
 
+/**
+ * @brief Single-producer single-consumer ring of refcounted AVPackets.
+ * @note Slots are allocated once; Push() and Pop() only move packet
+ *     references, the payload is never copied.
+ */
+class PacketRing {
+   public:
+    explicit PacketRing(size_t capacity);
+    ~PacketRing();
+
+    PacketRing(const PacketRing&) = delete;
+    PacketRing& operator=(const PacketRing&) = delete;
+
+    bool Push(AVPacket* packet);
+    bool Pop(AVPacket* packet);
+    size_t Size() const;
+    bool Full() const { return Size() == slots_.size(); }
+
+   private:
+    std::vector<AVPacket*> slots_;
+    // Written by the consumer only.
+    std::atomic<size_t> head_{0};
+    // Written by the producer only.
+    std::atomic<size_t> tail_{0};
+};
+
+/**
+ * @brief Options of FormatContext::StartReadAhead().
+ */
+struct ReadAheadOptions {
+    // Packets buffered per stream before the demux thread waits.
+    size_t queue_depth = 64;
+    // An empty name defaults to "demux".
+    ThreadOptions thread_options;
+};
+
+/**
+ * @brief Demuxer over a media file or URL.
+ * @note Local files are read through a custom AVIOContext over a shared
+ *     MappedFile, so concurrent senders of the same file share one
+ *     mapping and the page cache; other inputs use FFmpeg's protocols.
+ */
 class FormatContext {
    public:
+    // Size of the AVIOContext buffer for mapped files.
+    static const int kIoBufferSize = 64 * 1024;
+
     FormatContext(const std::string& fileName);
     ~FormatContext();
 
     enum class MediaType { VIDEO, AUDIO };
+
     AVStream* GetStream(MediaType);
     AVPacket* GetNextPacket();
 
+    bool StartReadAhead(const ReadAheadOptions& options = ReadAheadOptions());
+    void StopReadAhead();
+    int PopPacket(MediaType type, AVPacket* packet);
+    size_t GetQueuedPackets(MediaType type) const;
+
    protected:
     void InitInCtx(const std::string& fileName);
 
    private:
+    void ReadAheadLoop();
+    bool PushOrWait(PacketRing* ring, AVPacket* packet);
+
     AVFormatContext* format_ctx_ = NULL;
+    // Custom I/O over the mapped file, NULL when FFmpeg opens the input.
+    AVIOContext* io_ctx_ = NULL;
+    std::unique_ptr<MappedFileReader> reader_;
+    // Indexed by MediaType, NULL if the input has no such stream.
     std::vector<AVStream*> streams_;
     AVPacket* packet = av_packet_alloc();
+
+    // Read-ahead state, indexed by MediaType.
+    std::unique_ptr<PacketRing> rings_[2];
+    std::unique_ptr<Thread> demux_thread_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> eof_{false};
+    // The av_read_frame() error that ended the demux loop, 0 on EOF or stop.
+    std::atomic<int> read_error_{0};
+    // Set to 1 while the demux thread waits for a full ring to drain.
+    std::atomic<uint32_t> demux_waiting_{0};
+};
+
+/**
+ * @brief Decoder threading and latency options, applied when the decoder
+ *     is opened in Codec::CopyParamsFromStream().
+ * @note The defaults match FFmpeg's. Frame threading decodes several
+ *     frames at once and delays output by one frame per extra thread.
+ *     Slice threading splits one frame and adds no delay, but only helps
+ *     streams encoded with multiple slices.
+ */
+struct DecoderOptions {
+    // Number of decoding threads, 0 picks one per CPU core.
+    int thread_count = 1;
+    // FF_THREAD_FRAME and/or FF_THREAD_SLICE.
+    int thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    // Sets AV_CODEC_FLAG_LOW_DELAY, only on streams without B-frame
+    // reordering (codecpar->video_delay == 0). On a stream that reorders,
+    // the flag makes H.264 output frames in decode order, so it is skipped.
+    bool low_delay = false;
+
+    // Slice threads with low delay for real-time playback. Streams with
+    // B-frames still wait for reordering, but frames stay in pts order.
+    static DecoderOptions RealTime(int thread_count = 0) {
+        DecoderOptions options;
+        options.thread_count = thread_count;
+        options.thread_type = FF_THREAD_SLICE;
+        options.low_delay = true;
+        return options;
+    }
 };
 
 class Codec {
@@ -51,7 +152,9 @@ class Codec {
     using OnDecodeNewFrameCallback = std::function<void(AVFrame*)>;
     using OnEncodeNewPacketCallback = std::function<void(AVPacket*)>;
 
+    void SetDecoderOptions(const DecoderOptions& options);
     void CopyParamsFromStream(AVStream* stream);
+    int GetActiveThreadType() const;
     void SetOnDecodeCallback(OnDecodeNewFrameCallback cb);
     void SetOnEncodeCallback(OnEncodeNewPacketCallback cb);
     void DecodeFrame(AVPacket* packet);
@@ -67,6 +170,7 @@ class Codec {
     AVCodecContext* codec_ctx;
     AVPacket* packet;
     AVFrame* frame;
+    DecoderOptions decoder_options_;
 
     OnDecodeNewFrameCallback onDeFrameCb_;
     OnEncodeNewPacketCallback onEnPacketCb_;
@@ -0,0 +1,194 @@
+#include "base/coroutine.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <glog/logging.h>
+
+namespace avrtc {
+
+namespace internal {
+
+namespace {
+
+// 最小一档64字节，共6档，最大2048字节
+const size_t kMinFrameSize = 64;
+const int kSizeClasses = 6;
+// 每档最多缓存的空闲帧数，帧在别的线程释放时不会无限堆积在释放线程上
+const size_t kMaxCachedFrames = 128;
+
+struct FreeFrame {
+    FreeFrame* next;
+};
+
+/**
+ * 一个线程的空闲帧链表，线程退出时释放缓存的帧
+ */
+class ThreadFramePool {
+   public:
+    ~ThreadFramePool() {
+        for (int i = 0; i < kSizeClasses; ++i) {
+            while (free_lists[i] != nullptr) {
+                FreeFrame* frame = free_lists[i];
+                free_lists[i] = frame->next;
+                ::operator delete(frame);
+            }
+        }
+    }
+
+    FreeFrame* free_lists[kSizeClasses] = {};
+    size_t free_counts[kSizeClasses] = {};
+};
+
+thread_local ThreadFramePool frame_pool;
+
+/**
+ * 计算帧大小所在的档位
+ * @return 档位下标，超过最大档位返回-1
+ */
+int GetSizeClass(size_t size) {
+    size_t class_size = kMinFrameSize;
+    for (int i = 0; i < kSizeClasses; ++i) {
+        if (size <= class_size) {
+            return i;
+        }
+        class_size <<= 1;
+    }
+    return -1;
+}
+
+}  // namespace
+
+/**
+ * 分配协程帧，优先使用当前线程缓存的空闲帧
+ * @param size 帧大小
+ * @return 帧地址
+ */
+void* FramePool::Allocate(size_t size) {
+    int size_class = GetSizeClass(size);
+    if (size_class < 0) {
+        return ::operator new(size);
+    }
+    FreeFrame* frame = frame_pool.free_lists[size_class];
+    if (frame != nullptr) {
+        frame_pool.free_lists[size_class] = frame->next;
+        --frame_pool.free_counts[size_class];
+        return frame;
+    }
+    return ::operator new(kMinFrameSize << size_class);
+}
+
+/**
+ * 释放协程帧，放回当前线程的空闲链表，链表已满时直接释放
+ * @param p 帧地址
+ * @param size 帧大小，和分配时相同
+ */
+void FramePool::Deallocate(void* p, size_t size) {
+    int size_class = GetSizeClass(size);
+    if (size_class < 0 ||
+        frame_pool.free_counts[size_class] >= kMaxCachedFrames) {
+        ::operator delete(p);
+        return;
+    }
+    FreeFrame* frame = static_cast<FreeFrame*>(p);
+    frame->next = frame_pool.free_lists[size_class];
+    frame_pool.free_lists[size_class] = frame;
+    ++frame_pool.free_counts[size_class];
+}
+
+size_t FramePool::GetCachedCount() {
+    size_t count = 0;
+    for (int i = 0; i < kSizeClasses; ++i) {
+        count += frame_pool.free_counts[i];
+    }
+    return count;
+}
+
+/**
+ * Spawn()启动的协程中没有被捕获的异常没有等待者可以接收，按线程中未捕获的异常处理
+ */
+void OnUnhandledException(const std::exception_ptr& exception) {
+    try {
+        std::rethrow_exception(exception);
+    } catch (const std::exception& e) {
+        LOG(FATAL) << "Unhandled exception in coroutine: " << e.what();
+    } catch (...) {
+        LOG(FATAL) << "Unhandled exception in coroutine";
+    }
+}
+
+/**
+ * 恢复任务没有执行就被丢弃，沿着parent找到等待链的起点
+ * 起点由Spawn()启动时销毁它，起点的帧析构时依次销毁它等待的协程；
+ * 否则起点仍由持有CoTask的代码负责销毁
+ * @param handle 被丢弃的恢复任务中的协程
+ * @param promise handle的promise，不是CoTask的协程时为nullptr
+ */
+void DestroyAbandoned(std::coroutine_handle<> handle, PromiseBase* promise) {
+    if (promise == nullptr) {
+        LOG(WARNING) << "Resume task of a foreign coroutine dropped";
+        return;
+    }
+    while (promise->parent != nullptr) {
+        handle = promise->continuation;
+        promise = promise->parent;
+    }
+    if (promise->detached) {
+        handle.destroy();
+    }
+}
+
+}  // namespace internal
+
+/**
+ * 在线程中启动协程，协程结束后自行销毁
+ * @param thread 协程开始执行的线程
+ * @param task 协程，之后不能再使用
+ * @param from 投递位置
+ */
+void Spawn(Thread* thread, CoTask<void>&& task, const Location& from) {
+    CHECK(task.IsValid());
+    thread->AddTask(internal::ResumeTask(task.Detach()), from);
+}
+
+/**
+ * 在事件循环的线程中启动协程，协程结束后自行销毁
+ * @param loop 事件循环
+ * @param task 协程，之后不能再使用
+ */
+void Spawn(EventLoop* loop, CoTask<void>&& task) {
+    CHECK(task.IsValid());
+    std::coroutine_handle<> handle = task.Detach();
+    loop->QueueInLoop([handle]() { handle.resume(); });
+}
+
+SleepAwaiter SleepFor(int64_t delay_ms, const Location& from) {
+    Thread* thread = ThreadManager::CurrentThread();
+    CHECK(thread != nullptr) << "SleepFor() called outside of a Thread";
+    return SleepAwaiter(thread, delay_ms, from);
+}
+
+/**
+ * 向事件循环注册一次fd，事件到达时先注销再恢复协程，
+ * 协程恢复后可以马上再次等待同一个fd
+ * @return 是否挂起
+ */
+bool FdAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    EventLoop* loop = loop_;
+    int fd = fd_;
+    bool added = loop->AddFD(fd, events_, [this, loop, fd, handle](
+                                              uint32_t events) {
+        revents_ = events;
+        loop->RemoveFD(fd);
+        // 恢复后协程帧可能已经销毁，不能再访问this
+        handle.resume();
+    });
+    if (!added) {
+        revents_ = EPOLLERR;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace avrtc
+
+#endif  // defined(__cpp_impl_coroutine)
@@ -0,0 +1,339 @@
+#ifndef BASE_COROUTINE_H
+#define BASE_COROUTINE_H
+
+// 需要C++20，CMake中打开AVRTC_ENABLE_COROUTINES后可用
+#if defined(__cpp_impl_coroutine)
+
+#include <sys/epoll.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "base/event_loop.h"
+#include "base/location.h"
+#include "base/thread.h"
+
+namespace avrtc {
+
+namespace internal {
+
+/**
+ * 协程帧的每线程内存池，按2的幂分成几档，释放的帧挂在当前线程的空闲链表上，
+ * 同一线程中反复创建的协程不再调用malloc
+ * 帧可以在另一个线程中释放，此时归还到释放线程的链表，每档缓存的个数有上限
+ * 超过最大档位的帧直接使用operator new
+ */
+class FramePool {
+ public:
+  static void* Allocate(size_t size);
+  static void Deallocate(void* p, size_t size);
+
+  // 当前线程缓存的空闲帧数
+  static size_t GetCachedCount();
+};
+
+void OnUnhandledException(const std::exception_ptr& exception);
+
+struct PromiseBase {
+  // 结束时恢复等待者；Spawn()启动的协程没有等待者，结束时自行销毁
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      PromiseBase& promise = handle.promise();
+      if (promise.continuation) {
+        return promise.continuation;
+      }
+      if (promise.detached) {
+        if (promise.exception) {
+          OnUnhandledException(promise.exception);
+        }
+        handle.destroy();
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  static void* operator new(size_t size) { return FramePool::Allocate(size); }
+  static void operator delete(void* p, size_t size) {
+    FramePool::Deallocate(p, size);
+  }
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+
+  std::coroutine_handle<> continuation;
+  // 等待者也是CoTask时指向它的promise，用来找到等待链的起点
+  PromiseBase* parent = nullptr;
+  std::exception_ptr exception;
+  bool detached = false;
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+  template <typename U>
+  void return_value(U&& result) {
+    value.emplace(std::forward<U>(result));
+  }
+  T GetResult() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*value);
+  }
+
+  std::optional<T> value;
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  void return_void() {}
+  void GetResult() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+};
+
+void DestroyAbandoned(std::coroutine_handle<> handle, PromiseBase* promise);
+
+/**
+ * 投递到Thread上的恢复任务，执行时恢复协程
+ * 线程停止后任务没有执行就被丢弃时，销毁协程所在等待链的起点，
+ * 链上各帧中局部变量的析构函数照常执行，等待中的父协程随之销毁，不会一直挂起
+ */
+class ResumeTask {
+ public:
+  template <typename Promise>
+  explicit ResumeTask(std::coroutine_handle<Promise> handle) : handle_(handle) {
+    if constexpr (std::is_base_of<PromiseBase, Promise>::value) {
+      promise_ = &handle.promise();
+    }
+  }
+  ResumeTask(ResumeTask&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)),
+        promise_(other.promise_) {}
+  ResumeTask& operator=(ResumeTask&&) = delete;
+  ~ResumeTask() {
+    if (handle_) {
+      DestroyAbandoned(handle_, promise_);
+    }
+  }
+
+  void operator()() { std::exchange(handle_, nullptr).resume(); }
+
+ private:
+  std::coroutine_handle<> handle_;
+  PromiseBase* promise_ = nullptr;
+};
+
+}  // namespace internal
+
+template <typename T>
+class CoTask;
+
+void Spawn(Thread* thread, CoTask<void>&& task,
+           const Location& from = Location::Current());
+void Spawn(EventLoop* loop, CoTask<void>&& task);
+
+/**
+ * 协程任务，创建后不立即执行，被co_await或Spawn()时才开始
+ * co_await时在等待方的线程中继续执行，结束后直接切换回等待方，不经过任务队列
+ * 协程在哪个线程中恢复由其中的等待点决定：SwitchTo()切到指定Thread，
+ * SleepFor()在原Thread上，Readable()/Writable()在EventLoop的线程上
+ * 协程中抛出的异常在co_await处重新抛出
+ * 恢复协程的Thread停止后，Spawn()启动的整条等待链被销毁，局部变量照常析构
+ * 协程帧从internal::FramePool分配
+ *
+ * 例如:
+ *   CoTask<int> Answer(Thread* worker) {
+ *     co_await SwitchTo(worker);
+ *     co_return 42;
+ *   }
+ *   CoTask<void> Run(Thread* worker) {
+ *     int answer = co_await Answer(worker);
+ *   }
+ *   Spawn(&thread, Run(&worker));
+ */
+template <typename T = void>
+class CoTask {
+ public:
+  struct promise_type : internal::Promise<T> {
+    CoTask get_return_object() {
+      return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+  };
+
+  class Awaiter {
+   public:
+    explicit Awaiter(std::coroutine_handle<promise_type> handle)
+        : handle_(handle) {}
+
+    bool await_ready() const { return !handle_ || handle_.done(); }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> awaiting) {
+      handle_.promise().continuation = awaiting;
+      if constexpr (std::is_base_of<internal::PromiseBase, Promise>::value) {
+        handle_.promise().parent = &awaiting.promise();
+      }
+      return handle_;
+    }
+    T await_resume() { return handle_.promise().GetResult(); }
+
+   private:
+    std::coroutine_handle<promise_type> handle_;
+  };
+
+  CoTask() = default;
+  CoTask(CoTask&& other) noexcept : handle_(other.handle_) {
+    other.handle_ = nullptr;
+  }
+  CoTask& operator=(CoTask&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      handle_ = other.handle_;
+      other.handle_ = nullptr;
+    }
+    return *this;
+  }
+  ~CoTask() { Reset(); }
+
+  CoTask(const CoTask&) = delete;
+  CoTask& operator=(const CoTask&) = delete;
+
+  Awaiter operator co_await() && { return Awaiter(handle_); }
+
+  bool IsValid() const { return static_cast<bool>(handle_); }
+  bool IsDone() const { return handle_ && handle_.done(); }
+
+ private:
+  friend void Spawn(Thread* thread, CoTask<void>&& task, const Location& from);
+  friend void Spawn(EventLoop* loop, CoTask<void>&& task);
+
+  explicit CoTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  void Reset() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  // 交出协程的所有权，协程结束时自行销毁
+  std::coroutine_handle<promise_type> Detach() {
+    std::coroutine_handle<promise_type> handle = handle_;
+    handle.promise().detached = true;
+    handle_ = nullptr;
+    return handle;
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * 切换到指定线程继续执行，已经在这个线程中时不挂起
+ * 目标线程已经停止时恢复任务被丢弃，协程所在的等待链随之销毁，见ResumeTask
+ */
+class SwitchToAwaiter {
+ public:
+  SwitchToAwaiter(Thread* thread, const Location& from)
+      : thread_(thread), from_(from) {}
+
+  bool await_ready() const { return thread_->IsCurrent(); }
+  // 投递被拒绝时帧在投递中就已经销毁，之后不能再访问this
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> handle) {
+    Thread* thread = thread_;
+    Location from = from_;
+    thread->AddTask(internal::ResumeTask(handle), from);
+  }
+  void await_resume() {}
+
+ private:
+  Thread* thread_;
+  Location from_;
+};
+
+/**
+ * 定时等待，到期后在指定线程中继续执行
+ * 到期之前线程停止时和SwitchToAwaiter一样销毁等待链
+ */
+class SleepAwaiter {
+ public:
+  SleepAwaiter(Thread* thread, int64_t delay_ms, const Location& from)
+      : thread_(thread), delay_ms_(delay_ms), from_(from) {}
+
+  bool await_ready() const { return false; }
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> handle) {
+    Thread* thread = thread_;
+    Location from = from_;
+    thread->PostDelayedTask(delay_ms_, internal::ResumeTask(handle), from);
+  }
+  void await_resume() {}
+
+ private:
+  Thread* thread_;
+  int64_t delay_ms_;
+  Location from_;
+};
+
+/**
+ * 等待文件描述符可读或可写，在EventLoop的线程中继续执行
+ * 必须在EventLoop的线程中co_await，fd在等待期间不能被其他回调注册到同一个EventLoop
+ * 每次等待都要向epoll添加和删除一次，长期收发的连接仍应使用Socket的回调
+ * co_await的结果是触发的epoll事件，添加到epoll失败时不挂起，结果为EPOLLERR
+ */
+class FdAwaiter {
+ public:
+  FdAwaiter(EventLoop* loop, int fd, uint32_t events)
+      : loop_(loop), fd_(fd), events_(events) {}
+
+  bool await_ready() const { return false; }
+  bool await_suspend(std::coroutine_handle<> handle);
+  uint32_t await_resume() const { return revents_; }
+
+ private:
+  EventLoop* loop_;
+  int fd_;
+  uint32_t events_;
+  uint32_t revents_ = 0;
+};
+
+inline SwitchToAwaiter SwitchTo(Thread* thread,
+                                const Location& from = Location::Current()) {
+  return SwitchToAwaiter(thread, from);
+}
+
+inline SleepAwaiter SleepFor(Thread* thread, int64_t delay_ms,
+                             const Location& from = Location::Current()) {
+  return SleepAwaiter(thread, delay_ms, from);
+}
+
+// 在当前Thread上定时等待，必须在Thread中调用
+SleepAwaiter SleepFor(int64_t delay_ms,
+                      const Location& from = Location::Current());
+
+inline FdAwaiter Readable(EventLoop* loop, int fd) {
+  return FdAwaiter(loop, fd, EPOLLIN);
+}
+
+inline FdAwaiter Writable(EventLoop* loop, int fd) {
+  return FdAwaiter(loop, fd, EPOLLOUT);
+}
+
+}  // namespace avrtc
+
+#endif  // defined(__cpp_impl_coroutine)
+
+#endif  // BASE_COROUTINE_H
@@ -0,0 +1,351 @@
+#include "base/event_loop.h"
+
+#include <errno.h>
+#include <glog/logging.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/thread.h"
+
+namespace avrtc {
+
+/**
+ * 构造函数，创建epoll、timerfd和用于跨线程唤醒的eventfd
+ */
+EventLoop::EventLoop() : start_ns_(NowNs()) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    CHECK(epoll_fd_ != -1 && timer_fd_ != -1 && wakeup_fd_ != -1)
+        << "Failed to create event loop, " << strerror(errno);
+
+    for (int fd : {timer_fd_, wakeup_fd_}) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = MakeTag(fd, 0);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+EventLoop::~EventLoop() {
+    close(wakeup_fd_);
+    close(timer_fd_);
+    close(epoll_fd_);
+}
+
+/**
+ * 运行事件循环，直到Stop()被调用
+ * 在Run()之前调用的Stop()同样有效，Run()会立即返回
+ * 在Thread的任务中运行时，这个任务按循环任务统计，不计为慢任务
+ */
+void EventLoop::Run() {
+    Thread::MarkCurrentTaskAsLoop();
+    loop_thread_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    if (busy_poll_.cpu >= 0) {
+        PinCurrentThread(busy_poll_.cpu);
+    }
+    if (busy_poll_.enabled) {
+        RunBusyPoll();
+    } else {
+        while (!quit_) {
+            RunOnce(-1);
+        }
+    }
+    quit_ = false;
+    loop_thread_.store(std::thread::id(), std::memory_order_relaxed);
+}
+
+bool EventLoop::IsInLoopThread() const {
+    std::thread::id id = loop_thread_.load(std::memory_order_relaxed);
+    return id == std::thread::id() || id == std::this_thread::get_id();
+}
+
+/**
+ * 等待并处理一批事件
+ * @param timeout_ms 最长等待时间，-1表示一直等待，0表示不等待
+ * @return 本批事件数，出错返回-1
+ */
+int EventLoop::RunOnce(int timeout_ms) {
+    epoll_event events[kMaxEvents];
+    int n = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+    if (n == -1) {
+        if (errno != EINTR) {
+            LOG(ERROR) << "Epoll wait error, " << strerror(errno);
+        }
+        return -1;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        uint64_t tag = events[i].data.u64;
+        int fd = static_cast<int>(tag & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(tag >> 32);
+        if (fd == timer_fd_) {
+            HandleTimer();
+        } else if (fd == wakeup_fd_) {
+            uint64_t value;
+            ssize_t ret = read(wakeup_fd_, &value, sizeof(value));
+            (void)ret;
+        } else if (fd < static_cast<int>(handlers_.size()) &&
+                   handlers_[fd].cb &&
+                   handlers_[fd].generation == generation) {
+            // 回调可能移除自身或注册新的fd，取出裸指针再调用
+            EventCallback* cb = handlers_[fd].cb.get();
+            (*cb)(events[i].events);
+        }
+    }
+    retired_.clear();
+    RunPendingTasks();
+    return n;
+}
+
+/**
+ * 忙轮询：不断用超时为0的epoll_wait检查事件，数据到达后不需要等待调度器唤醒；
+ * 连续空转超过idle_spin_us没有事件时退回一次阻塞等待，
+ * 流量间断时不会一直占满CPU，被唤醒后重新开始空转
+ */
+void EventLoop::RunBusyPoll() {
+    const int64_t idle_spin_ns = busy_poll_.idle_spin_us * 1000;
+    int64_t last_event_ns = NowNs();
+    while (!quit_) {
+        if (RunOnce(0) > 0) {
+            last_event_ns = NowNs();
+            continue;
+        }
+        if (NowNs() - last_event_ns < idle_spin_ns) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+            continue;
+        }
+        ++idle_backoffs_;
+        RunOnce(-1);
+        last_event_ns = NowNs();
+    }
+}
+
+/**
+ * 将调用线程绑定到一个CPU，避免反应器线程被迁移导致缓存失效和调度延迟
+ * @param cpu CPU编号
+ * @return 是否成功
+ */
+bool EventLoop::PinCurrentThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        LOG(WARNING) << "Failed to pin thread to cpu " << cpu << ", "
+                     << strerror(ret);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 停止事件循环，可以在任意线程中调用
+ */
+void EventLoop::Stop() {
+    quit_ = true;
+    Wakeup();
+}
+
+/**
+ * 投递一个任务到事件循环线程中执行，可以在任意线程中调用
+ * 其他线程需要操作循环中的fd或定时器时（例如发起连接），通过它切换到循环线程
+ * @param task 任务
+ */
+void EventLoop::QueueInLoop(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_tasks_.push_back(std::move(task));
+    }
+    Wakeup();
+}
+
+/**
+ * 注册文件描述符
+ * @param fd 文件描述符
+ * @param events 关注的epoll事件
+ * @param cb 事件回调
+ * @return 是否注册成功
+ */
+bool EventLoop::AddFD(int fd, uint32_t events, EventCallback cb) {
+    if (fd >= static_cast<int>(handlers_.size())) {
+        handlers_.resize(fd + 1);
+    }
+    Handler& handler = handlers_[fd];
+    uint32_t generation = handler.generation + 1;
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = MakeTag(fd, generation);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+        LOG(ERROR) << "Failed to add fd " << fd << " to epoll, "
+                   << strerror(errno);
+        return false;
+    }
+    if (handler.cb) {
+        retired_.push_back(std::move(handler.cb));
+    }
+    handler.cb = std::make_unique<EventCallback>(std::move(cb));
+    handler.generation = generation;
+    return true;
+}
+
+/**
+ * 修改文件描述符关注的事件
+ * @param fd 文件描述符
+ * @param events 关注的epoll事件
+ * @return 是否修改成功
+ */
+bool EventLoop::ModifyFD(int fd, uint32_t events) {
+    uint32_t generation =
+        fd < static_cast<int>(handlers_.size()) ? handlers_[fd].generation : 0;
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = MakeTag(fd, generation);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == -1) {
+        LOG(ERROR) << "Failed to modify fd " << fd << " in epoll, "
+                   << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 移除文件描述符，应当在close(fd)之前调用
+ * @param fd 文件描述符
+ */
+void EventLoop::RemoveFD(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    if (fd < static_cast<int>(handlers_.size()) && handlers_[fd].cb) {
+        retired_.push_back(std::move(handlers_[fd].cb));
+    }
+}
+
+/**
+ * 添加一次性定时器
+ * @param delay_ms 延迟毫秒数
+ * @param cb 到期回调，在事件循环线程中执行
+ * @return 定时器ID，用于取消
+ */
+EventLoop::TimerId EventLoop::RunAfter(int64_t delay_ms, TimerCallback cb) {
+    TimerId id = timer_wheel_.Add(ToTicks(delay_ms), 0, std::move(cb));
+    ArmTimer();
+    return id;
+}
+
+/**
+ * 添加周期定时器，首次在一个周期后触发
+ * @param period_ms 周期毫秒数
+ * @param cb 到期回调，在事件循环线程中执行
+ * @return 定时器ID，用于取消
+ */
+EventLoop::TimerId EventLoop::RunEvery(int64_t period_ms, TimerCallback cb) {
+    uint64_t period_ticks = std::max<int64_t>(period_ms / kTickMs, 1);
+    TimerId id =
+        timer_wheel_.Add(ToTicks(period_ms), period_ticks, std::move(cb));
+    ArmTimer();
+    return id;
+}
+
+/**
+ * 取消定时器，O(1)
+ * @param id 定时器ID
+ * @return 是否取消了一个仍然有效的定时器
+ */
+bool EventLoop::CancelTimer(TimerId id) {
+    // timerfd不需要重新设置，多一次空唤醒没有影响
+    return timer_wheel_.Cancel(id);
+}
+
+int64_t EventLoop::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * 将相对当前时间的延迟换算成相对时间轮当前tick的tick数
+ * 到期tick向上取整，保证定时器不会提前触发；
+ * 时间轮只在定时器唤醒时推进，可能落后于真实时间，换算时把落后的部分补上
+ */
+uint64_t EventLoop::ToTicks(int64_t ms) const {
+    const int64_t tick_ns = kTickMs * 1000000LL;
+    int64_t deadline_ns = NowNs() - start_ns_ + ms * 1000000LL;
+    int64_t deadline_tick = (deadline_ns + tick_ns - 1) / tick_ns;
+    int64_t delay = deadline_tick - timer_wheel_.CurrentTick();
+    return std::max<int64_t>(delay, 1);
+}
+
+/**
+ * timerfd到期，按真实时间推进时间轮并重新设置下一次唤醒
+ */
+void EventLoop::HandleTimer() {
+    uint64_t expirations;
+    ssize_t ret = read(timer_fd_, &expirations, sizeof(expirations));
+    (void)ret;
+    armed_tick_ = -1;
+
+    int64_t now_tick = (NowNs() - start_ns_) / (kTickMs * 1000000LL);
+    int64_t current = static_cast<int64_t>(timer_wheel_.CurrentTick());
+    if (now_tick > current) {
+        timer_wheel_.Advance(now_tick - current);
+    }
+    ArmTimer();
+}
+
+/**
+ * 按时间轮下一个非空槽位设置timerfd，到期时间没有变化时不做系统调用
+ */
+void EventLoop::ArmTimer() {
+    int64_t ticks = timer_wheel_.TicksUntilNextSlot();
+    int64_t deadline_tick =
+        ticks < 0 ? -1
+                  : static_cast<int64_t>(timer_wheel_.CurrentTick()) + ticks;
+    if (deadline_tick == armed_tick_) {
+        return;
+    }
+    armed_tick_ = deadline_tick;
+
+    struct itimerspec spec = {};
+    if (deadline_tick >= 0) {
+        int64_t deadline_ns = start_ns_ + deadline_tick * kTickMs * 1000000LL;
+        spec.it_value.tv_sec = deadline_ns / 1000000000;
+        spec.it_value.tv_nsec = deadline_ns % 1000000000;
+    }
+    // it_value全为0表示取消定时
+    if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        LOG(ERROR) << "Failed to arm timerfd, " << strerror(errno);
+    }
+}
+
+/**
+ * 执行其他线程投递的任务，任务中再投递的任务留到下一轮执行
+ */
+void EventLoop::RunPendingTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        tasks.swap(pending_tasks_);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void EventLoop::Wakeup() {
+    uint64_t one = 1;
+    ssize_t ret = write(wakeup_fd_, &one, sizeof(one));
+    (void)ret;
+}
+
+}  // namespace avrtc
@@ -0,0 +1,117 @@
+#ifndef BASE_EVENT_LOOP_H
+#define BASE_EVENT_LOOP_H
+
+#include <sys/epoll.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/timer_wheel.h"
+
+namespace avrtc {
+
+/**
+ * 基于epoll的事件循环，统一处理文件描述符事件和定时器
+ * 定时器挂在哈希时间轮上，整个循环只使用一个timerfd，
+ * 按下一个非空槽位的时间设置唤醒，没有定时器时不会空转
+ * 除Stop()和QueueInLoop()外的接口都必须在运行循环的线程中调用（或在Run()之前调用）
+ * epoll_event.data.u64中低32位是fd，高32位是注册时的代数，
+ * fd被关闭后复用时，同一批次中属于旧连接的事件按代数丢弃，不会派发给新的回调
+ * 可选忙轮询模式：用非阻塞的epoll_wait空转代替睡眠，省去唤醒延迟，
+ * 适合独占CPU的媒体反应器线程；空闲超过预算后退回阻塞等待
+ */
+class EventLoop {
+ public:
+  static const int kMaxEvents = 64;
+  // 时间轮每个tick的毫秒数
+  static const int kTickMs = 1;
+
+  using EventCallback = std::function<void(uint32_t events)>;
+  using Task = std::function<void()>;
+  using TimerCallback = TimerWheel::Callback;
+  using TimerId = TimerWheel::TimerId;
+
+  // 忙轮询配置，以CPU占用换取更低的尾延迟
+  struct BusyPollOptions {
+    bool enabled = false;
+    // 连续空转这么久没有事件后退回阻塞等待，下一次有事件时恢复空转
+    int64_t idle_spin_us = 200;
+    // 运行循环的线程绑定到这个CPU，-1表示不绑定
+    int cpu = -1;
+  };
+
+  EventLoop();
+  ~EventLoop();
+
+  void Run();
+  int RunOnce(int timeout_ms);
+  void Stop();
+  void QueueInLoop(Task task);
+  // 是否在运行Run()的线程中，循环没有运行时返回true，可以在任意线程中调用
+  bool IsInLoopThread() const;
+
+  bool AddFD(int fd, uint32_t events, EventCallback cb);
+  bool ModifyFD(int fd, uint32_t events);
+  void RemoveFD(int fd);
+
+  // 在Run()之前调用
+  void SetBusyPoll(const BusyPollOptions& options) { busy_poll_ = options; }
+  // 忙轮询模式下退回阻塞等待的次数，可以在任意线程中读取
+  uint64_t GetIdleBackoffs() const { return idle_backoffs_; }
+  static bool PinCurrentThread(int cpu);
+  // 单调时钟纳秒，和定时器使用同一个时钟
+  static int64_t NowNs();
+
+  TimerId RunAfter(int64_t delay_ms, TimerCallback cb);
+  TimerId RunEvery(int64_t period_ms, TimerCallback cb);
+  bool CancelTimer(TimerId id);
+
+ private:
+  // 按fd下标存放的回调和代数，分发事件只需要一次数组下标访问
+  struct Handler {
+    std::unique_ptr<EventCallback> cb;
+    uint32_t generation = 0;
+  };
+
+  static uint64_t MakeTag(int fd, uint32_t generation) {
+    return static_cast<uint64_t>(generation) << 32 | static_cast<uint32_t>(fd);
+  }
+
+  uint64_t ToTicks(int64_t ms) const;
+  void HandleTimer();
+  void ArmTimer();
+  void Wakeup();
+  void RunPendingTasks();
+  void RunBusyPoll();
+
+  int epoll_fd_ = -1;
+  int timer_fd_ = -1;
+  int wakeup_fd_ = -1;
+  std::atomic<bool> quit_{false};
+  // 运行Run()的线程，没有运行时为空
+  std::atomic<std::thread::id> loop_thread_{};
+
+  BusyPollOptions busy_poll_;
+  std::atomic<uint64_t> idle_backoffs_{0};
+
+  // 回调执行期间被移除的回调先放入retired_，本轮结束后释放
+  std::vector<Handler> handlers_;
+  std::vector<std::unique_ptr<EventCallback>> retired_;
+
+  // 其他线程投递的任务，在下一批事件处理完后执行
+  std::mutex pending_mutex_;
+  std::vector<Task> pending_tasks_;
+
+  TimerWheel timer_wheel_;
+  int64_t start_ns_;         // 时间轮第0个tick对应的单调时钟时间
+  int64_t armed_tick_ = -1;  // timerfd当前设置的到期tick，-1表示未设置
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_EVENT_LOOP_H
@@ -0,0 +1,66 @@
+#include "base/framing.h"
+
+#include <arpa/inet.h>
+#include <glog/logging.h>
+
+#include <cstring>
+
+namespace avrtc {
+
+/**
+ * 写入长度前缀
+ * @param length 消息体长度
+ * @param header 输出地址，至少kHeaderSize字节
+ */
+void FrameCodec::EncodeHeader(uint32_t length, char* header) {
+    uint32_t be_length = htonl(length);
+    memcpy(header, &be_length, kHeaderSize);
+}
+
+/**
+ * 将一条消息编码为带长度前缀的帧
+ * @param message 消息体
+ * @return 编码后的帧
+ */
+std::string FrameCodec::Encode(const std::string& message) {
+    std::string frame(kHeaderSize + message.size(), '\0');
+    EncodeHeader(static_cast<uint32_t>(message.size()), frame.data());
+    memcpy(frame.data() + kHeaderSize, message.data(), message.size());
+    return frame;
+}
+
+/**
+ * 从接收缓冲区中依次取出所有完整的帧并回调
+ * 回调拿到的是缓冲区内部的地址，不做拷贝，仅在回调期间有效；
+ * 不完整的帧留在缓冲区中等待后续数据
+ * @param buffer 接收缓冲区
+ * @param on_frame 每条完整消息的回调
+ * @param can_deliver 每条完整消息交付前的检查，为空时全部交付
+ * @return false表示帧长度超过kMaxFrameSize，连接应当关闭
+ */
+bool FrameCodec::Decode(Buffer* buffer,
+                        const OnFrameCallback& on_frame,
+                        const CanDeliverCallback& can_deliver) {
+    while (buffer->ReadableBytes() >= kHeaderSize) {
+        uint32_t be_length;
+        memcpy(&be_length, buffer->Peek(), kHeaderSize);
+        size_t length = ntohl(be_length);
+        if (length > kMaxFrameSize) {
+            LOG(ERROR) << "Frame too large: " << length;
+            return false;
+        }
+        if (buffer->ReadableBytes() < kHeaderSize + length) {
+            break;
+        }
+        if (can_deliver && !can_deliver()) {
+            break;
+        }
+        if (on_frame) {
+            on_frame(buffer->Peek() + kHeaderSize, length);
+        }
+        buffer->Retrieve(kHeaderSize + length);
+    }
+    return true;
+}
+
+}  // namespace avrtc
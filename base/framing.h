@@ -0,0 +1,38 @@
+#ifndef BASE_FRAMING_H
+#define BASE_FRAMING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "base/buffer.h"
+
+namespace avrtc {
+
+/**
+ * 信令消息的分帧格式：4字节大端长度 + 消息体
+ * TCP是字节流，一次recv可能包含半条或多条消息，
+ * 发送端为每条消息加上长度前缀，接收端据此切分出完整的消息
+ */
+class FrameCodec {
+ public:
+  static constexpr size_t kHeaderSize = 4;
+  // 单条消息的最大长度，超过视为协议错误，防止对端让我们无限缓存
+  static constexpr size_t kMaxFrameSize = 1 << 20;
+
+  using OnFrameCallback = std::function<void(char* data, size_t length)>;
+  // 交付下一条完整消息之前调用，返回false时停止，剩余的消息留在缓冲区中
+  using CanDeliverCallback = std::function<bool()>;
+
+  static void EncodeHeader(uint32_t length, char* header);
+  static std::string Encode(const std::string& message);
+
+  static bool Decode(Buffer* buffer,
+                     const OnFrameCallback& on_frame,
+                     const CanDeliverCallback& can_deliver = nullptr);
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_FRAMING_H
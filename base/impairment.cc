@@ -0,0 +1,183 @@
+#include "base/impairment.h"
+
+#include <algorithm>
+
+namespace avrtc {
+
+/**
+ * 构造函数
+ * @param loop 延迟发送的定时器所在的事件循环
+ * @param deliver 真正发出一个包的回调
+ */
+NetworkImpairment::NetworkImpairment(EventLoop* loop, DeliverCallback deliver)
+    : loop_(loop), deliver_(std::move(deliver)) {}
+
+NetworkImpairment::~NetworkImpairment() {
+    if (timer_ != TimerWheel::kInvalidTimerId) {
+        loop_->CancelTimer(timer_);
+    }
+}
+
+/**
+ * 设置损伤参数，随机数按新的种子重新开始，已经在排队的包按原计划发出
+ * @param config 损伤参数
+ */
+void NetworkImpairment::SetConfig(const ImpairmentConfig& config) {
+    config_ = config;
+    enabled_ = config.IsEnabled();
+    random_.seed(config.seed);
+    bad_state_ = false;
+}
+
+/**
+ * 经过损伤后发送一个包
+ * @param data 数据，调用返回后即可复用，需要延迟的包会被拷贝
+ * @param length 数据长度
+ */
+void NetworkImpairment::Send(const char* data, size_t length) {
+    ++stats_.sent;
+    if (!enabled_) {
+        ++stats_.delivered;
+        deliver_(data, length);
+        return;
+    }
+    if (ShouldDrop()) {
+        ++stats_.lost;
+        return;
+    }
+    int64_t now_ns = EventLoop::NowNs();
+    Schedule(data, length, now_ns);
+    if (config_.duplicate_rate > 0 && Chance(config_.duplicate_rate)) {
+        ++stats_.duplicated;
+        Schedule(data, length, now_ns);
+    }
+}
+
+/**
+ * 立即发出所有排队中的包，例如测试结束或关闭连接前
+ */
+void NetworkImpairment::Flush() {
+    while (!pending_.empty()) {
+        ReleaseFront();
+    }
+}
+
+/**
+ * 按独立丢包率和Gilbert-Elliott模型决定是否丢弃当前包
+ */
+bool NetworkImpairment::ShouldDrop() {
+    if (config_.burst_loss) {
+        bad_state_ = bad_state_ ? !Chance(config_.bad_to_good)
+                                : Chance(config_.good_to_bad);
+        if (Chance(bad_state_ ? config_.bad_loss : config_.good_loss)) {
+            return true;
+        }
+    }
+    return config_.loss_rate > 0 && Chance(config_.loss_rate);
+}
+
+bool NetworkImpairment::Chance(double probability) {
+    return std::uniform_real_distribution<double>(0, 1)(random_) <
+           probability;
+}
+
+/**
+ * 计算一个包的释放时间：先经过瓶颈链路的排队和串行化，再加上传播延迟和抖动
+ * 释放时间已到的包直接发出，否则放入定时器队列
+ */
+void NetworkImpairment::Schedule(const char* data,
+                                 size_t length,
+                                 int64_t now_ns) {
+    int64_t release_ns = now_ns;
+    if (config_.rate_bps > 0) {
+        int64_t start_ns = std::max(now_ns, link_free_ns_);
+        double backlog_bytes =
+            static_cast<double>(start_ns - now_ns) * config_.rate_bps / 8e9;
+        if (backlog_bytes + length > config_.queue_limit_bytes) {
+            ++stats_.queue_dropped;
+            return;
+        }
+        link_free_ns_ = start_ns + static_cast<int64_t>(length) * 8 *
+                                       1000000000 / config_.rate_bps;
+        release_ns = link_free_ns_;
+    }
+
+    if (config_.reorder_rate > 0 && Chance(config_.reorder_rate)) {
+        ++stats_.reordered;
+    } else {
+        int64_t delay_ms = config_.delay_ms;
+        if (config_.jitter_ms > 0) {
+            delay_ms += std::uniform_int_distribution<int64_t>(
+                -config_.jitter_ms, config_.jitter_ms)(random_);
+        }
+        release_ns += std::max<int64_t>(delay_ms, 0) * 1000000;
+        if (config_.jitter_preserves_order) {
+            release_ns = std::max(release_ns, last_release_ns_);
+            last_release_ns_ = release_ns;
+        }
+    }
+
+    if (release_ns <= now_ns) {
+        ++stats_.delivered;
+        deliver_(data, length);
+        return;
+    }
+    Enqueue(data, length, release_ns);
+}
+
+void NetworkImpairment::Enqueue(const char* data,
+                                size_t length,
+                                int64_t release_ns) {
+    PendingPacket packet;
+    packet.release_ns = release_ns;
+    packet.sequence = next_sequence_++;
+    packet.data.assign(data, length);
+    pending_.push_back(std::move(packet));
+    std::push_heap(pending_.begin(), pending_.end(), LaterRelease());
+    ArmTimer();
+}
+
+/**
+ * 按堆顶的释放时间设置定时器，已有定时器不晚于堆顶时不做改动
+ */
+void NetworkImpairment::ArmTimer() {
+    if (pending_.empty()) {
+        return;
+    }
+    int64_t release_ns = pending_.front().release_ns;
+    if (timer_ != TimerWheel::kInvalidTimerId) {
+        if (timer_release_ns_ <= release_ns) {
+            return;
+        }
+        loop_->CancelTimer(timer_);
+    }
+    int64_t delay_ms = (release_ns - EventLoop::NowNs() + 999999) / 1000000;
+    timer_release_ns_ = release_ns;
+    timer_ = loop_->RunAfter(std::max<int64_t>(delay_ms, 0),
+                             [this]() { OnTimer(); });
+}
+
+/**
+ * 发出堆顶的包
+ */
+void NetworkImpairment::ReleaseFront() {
+    std::pop_heap(pending_.begin(), pending_.end(), LaterRelease());
+    PendingPacket packet = std::move(pending_.back());
+    pending_.pop_back();
+    ++stats_.delivered;
+    deliver_(packet.data.data(), packet.data.size());
+}
+
+/**
+ * 定时器到期，发出所有释放时间已到的包
+ */
+void NetworkImpairment::OnTimer() {
+    timer_ = TimerWheel::kInvalidTimerId;
+    int64_t now_ns = EventLoop::NowNs();
+    while (!pending_.empty() && pending_.front().release_ns <= now_ns) {
+        ReleaseFront();
+    }
+    ArmTimer();
+}
+
+}  // namespace avrtc
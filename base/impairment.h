@@ -0,0 +1,128 @@
+#ifndef BASE_IMPAIRMENT_H
+#define BASE_IMPAIRMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "base/event_loop.h"
+
+namespace avrtc {
+
+/**
+ * 网络损伤参数，全部为0时不做任何处理
+ */
+struct ImpairmentConfig {
+  int64_t delay_ms = 0;
+  // 每个包的延迟在[delay_ms - jitter_ms, delay_ms + jitter_ms]内均匀分布
+  int64_t jitter_ms = 0;
+  // 抖动不改变包的顺序，和真实链路一致；关闭后抖动本身也会造成乱序
+  bool jitter_preserves_order = true;
+
+  // 独立随机丢包率
+  double loss_rate = 0;
+  // Gilbert-Elliott突发丢包：每个包先按转移概率切换好/坏状态，
+  // 再按所在状态的丢包率丢弃，平均突发长度约为1/bad_to_good
+  bool burst_loss = false;
+  double good_to_bad = 0;
+  double bad_to_good = 0;
+  double good_loss = 0;
+  double bad_loss = 1;
+
+  // 以这个概率不经过延迟立即发出，越过前面仍在排队的包
+  double reorder_rate = 0;
+  double duplicate_rate = 0;
+
+  // 带宽上限，0表示不限；超出的包在瓶颈队列中排队，队列满时丢弃
+  int64_t rate_bps = 0;
+  size_t queue_limit_bytes = 256 * 1024;
+
+  uint32_t seed = 1;
+
+  bool IsEnabled() const {
+    return delay_ms > 0 || jitter_ms > 0 || loss_rate > 0 || burst_loss ||
+           reorder_rate > 0 || duplicate_rate > 0 || rate_bps > 0;
+  }
+};
+
+/**
+ * 网络损伤模拟器，包在任意数据报路径外面，在回环上复现有损网络，
+ * 用于抖动缓冲、NACK、FEC和带宽估计的回归测试
+ * 被延迟的包按释放时间放在小根堆中，事件循环中只挂一个定时器，
+ * 对应最早的释放时间；没有开启任何损伤时Send()直接调用发送回调，不拷贝数据
+ * 只能在事件循环线程中使用
+ */
+class NetworkImpairment {
+ public:
+  // 真正发出一个包，例如调用UdpSocket::SendTo
+  using DeliverCallback = std::function<void(const char* data, size_t length)>;
+
+  struct Stats {
+    uint64_t sent = 0;
+    uint64_t delivered = 0;
+    uint64_t lost = 0;
+    uint64_t queue_dropped = 0;  // 瓶颈队列满丢弃的包
+    uint64_t duplicated = 0;
+    uint64_t reordered = 0;
+  };
+
+  NetworkImpairment(EventLoop* loop, DeliverCallback deliver);
+  ~NetworkImpairment();
+
+  void SetConfig(const ImpairmentConfig& config);
+  const ImpairmentConfig& GetConfig() const { return config_; }
+
+  void Send(const char* data, size_t length);
+  void Flush();
+
+  const Stats& GetStats() const { return stats_; }
+  size_t GetPendingCount() const { return pending_.size(); }
+
+ private:
+  struct PendingPacket {
+    int64_t release_ns;
+    uint64_t sequence;  // 相同释放时间按进入顺序发出
+    std::string data;
+  };
+  struct LaterRelease {
+    bool operator()(const PendingPacket& a, const PendingPacket& b) const {
+      return a.release_ns != b.release_ns ? a.release_ns > b.release_ns
+                                          : a.sequence > b.sequence;
+    }
+  };
+
+  bool ShouldDrop();
+  bool Chance(double probability);
+  void Schedule(const char* data, size_t length, int64_t now_ns);
+  void Enqueue(const char* data, size_t length, int64_t release_ns);
+  void ReleaseFront();
+  void ArmTimer();
+  void OnTimer();
+
+  EventLoop* loop_;
+  DeliverCallback deliver_;
+  ImpairmentConfig config_;
+  bool enabled_ = false;
+  std::mt19937 random_;
+
+  bool bad_state_ = false;
+  // 瓶颈链路空闲下来的时间，用于计算排队和串行化延迟
+  int64_t link_free_ns_ = 0;
+  // 保序时上一个包的释放时间
+  int64_t last_release_ns_ = 0;
+
+  // 按LaterRelease组织的小根堆，堆顶是最早释放的包
+  std::vector<PendingPacket> pending_;
+  uint64_t next_sequence_ = 0;
+  EventLoop::TimerId timer_ = TimerWheel::kInvalidTimerId;
+  int64_t timer_release_ns_ = 0;  // timer_对应的释放时间
+
+  Stats stats_;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_IMPAIRMENT_H
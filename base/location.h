@@ -0,0 +1,35 @@
+#ifndef BASE_LOCATION_H
+#define BASE_LOCATION_H
+
+#include <cstring>
+#include <string>
+
+namespace avrtc {
+
+/**
+ * 源代码位置，作为默认参数时记录调用方的文件和行号，
+ * 例如Thread::AddTask()用它记录任务的投递位置，慢任务日志中打印
+ */
+struct Location {
+  const char* file = "";
+  int line = 0;
+
+  static Location Current(const char* file = __builtin_FILE(),
+                          int line = __builtin_LINE()) {
+    Location location;
+    location.file = file;
+    location.line = line;
+    return location;
+  }
+
+  // 去掉目录的"文件名:行号"
+  std::string ToString() const {
+    const char* name = strrchr(file, '/');
+    return std::string(name != nullptr ? name + 1 : file) + ":" +
+           std::to_string(line);
+  }
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_LOCATION_H
@@ -0,0 +1,163 @@
+#include "base/mapped_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace avrtc {
+
+std::mutex MappedFile::cache_mutex_;
+std::map<MappedFile::FileKey, std::weak_ptr<MappedFile>> MappedFile::cache_;
+
+/**
+ * 打开并映射文件，同一个文件已经被映射时直接返回已有的映射
+ * @param path 文件路径
+ * @return 映射，失败返回nullptr
+ */
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG(ERROR) << "Failed to open " << path << ", " << strerror(errno);
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        LOG(ERROR) << path << " is not a regular file";
+        close(fd);
+        return nullptr;
+    }
+    FileKey key(st.st_dev, st.st_ino);
+    size_t size = static_cast<size_t>(st.st_size);
+
+    // 析构时要加cache_mutex_，旧映射必须在解锁之后释放，因此在加锁之前定义
+    std::shared_ptr<MappedFile> cached;
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+        cached = it->second.lock();
+        // 文件大小变了说明被改写过，重新映射
+        if (cached && cached->size_ == size) {
+            close(fd);
+            return cached;
+        }
+    }
+
+    uint8_t* data = nullptr;
+    if (size > 0) {
+        void* region = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (region == MAP_FAILED) {
+            LOG(ERROR) << "Failed to map " << path << ", " << strerror(errno);
+            close(fd);
+            return nullptr;
+        }
+        data = static_cast<uint8_t*>(region);
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+    // 映射建立后不再需要fd
+    close(fd);
+    std::shared_ptr<MappedFile> file(new MappedFile(path, key, data, size));
+    cache_[key] = file;
+    return file;
+}
+
+MappedFile::MappedFile(const std::string& path, const FileKey& key,
+                       uint8_t* data, size_t size)
+    : path_(path), key_(key), data_(data), size_(size) {}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+    }
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_.find(key_);
+    // 缓存中可能已经换成了重新映射的对象
+    if (it != cache_.end() && it->second.expired()) {
+        cache_.erase(it);
+    }
+}
+
+/**
+ * 建议内核异步预读一段数据
+ * @param offset 起始偏移
+ * @param length 字节数，超出文件的部分忽略
+ */
+void MappedFile::WillNeed(size_t offset, size_t length) const {
+    if (offset >= size_) {
+        return;
+    }
+    // madvise要求起始地址按页对齐
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page_size * page_size;
+    size_t end = std::min(size_, offset + length);
+    madvise(data_ + begin, end - begin, MADV_WILLNEED);
+}
+
+MappedFileReader::MappedFileReader(std::shared_ptr<MappedFile> file)
+    : file_(std::move(file)) {
+    CHECK(file_ != nullptr);
+}
+
+/**
+ * 从当前位置读取数据
+ * @param buffer 目标缓冲区
+ * @param size 最多读取的字节数
+ * @return 实际读取的字节数，到达文件末尾时返回0
+ */
+size_t MappedFileReader::Read(uint8_t* buffer, size_t size) {
+    size_t file_size = file_->GetSize();
+    if (position_ >= file_size) {
+        return 0;
+    }
+    size = std::min(size, file_size - position_);
+    // 预读范围只剩一半时预读下一段，读取时数据通常已经在页缓存中
+    if (position_ + size + kReadAheadBytes / 2 > advised_end_) {
+        file_->WillNeed(position_, kReadAheadBytes);
+        advised_end_ = position_ + kReadAheadBytes;
+    }
+    memcpy(buffer, file_->GetData() + position_, size);
+    position_ += size;
+    return size;
+}
+
+/**
+ * 移动读取位置
+ * @param offset 偏移
+ * @param whence SEEK_SET、SEEK_CUR或SEEK_END
+ * @return 新的位置，参数无效时返回-1，位置不变
+ */
+int64_t MappedFileReader::Seek(int64_t offset, int whence) {
+    int64_t base;
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = static_cast<int64_t>(position_);
+            break;
+        case SEEK_END:
+            base = static_cast<int64_t>(file_->GetSize());
+            break;
+        default:
+            return -1;
+    }
+    int64_t position = base + offset;
+    if (position < 0) {
+        return -1;
+    }
+    position_ = static_cast<size_t>(position);
+    // 跳出已经预读的范围后，下次读取从新位置重新预读
+    if (position_ >= advised_end_ ||
+        position_ + kReadAheadBytes < advised_end_) {
+        advised_end_ = position_;
+    }
+    return position;
+}
+
+}  // namespace avrtc
@@ -0,0 +1,77 @@
+#ifndef BASE_MAPPED_FILE_H
+#define BASE_MAPPED_FILE_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace avrtc {
+
+/**
+ * 只读映射的文件，整个文件用mmap映射并建议内核顺序预读
+ * 同一个文件（按设备号和inode区分）同时只映射一次，
+ * 多个发送方推同一个媒体文件时共享映射和页缓存，读取时不需要read()拷贝到用户缓冲区
+ * 文件在映射期间被截断时访问会触发SIGBUS，只用于不会被改写的媒体文件
+ */
+class MappedFile {
+ public:
+  static std::shared_ptr<MappedFile> Open(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+  const std::string& GetPath() const { return path_; }
+
+  void WillNeed(size_t offset, size_t length) const;
+
+ private:
+  using FileKey = std::pair<dev_t, ino_t>;
+
+  MappedFile(const std::string& path, const FileKey& key, uint8_t* data,
+             size_t size);
+
+  static std::mutex cache_mutex_;
+  static std::map<FileKey, std::weak_ptr<MappedFile>> cache_;
+
+  std::string path_;
+  FileKey key_;
+  uint8_t* data_;
+  size_t size_;
+};
+
+/**
+ * MappedFile上的读取游标，每个读者一个，只能在一个线程中使用
+ * 读取位置接近已经预读的范围末尾时，用MADV_WILLNEED提前预读后面的一段
+ */
+class MappedFileReader {
+ public:
+  // 每次提前预读的字节数
+  static const size_t kReadAheadBytes = 2 * 1024 * 1024;
+
+  explicit MappedFileReader(std::shared_ptr<MappedFile> file);
+
+  size_t Read(uint8_t* buffer, size_t size);
+  int64_t Seek(int64_t offset, int whence);
+
+  size_t GetPosition() const { return position_; }
+  MappedFile* GetFile() const { return file_.get(); }
+
+ private:
+  std::shared_ptr<MappedFile> file_;
+  size_t position_ = 0;
+  // 已经建议预读到的位置
+  size_t advised_end_ = 0;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_MAPPED_FILE_H
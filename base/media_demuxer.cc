@@ -0,0 +1,501 @@
+#include "base/media_demuxer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <glog/logging.h>
+#include <string.h>
+
+#include <cstring>
+
+namespace avrtc {
+
+/**
+ * 按RFC 7983根据首字节对数据报分类
+ *   [0..3] STUN, [16..19] ZRTP, [20..63] DTLS, [64..79] TURN Channel,
+ *   [128..191] RTP/RTCP，RTP和RTCP再按RFC 5761用第二个字节区分
+ * @param data 数据报
+ * @param length 数据报长度
+ * @return 数据报类型，长度不足或首字节不在上述范围时返回kUnknown
+ */
+PacketKind ClassifyPacket(const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return PacketKind::kUnknown;
+    }
+    uint8_t b = data[0];
+    if (b <= 3) {
+        return PacketKind::kStun;
+    } else if (b >= 16 && b <= 19) {
+        return PacketKind::kZrtp;
+    } else if (b >= 20 && b <= 63) {
+        return PacketKind::kDtls;
+    } else if (b >= 64 && b <= 79) {
+        return PacketKind::kTurnChannel;
+    } else if (b >= 128 && b <= 191) {
+        // RTCP包类型192~223与RTP负载类型64~95（含marker位）重叠，
+        // 动态负载类型不使用这个区间，按RTCP处理
+        if (length >= 8 && data[1] >= 192 && data[1] <= 223) {
+            return PacketKind::kRtcp;
+        }
+        if (length >= 12) {
+            return PacketKind::kRtp;
+        }
+    }
+    return PacketKind::kUnknown;
+}
+
+/**
+ * 取出RTP包的SSRC或RTCP包中发送者的SSRC
+ * @return 是否取到SSRC
+ */
+bool ExtractSsrc(PacketKind kind,
+                 const uint8_t* data,
+                 size_t length,
+                 uint32_t* ssrc) {
+    size_t offset;
+    if (kind == PacketKind::kRtp) {
+        offset = 8;
+    } else if (kind == PacketKind::kRtcp) {
+        offset = 4;
+    } else {
+        return false;
+    }
+    if (length < offset + 4) {
+        return false;
+    }
+    uint32_t be_ssrc;
+    memcpy(&be_ssrc, data + offset, sizeof(be_ssrc));
+    *ssrc = ntohl(be_ssrc);
+    return true;
+}
+
+FiveTuple::FiveTuple(const SocketAddress& remote, const SocketAddress& local)
+    : remote_ip(ntohl(remote.GetIP())),
+      local_ip(ntohl(local.GetIP())),
+      remote_port(remote.GetPort()),
+      local_port(local.GetPort()) {}
+
+/**
+ * 构造函数
+ * @param capacity 期望容纳的表项数，实际槽位数取不小于2倍的2的幂，
+ *                 使负载因子不超过0.5，探测链保持很短
+ */
+FlowTable::FlowTable(size_t capacity) {
+    size_t slot_count = 16;
+    while (slot_count < capacity * 2) {
+        slot_count <<= 1;
+    }
+    slots_ = std::make_unique<Slot[]>(slot_count);
+    mask_ = slot_count - 1;
+    max_used_ = slot_count - slot_count / 4;
+}
+
+/**
+ * 插入或更新表项
+ * @return 是否成功，表满时返回false
+ */
+bool FlowTable::Insert(const Key& key, uint64_t value) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    size_t index = FindIndexLocked(key);
+    if (index != SIZE_MAX) {
+        WriteSlot(&slots_[index], kOccupied, key, value);
+        return true;
+    }
+
+    // 复用探测链上的第一个墓碑或空槽位
+    for (size_t i = Hash(key) & mask_;; i = (i + 1) & mask_) {
+        uint32_t state = slots_[i].state.load(std::memory_order_relaxed);
+        if (state == kOccupied) {
+            continue;
+        }
+        if (state == kEmpty) {
+            if (used_ >= max_used_) {
+                if (size_.load(std::memory_order_relaxed) >= max_used_) {
+                    LOG(WARNING) << "FlowTable is full";
+                    return false;
+                }
+                // 墓碑占满了配额，整理后重新探测
+                CompactLocked();
+                i = (Hash(key) - 1) & mask_;
+                continue;
+            }
+            ++used_;
+        }
+        WriteSlot(&slots_[i], kOccupied, key, value);
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+}
+
+/**
+ * 删除表项
+ * 槽位的下一个槽位为空时，没有探测链会经过它，可以直接置空而不留墓碑，
+ * 并向前回收紧挨着的墓碑
+ * @return 表项是否存在
+ */
+bool FlowTable::Erase(const Key& key) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    size_t index = FindIndexLocked(key);
+    if (index == SIZE_MAX) {
+        return false;
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+
+    size_t next = (index + 1) & mask_;
+    if (slots_[next].state.load(std::memory_order_relaxed) != kEmpty) {
+        WriteSlot(&slots_[index], kTombstone, Key(), 0);
+        return true;
+    }
+    WriteSlot(&slots_[index], kEmpty, Key(), 0);
+    --used_;
+    for (size_t i = (index - 1) & mask_;
+         slots_[i].state.load(std::memory_order_relaxed) == kTombstone;
+         i = (i - 1) & mask_) {
+        WriteSlot(&slots_[i], kEmpty, Key(), 0);
+        --used_;
+    }
+    return true;
+}
+
+/**
+ * 无锁查找，可以和写操作以及其他读者并发执行
+ * @param key 键
+ * @param value 输出值
+ * @return 是否找到
+ */
+bool FlowTable::Find(const Key& key, uint64_t* value) const {
+    for (;;) {
+        uint32_t seq = compaction_seq_.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        for (size_t i = Hash(key) & mask_, n = 0; n <= mask_;
+             i = (i + 1) & mask_, ++n) {
+            uint32_t state;
+            Key slot_key;
+            uint64_t slot_value;
+            ReadSlot(slots_[i], &state, &slot_key, &slot_value);
+            if (state == kEmpty) {
+                break;
+            }
+            if (state == kOccupied && slot_key.hi == key.hi &&
+                slot_key.lo == key.lo) {
+                *value = slot_value;
+                return true;
+            }
+        }
+        // 命中总是可信的；未命中时若期间发生过整理，表项可能刚被搬走，重试
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (compaction_seq_.load(std::memory_order_relaxed) == seq) {
+            return false;
+        }
+    }
+}
+
+uint64_t FlowTable::Hash(const Key& key) {
+    // splitmix64的混合函数
+    uint64_t h = key.hi ^ (key.lo * 0x9E3779B97F4A7C15ULL);
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+/**
+ * seqlock读：序号为奇数表示写者正在修改，前后序号不一致表示读到了中间状态
+ */
+void FlowTable::ReadSlot(const Slot& slot,
+                         uint32_t* state,
+                         Key* key,
+                         uint64_t* value) const {
+    for (;;) {
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        *state = slot.state.load(std::memory_order_relaxed);
+        key->hi = slot.hi.load(std::memory_order_relaxed);
+        key->lo = slot.lo.load(std::memory_order_relaxed);
+        *value = slot.value.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == seq) {
+            return;
+        }
+    }
+}
+
+/**
+ * seqlock写，调用者必须持有write_mutex_
+ */
+void FlowTable::WriteSlot(Slot* slot,
+                          uint32_t state,
+                          const Key& key,
+                          uint64_t value) {
+    uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->state.store(state, std::memory_order_relaxed);
+    slot->hi.store(key.hi, std::memory_order_relaxed);
+    slot->lo.store(key.lo, std::memory_order_relaxed);
+    slot->value.store(value, std::memory_order_relaxed);
+    slot->seq.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * 写者查找已占用的槽位，调用者必须持有write_mutex_
+ * @return 槽位下标，不存在时返回SIZE_MAX
+ */
+size_t FlowTable::FindIndexLocked(const Key& key) const {
+    for (size_t i = Hash(key) & mask_, n = 0; n <= mask_;
+         i = (i + 1) & mask_, ++n) {
+        const Slot& slot = slots_[i];
+        uint32_t state = slot.state.load(std::memory_order_relaxed);
+        if (state == kEmpty) {
+            break;
+        }
+        if (state == kOccupied &&
+            slot.hi.load(std::memory_order_relaxed) == key.hi &&
+            slot.lo.load(std::memory_order_relaxed) == key.lo) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+/**
+ * 原地清除墓碑，调用者必须持有write_mutex_
+ * 从一个空槽位开始顺序扫描，把每个表项搬到其探测链上的第一个墓碑：
+ * 先写新位置再清旧位置，读者在任何时刻都至少能看到一份；
+ * 扫描结束后剩下的墓碑不在任何表项的探测链上，可以全部置空
+ */
+void FlowTable::CompactLocked() {
+    compaction_seq_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t start = 0;
+    while (slots_[start].state.load(std::memory_order_relaxed) != kEmpty) {
+        ++start;
+    }
+    for (size_t n = 1; n <= mask_; ++n) {
+        size_t i = (start + n) & mask_;
+        Slot& slot = slots_[i];
+        if (slot.state.load(std::memory_order_relaxed) != kOccupied) {
+            continue;
+        }
+        Key key;
+        key.hi = slot.hi.load(std::memory_order_relaxed);
+        key.lo = slot.lo.load(std::memory_order_relaxed);
+        for (size_t j = Hash(key) & mask_; j != i; j = (j + 1) & mask_) {
+            if (slots_[j].state.load(std::memory_order_relaxed) ==
+                kTombstone) {
+                WriteSlot(&slots_[j], kOccupied, key,
+                          slot.value.load(std::memory_order_relaxed));
+                WriteSlot(&slot, kTombstone, Key(), 0);
+                break;
+            }
+        }
+    }
+    for (size_t i = 0; i <= mask_; ++i) {
+        if (slots_[i].state.load(std::memory_order_relaxed) == kTombstone) {
+            WriteSlot(&slots_[i], kEmpty, Key(), 0);
+        }
+    }
+    used_ = size_.load(std::memory_order_relaxed);
+
+    compaction_seq_.fetch_add(1, std::memory_order_release);
+}
+
+MediaRouter::MediaRouter(size_t capacity)
+    : flows_(capacity), ssrcs_(capacity) {}
+
+bool MediaRouter::AddFlow(const FiveTuple& tuple, SessionId id) {
+    return flows_.Insert(TupleKey(tuple), id);
+}
+
+bool MediaRouter::RemoveFlow(const FiveTuple& tuple) {
+    return flows_.Erase(TupleKey(tuple));
+}
+
+bool MediaRouter::AddSsrc(uint32_t ssrc, SessionId id) {
+    return ssrcs_.Insert(SsrcKey(ssrc), id);
+}
+
+/**
+ * 删除SSRC，并删除通过这个SSRC学到的5元组
+ * @return SSRC是否存在
+ */
+bool MediaRouter::RemoveSsrc(uint32_t ssrc) {
+    std::lock_guard<std::mutex> lock(learned_mutex_);
+    bool removed = ssrcs_.Erase(SsrcKey(ssrc));
+    auto it = learned_.find(ssrc);
+    if (it != learned_.end()) {
+        for (const LearnedFlow& flow : it->second) {
+            EraseLearnedFlow(flow);
+        }
+        learned_.erase(it);
+    }
+    return removed;
+}
+
+/**
+ * 查找数据报所属的会话
+ * 先按5元组查找；RTP/RTCP找不到时再按SSRC查找，
+ * 命中后记住新的5元组（对端NAT重新映射或首次发包），后续包走快速路径
+ * @note SSRC学习只适用于已经通过信令确认的SSRC，不做来源校验；
+ *       每个SSRC最多保留kMaxLearnedFlows个学到的5元组
+ * @return 是否找到会话
+ */
+bool MediaRouter::Route(const FiveTuple& tuple,
+                        PacketKind kind,
+                        const uint8_t* data,
+                        size_t length,
+                        SessionId* id) {
+    FlowTable::Key key = TupleKey(tuple);
+    if (flows_.Find(key, id)) {
+        return true;
+    }
+    uint32_t ssrc;
+    if (ExtractSsrc(kind, data, length, &ssrc) &&
+        ssrcs_.Find(SsrcKey(ssrc), id)) {
+        LearnFlow(ssrc, key, *id);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * 记住SSRC命中的5元组
+ * 在锁内重新确认SSRC仍然映射到该会话，避免和RemoveSsrc()并发时留下学到的5元组
+ */
+void MediaRouter::LearnFlow(uint32_t ssrc,
+                            const FlowTable::Key& key,
+                            SessionId id) {
+    std::lock_guard<std::mutex> lock(learned_mutex_);
+    SessionId current;
+    if (!ssrcs_.Find(SsrcKey(ssrc), &current) || current != id ||
+        flows_.Find(key, &current)) {
+        return;
+    }
+    if (!flows_.Insert(key, id)) {
+        return;
+    }
+    std::deque<LearnedFlow>& flows = learned_[ssrc];
+    flows.push_back(LearnedFlow{key, id});
+    if (flows.size() > kMaxLearnedFlows) {
+        EraseLearnedFlow(flows.front());
+        flows.pop_front();
+    }
+}
+
+/**
+ * 删除学到的5元组，已经被AddFlow()改为其他会话的不删除
+ */
+void MediaRouter::EraseLearnedFlow(const LearnedFlow& flow) {
+    SessionId current;
+    if (flows_.Find(flow.key, &current) && current == flow.id) {
+        flows_.Erase(flow.key);
+    }
+}
+
+FlowTable::Key MediaRouter::TupleKey(const FiveTuple& tuple) {
+    FlowTable::Key key;
+    key.hi = static_cast<uint64_t>(tuple.remote_ip) << 32 | tuple.local_ip;
+    key.lo = static_cast<uint64_t>(tuple.remote_port) << 48 |
+             static_cast<uint64_t>(tuple.local_port) << 32 | tuple.protocol;
+    return key;
+}
+
+FlowTable::Key MediaRouter::SsrcKey(uint32_t ssrc) {
+    FlowTable::Key key;
+    key.hi = ssrc;
+    return key;
+}
+
+/**
+ * 构造函数，创建并绑定共享媒体端口
+ * @param router 路由表，可以被多个解复用器共享
+ * @param local 本地地址，多个解复用器使用同一个端口
+ */
+MediaDemuxer::MediaDemuxer(std::shared_ptr<MediaRouter> router,
+                           SocketAddress local)
+    : router_(router),
+      socket_(local),
+      recv_buffer_(kMaxDatagramsPerRead * kMaxDatagramSize),
+      datagrams_(kMaxDatagramsPerRead) {
+    socket_.Bind(true);
+    socket_.SetNonBlocking();
+    // 到达时间取内核时间戳，CPU繁忙时读取延迟不会计入抖动
+    socket_.EnableReceiveTimestamps(UdpSocket::TimestampMode::kSoftware);
+}
+
+/**
+ * 将媒体端口加入事件循环
+ * @param loop 反应器线程的事件循环
+ * @return 是否成功
+ */
+bool MediaDemuxer::Attach(EventLoop* loop) {
+    auto on_event = [this](uint32_t events) {
+        // 零拷贝发送的完成通知在错误队列中，不读空会持续触发EPOLLERR
+        if (events & EPOLLERR)
+            socket_.HandleErrorQueue();
+        HandleRead();
+    };
+    if (!loop->AddFD(socket_.GetFD(), EPOLLIN, on_event)) {
+        return false;
+    }
+    loop_ = loop;
+    return true;
+}
+
+void MediaDemuxer::Detach() {
+    if (loop_ != nullptr) {
+        loop_->RemoveFD(socket_.GetFD());
+        loop_ = nullptr;
+    }
+}
+
+/**
+ * 媒体端口可读，用recvmmsg批量读取数据报并逐个分发
+ */
+void MediaDemuxer::HandleRead() {
+    int count = socket_.RecvBatch(recv_buffer_.data(), kMaxDatagramSize,
+                                  datagrams_.data(), kMaxDatagramsPerRead);
+    if (count < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            LOG(ERROR) << "Recvmmsg failed: " << strerror(errno);
+        }
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        const UdpSocket::Datagram& datagram = datagrams_[i];
+        Demux(datagram.data, datagram.length, datagram.from,
+              datagram.arrival_ns);
+    }
+}
+
+/**
+ * 分发一个数据报
+ * @param data 数据报
+ * @param length 数据报长度
+ * @param from 对端地址
+ * @param arrival_ns 到达时间
+ */
+void MediaDemuxer::Demux(char* data,
+                         size_t length,
+                         const SocketAddress& from,
+                         int64_t arrival_ns) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    PacketKind kind = ClassifyPacket(bytes, length);
+    if (kind == PacketKind::kUnknown) {
+        return;
+    }
+
+    SessionId id;
+    FiveTuple tuple(from, socket_.address_);
+    if (router_->Route(tuple, kind, bytes, length, &id)) {
+        if (OnPacket_)
+            OnPacket_(id, kind, data, length, from, arrival_ns);
+    } else if (OnUnknownFlow_) {
+        OnUnknownFlow_(kind, data, length, from);
+    }
+}
+
+}  // namespace avrtc
@@ -0,0 +1,200 @@
+#ifndef BASE_MEDIA_DEMUXER_H
+#define BASE_MEDIA_DEMUXER_H
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "base/event_loop.h"
+#include "base/socket.h"
+
+namespace avrtc {
+
+// 按RFC 7983根据首字节区分的数据报类型
+enum class PacketKind {
+  kStun,
+  kZrtp,
+  kDtls,
+  kTurnChannel,
+  kRtp,
+  kRtcp,
+  kUnknown
+};
+
+PacketKind ClassifyPacket(const uint8_t* data, size_t length);
+bool ExtractSsrc(PacketKind kind,
+                 const uint8_t* data,
+                 size_t length,
+                 uint32_t* ssrc);
+
+// 数据报的5元组，IP和端口均为主机字节序
+struct FiveTuple {
+  uint32_t remote_ip = 0;
+  uint32_t local_ip = 0;
+  uint16_t remote_port = 0;
+  uint16_t local_port = 0;
+  uint8_t protocol = IPPROTO_UDP;
+
+  FiveTuple() = default;
+  FiveTuple(const SocketAddress& remote, const SocketAddress& local);
+};
+
+/**
+ * 开放寻址（线性探测）哈希表，键为128位，值为64位
+ * 写操作用互斥锁串行化，读操作无锁：每个槽位带一个seqlock序号，
+ * 读者发现序号为奇数或前后不一致时重读该槽位，因此多个反应器线程可以并发查找
+ * 容量在构造时固定，不会扩容（扩容需要搬移槽位，读者无法无锁地跟上）；
+ * 墓碑堆积时原地整理，整理期间未命中的读者按compaction_seq_重试
+ */
+class FlowTable {
+ public:
+  struct Key {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+  };
+
+  explicit FlowTable(size_t capacity);
+
+  bool Insert(const Key& key, uint64_t value);
+  bool Erase(const Key& key);
+  bool Find(const Key& key, uint64_t* value) const;
+  size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+ private:
+  enum State : uint32_t { kEmpty = 0, kOccupied = 1, kTombstone = 2 };
+
+  struct Slot {
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint32_t> state{kEmpty};
+    std::atomic<uint64_t> hi{0};
+    std::atomic<uint64_t> lo{0};
+    std::atomic<uint64_t> value{0};
+  };
+
+  static uint64_t Hash(const Key& key);
+  void ReadSlot(const Slot& slot,
+                uint32_t* state,
+                Key* key,
+                uint64_t* value) const;
+  void WriteSlot(Slot* slot, uint32_t state, const Key& key, uint64_t value);
+  size_t FindIndexLocked(const Key& key) const;
+  void CompactLocked();
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  size_t max_used_;  // 已占用加墓碑的上限，保持探测链足够短
+  size_t used_ = 0;  // 已占用加墓碑的槽位数，仅写者访问
+  std::atomic<size_t> size_{0};
+  std::atomic<uint32_t> compaction_seq_{0};  // 奇数表示正在整理
+  std::mutex write_mutex_;
+};
+
+/**
+ * 媒体路由表：远端5元组到会话的映射，SSRC到会话的映射作为后备
+ * 可以被多个MediaDemuxer（各自运行在一个反应器线程中）共享
+ * 通过SSRC学到的5元组记在对应的SSRC下，RemoveSsrc()时一并删除
+ */
+class MediaRouter {
+ public:
+  using SessionId = uint64_t;
+
+  // 每个SSRC最多保留的学习到的5元组，超过时淘汰最早学到的
+  static const size_t kMaxLearnedFlows = 4;
+
+  explicit MediaRouter(size_t capacity = 1 << 16);
+
+  bool AddFlow(const FiveTuple& tuple, SessionId id);
+  bool RemoveFlow(const FiveTuple& tuple);
+  bool AddSsrc(uint32_t ssrc, SessionId id);
+  bool RemoveSsrc(uint32_t ssrc);
+
+  bool Route(const FiveTuple& tuple,
+             PacketKind kind,
+             const uint8_t* data,
+             size_t length,
+             SessionId* id);
+
+ private:
+  static FlowTable::Key TupleKey(const FiveTuple& tuple);
+  static FlowTable::Key SsrcKey(uint32_t ssrc);
+
+  struct LearnedFlow {
+    FlowTable::Key key;
+    SessionId id;
+  };
+
+  void LearnFlow(uint32_t ssrc, const FlowTable::Key& key, SessionId id);
+  void EraseLearnedFlow(const LearnedFlow& flow);
+
+  FlowTable flows_;
+  FlowTable ssrcs_;
+  // 只在学习新5元组和删除SSRC时访问，不在快速路径上
+  std::mutex learned_mutex_;
+  std::unordered_map<uint32_t, std::deque<LearnedFlow>> learned_;
+};
+
+/**
+ * 单端口媒体解复用器：在一个UDP端口上接收所有会话的数据报，
+ * 按RFC 7983分类后经MediaRouter分发给对应的会话
+ * 每个反应器线程一个实例，通过SO_REUSEPORT绑定同一端口并共享同一个路由表
+ */
+class MediaDemuxer {
+ public:
+  using SessionId = MediaRouter::SessionId;
+  // data指向解复用器内部的接收缓冲区，仅在回调期间有效；
+  // arrival_ns是内核接收时间（CLOCK_REALTIME纳秒），用于抖动和码率估计
+  using OnPacketCallback = std::function<void(SessionId id,
+                                              PacketKind kind,
+                                              char* data,
+                                              size_t length,
+                                              const SocketAddress& from,
+                                              int64_t arrival_ns)>;
+  // 无法路由的数据报，例如新会话的第一个STUN请求，由上层完成绑定
+  using OnUnknownFlowCallback = std::function<void(PacketKind kind,
+                                                   char* data,
+                                                   size_t length,
+                                                   const SocketAddress& from)>;
+
+  // 一次可读事件最多处理的数据报数，避免一个繁忙端口饿死同一循环中的其他fd
+  static const int kMaxDatagramsPerRead = 64;
+  static const size_t kMaxDatagramSize = 2048;
+
+  MediaDemuxer(std::shared_ptr<MediaRouter> router, SocketAddress local);
+
+  bool Attach(EventLoop* loop);
+  void Detach();
+  void HandleRead();
+  void Demux(char* data,
+             size_t length,
+             const SocketAddress& from,
+             int64_t arrival_ns);
+
+  void SetOnPacket(OnPacketCallback cb) { OnPacket_ = cb; }
+  void SetOnUnknownFlow(OnUnknownFlowCallback cb) { OnUnknownFlow_ = cb; }
+
+  UdpSocket* GetSocket() { return &socket_; }
+  MediaRouter* GetRouter() { return router_.get(); }
+
+ private:
+  std::shared_ptr<MediaRouter> router_;
+  UdpSocket socket_;
+  EventLoop* loop_ = nullptr;
+  // 一次recvmmsg的接收缓冲区，每个数据报kMaxDatagramSize字节
+  std::vector<char> recv_buffer_;
+  std::vector<UdpSocket::Datagram> datagrams_;
+
+  OnPacketCallback OnPacket_;
+  OnUnknownFlowCallback OnUnknownFlow_;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_MEDIA_DEMUXER_H
@@ -0,0 +1,178 @@
+#ifndef BASE_MPSC_QUEUE_H
+#define BASE_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace avrtc {
+
+/**
+ * 无锁多生产者单消费者队列，元素存放在固定大小的段中，段用链表连接
+ * 生产者用CAS在全局位置上占一个槽位，写入后设置槽位的就绪标志；
+ * 占到段中最后一个槽位的生产者负责挂上下一段，其他生产者在这期间短暂等待
+ * 消费者按顺序读取，读完一段后把它留作下一次挂段的备用段，稳定状态下不再分配内存
+ * 生产者写入完成之前，后面的槽位即使已经就绪也不会被读出，保持先进先出
+ */
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() {
+    Block* block = new Block;
+    tail_block_.store(block, std::memory_order_relaxed);
+    head_block_ = block;
+  }
+
+  ~MpscQueue() {
+    T value;
+    while (Pop(&value)) {
+    }
+    delete head_block_;
+    delete spare_block_.load(std::memory_order_relaxed);
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  /**
+   * 入队，可以在任意线程中调用
+   */
+  void Push(T value) {
+    size_t tail = tail_index_.load(std::memory_order_acquire);
+    Block* block = tail_block_.load(std::memory_order_acquire);
+    Block* next_block = nullptr;
+    for (;;) {
+      size_t offset = tail % kLap;
+      // 另一个生产者正在挂下一段
+      if (offset == kBlockCapacity) {
+        std::this_thread::yield();
+        tail = tail_index_.load(std::memory_order_acquire);
+        block = tail_block_.load(std::memory_order_acquire);
+        continue;
+      }
+      // 可能占到最后一个槽位，提前准备好下一段，缩短其他生产者等待的时间
+      if (offset + 1 == kBlockCapacity && next_block == nullptr) {
+        next_block = AcquireBlock();
+      }
+      if (tail_index_.compare_exchange_weak(tail, tail + 1,
+                                            std::memory_order_seq_cst,
+                                            std::memory_order_acquire)) {
+        if (offset + 1 == kBlockCapacity) {
+          tail_block_.store(next_block, std::memory_order_release);
+          tail_index_.fetch_add(1, std::memory_order_release);
+          block->next.store(next_block, std::memory_order_release);
+          next_block = nullptr;
+        }
+        Slot& slot = block->slots[offset];
+        new (slot.storage) T(std::move(value));
+        slot.ready.store(true, std::memory_order_release);
+        break;
+      }
+      block = tail_block_.load(std::memory_order_acquire);
+    }
+    if (next_block != nullptr) {
+      ReleaseBlock(next_block);
+    }
+  }
+
+  /**
+   * 出队，只能在消费者线程中调用
+   * @param value 取出的元素
+   * @return 是否取到，队头的生产者还没写完时同样返回false
+   */
+  bool Pop(T* value) {
+    size_t offset = head_index_ % kLap;
+    Slot& slot = head_block_->slots[offset];
+    if (!slot.ready.load(std::memory_order_acquire)) {
+      return false;
+    }
+    T* item = reinterpret_cast<T*>(slot.storage);
+    *value = std::move(*item);
+    item->~T();
+
+    if (offset + 1 == kBlockCapacity) {
+      // 最后一个槽位就绪时，写入它的生产者已经挂好了下一段
+      Block* next = head_block_->next.load(std::memory_order_acquire);
+      ReleaseBlock(head_block_);
+      head_block_ = next;
+      head_index_ += 2;
+    } else {
+      ++head_index_;
+    }
+    return true;
+  }
+
+  /**
+   * 查看队头元素但不取出，只能在消费者线程中调用
+   * @return 队头元素，没有可读的元素时返回nullptr，指针在下一次Pop()之前有效
+   */
+  T* Front() {
+    Slot& slot = head_block_->slots[head_index_ % kLap];
+    if (!slot.ready.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return reinterpret_cast<T*>(slot.storage);
+  }
+
+  /**
+   * 队头是否没有可读的元素，只能在消费者线程中调用
+   */
+  bool Empty() const {
+    size_t offset = head_index_ % kLap;
+    return !head_block_->slots[offset].ready.load(std::memory_order_acquire);
+  }
+
+ private:
+  // 位置按kLap计数，每段的最后一个位置不对应槽位，表示正在挂下一段
+  static const size_t kLap = 32;
+  static const size_t kBlockCapacity = kLap - 1;
+
+  struct Slot {
+    std::atomic<bool> ready{false};
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  struct Block {
+    std::atomic<Block*> next{nullptr};
+    Slot slots[kBlockCapacity];
+  };
+
+  /**
+   * 取一个空段，优先使用消费者归还的备用段
+   */
+  Block* AcquireBlock() {
+    Block* block = spare_block_.exchange(nullptr, std::memory_order_acquire);
+    return block != nullptr ? block : new Block;
+  }
+
+  /**
+   * 归还一个已经读完或没有用上的段，只保留一个备用段
+   */
+  void ReleaseBlock(Block* block) {
+    block->next.store(nullptr, std::memory_order_relaxed);
+    for (Slot& slot : block->slots) {
+      slot.ready.store(false, std::memory_order_relaxed);
+    }
+    Block* expected = nullptr;
+    if (!spare_block_.compare_exchange_strong(expected, block,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+      delete block;
+    }
+  }
+
+  alignas(64) std::atomic<size_t> tail_index_{0};
+  std::atomic<Block*> tail_block_{nullptr};
+  std::atomic<Block*> spare_block_{nullptr};
+
+  // 只由消费者访问
+  alignas(64) size_t head_index_ = 0;
+  Block* head_block_ = nullptr;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_MPSC_QUEUE_H
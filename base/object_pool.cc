@@ -0,0 +1,98 @@
+#include "base/object_pool.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace avrtc {
+
+/**
+ * 构造函数
+ * @param blocks_per_chunk 空闲链表耗尽时一次申请的块数
+ */
+BlockPool::BlockPool(size_t blocks_per_chunk)
+    : blocks_per_chunk_(blocks_per_chunk) {
+    CHECK(blocks_per_chunk_ > 0);
+}
+
+/**
+ * 析构函数，释放所有块组，调用者必须保证所有块都已经归还
+ */
+BlockPool::~BlockPool() {
+    for (void* chunk : chunks_) {
+        ::operator delete(chunk);
+    }
+}
+
+/**
+ * 分配一个块
+ * @param size 请求的字节数
+ * @return 块地址，按max_align_t对齐
+ */
+void* BlockPool::Allocate(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (block_size_ == 0) {
+        // 块大小向上取整到对齐边界，同时要能放下空闲链表指针
+        const size_t align = alignof(std::max_align_t);
+        block_size_ = std::max(size, sizeof(FreeBlock));
+        block_size_ = (block_size_ + align - 1) / align * align;
+    }
+    if (size > block_size_) {
+        return ::operator new(size);
+    }
+    if (free_list_ == nullptr) {
+        Refill();
+    }
+    FreeBlock* block = free_list_;
+    free_list_ = block->next;
+    --free_count_;
+    return block;
+}
+
+/**
+ * 归还一个块
+ * @param p 块地址
+ * @param size 分配时请求的字节数
+ */
+void BlockPool::Deallocate(void* p, size_t size) {
+    if (p == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size > block_size_) {
+        ::operator delete(p);
+        return;
+    }
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = free_list_;
+    free_list_ = block;
+    ++free_count_;
+}
+
+size_t BlockPool::GetBlockSize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return block_size_;
+}
+
+size_t BlockPool::GetFreeCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_count_;
+}
+
+/**
+ * 申请一个新的块组并切分到空闲链表，调用者必须持有mutex_
+ */
+void BlockPool::Refill() {
+    char* chunk =
+        static_cast<char*>(::operator new(block_size_ * blocks_per_chunk_));
+    chunks_.push_back(chunk);
+    for (size_t i = blocks_per_chunk_; i > 0; --i) {
+        FreeBlock* block =
+            reinterpret_cast<FreeBlock*>(chunk + (i - 1) * block_size_);
+        block->next = free_list_;
+        free_list_ = block;
+    }
+    free_count_ += blocks_per_chunk_;
+}
+
+}  // namespace avrtc
@@ -0,0 +1,85 @@
+#ifndef BASE_OBJECT_POOL_H
+#define BASE_OBJECT_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace avrtc {
+
+/**
+ * 定长内存块池，按块组批量向系统申请内存，释放的块挂在空闲链表上复用，
+ * 大量同类对象反复创建销毁时（例如连接）避免频繁的malloc/free和内存碎片
+ * 块大小由第一次分配决定，大小不同的请求直接交给operator new
+ * 线程安全，对象可以在任意线程中释放
+ */
+class BlockPool {
+ public:
+  explicit BlockPool(size_t blocks_per_chunk = 256);
+  ~BlockPool();
+
+  BlockPool(const BlockPool&) = delete;
+  BlockPool& operator=(const BlockPool&) = delete;
+
+  void* Allocate(size_t size);
+  void Deallocate(void* p, size_t size);
+
+  size_t GetBlockSize();
+  size_t GetFreeCount();
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  void Refill();
+
+  const size_t blocks_per_chunk_;
+  size_t block_size_ = 0;
+  FreeBlock* free_list_ = nullptr;
+  size_t free_count_ = 0;
+  std::vector<void*> chunks_;
+  std::mutex mutex_;
+};
+
+/**
+ * 从BlockPool分配内存的分配器，配合std::allocate_shared使用时，
+ * 对象和shared_ptr控制块在同一个池化的块中
+ * 分配器持有池的引用，池在最后一个对象释放后才销毁
+ */
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  explicit PoolAllocator(std::shared_ptr<BlockPool> pool)
+      : pool_(std::move(pool)) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other) : pool_(other.pool_) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(pool_->Allocate(n * sizeof(T)));
+  }
+  void deallocate(T* p, size_t n) { pool_->Deallocate(p, n * sizeof(T)); }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>& other) const {
+    return pool_ == other.pool_;
+  }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>& other) const {
+    return pool_ != other.pool_;
+  }
+
+ private:
+  template <typename U>
+  friend class PoolAllocator;
+
+  std::shared_ptr<BlockPool> pool_;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_OBJECT_POOL_H
@@ -0,0 +1,145 @@
+#include "base/rate_limiter.h"
+
+#include <algorithm>
+
+namespace avrtc {
+
+/**
+ * 构造函数，桶初始是满的
+ * @param rate_per_sec 每秒补充的令牌数，0表示不限制
+ * @param burst 最多积累的令牌数，允许的突发量
+ */
+TokenBucket::TokenBucket(double rate_per_sec, double burst)
+    : rate_per_sec_(rate_per_sec), burst_(burst), tokens_(burst) {}
+
+/**
+ * 令牌足够时取走amount个
+ * @param amount 令牌数
+ * @param now_ns 当前时间，单调时钟纳秒
+ * @return 是否取走，不足时不取
+ */
+bool TokenBucket::TryConsume(double amount, int64_t now_ns) {
+    if (!IsLimited()) {
+        return true;
+    }
+    Refill(now_ns);
+    if (tokens_ < amount) {
+        return false;
+    }
+    tokens_ -= amount;
+    return true;
+}
+
+/**
+ * 无条件取走amount个令牌，不足时记为欠额，之后补充的令牌先还欠额
+ * 用于已经发生、无法拒绝的消耗，例如已经从socket读出的字节
+ */
+void TokenBucket::Consume(double amount, int64_t now_ns) {
+    if (!IsLimited()) {
+        return;
+    }
+    Refill(now_ns);
+    tokens_ -= amount;
+}
+
+double TokenBucket::GetTokens(int64_t now_ns) {
+    if (!IsLimited()) {
+        return burst_;
+    }
+    Refill(now_ns);
+    return tokens_;
+}
+
+/**
+ * 距离积累到amount个令牌还需要等待的时间
+ * @return 纳秒，已经足够时返回0
+ */
+int64_t TokenBucket::GetWaitNs(double amount, int64_t now_ns) {
+    if (!IsLimited()) {
+        return 0;
+    }
+    Refill(now_ns);
+    if (tokens_ >= amount) {
+        return 0;
+    }
+    return static_cast<int64_t>((amount - tokens_) / rate_per_sec_ * 1e9);
+}
+
+void TokenBucket::Refill(int64_t now_ns) {
+    if (last_refill_ns_ >= 0 && now_ns > last_refill_ns_) {
+        tokens_ += (now_ns - last_refill_ns_) * rate_per_sec_ / 1e9;
+        tokens_ = std::min(tokens_, burst_);
+    }
+    if (now_ns > last_refill_ns_) {
+        last_refill_ns_ = now_ns;
+    }
+}
+
+/**
+ * 新连接的准入
+ * @return 是否接受，接受后连接断开时必须调用ReleaseConnection()
+ */
+bool AdmissionController::TryAdmitConnection() {
+    if (limits_.max_connections > 0 &&
+        connections_ >= limits_.max_connections) {
+        ++rejected_connections_;
+        return false;
+    }
+    ++connections_;
+    return true;
+}
+
+void AdmissionController::ReleaseConnection() {
+    if (connections_ > 0) {
+        --connections_;
+    }
+}
+
+/**
+ * 以发送者或接收者身份加入房间
+ * @param room 房间名
+ * @param role 身份
+ * @return 是否加入，加入后离开时必须调用Leave()
+ */
+bool AdmissionController::TryJoin(const std::string& room, Role role) {
+    RoomMembers& members = rooms_[room];
+    size_t& count =
+        role == Role::kSender ? members.senders : members.receivers;
+    size_t limit = role == Role::kSender ? limits_.max_senders_per_room
+                                         : limits_.max_receivers_per_room;
+    if (limit > 0 && count >= limit) {
+        ++rejected_joins_;
+        if (members.senders == 0 && members.receivers == 0) {
+            rooms_.erase(room);
+        }
+        return false;
+    }
+    ++count;
+    return true;
+}
+
+void AdmissionController::Leave(const std::string& room, Role role) {
+    auto it = rooms_.find(room);
+    if (it == rooms_.end()) {
+        return;
+    }
+    size_t& count =
+        role == Role::kSender ? it->second.senders : it->second.receivers;
+    if (count > 0) {
+        --count;
+    }
+    if (it->second.senders == 0 && it->second.receivers == 0) {
+        rooms_.erase(it);
+    }
+}
+
+size_t AdmissionController::GetMemberCount(const std::string& room,
+                                           Role role) const {
+    auto it = rooms_.find(room);
+    if (it == rooms_.end()) {
+        return 0;
+    }
+    return role == Role::kSender ? it->second.senders : it->second.receivers;
+}
+
+}  // namespace avrtc
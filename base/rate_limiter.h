@@ -0,0 +1,83 @@
+#ifndef BASE_RATE_LIMITER_H
+#define BASE_RATE_LIMITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace avrtc {
+
+/**
+ * 令牌桶，按固定速率补充令牌，最多积累burst个
+ * 令牌在使用时按经过的时间惰性补充，不需要定时器
+ * 速率为0表示不限制
+ * 非线程安全
+ */
+class TokenBucket {
+ public:
+  TokenBucket() = default;
+  TokenBucket(double rate_per_sec, double burst);
+
+  bool IsLimited() const { return rate_per_sec_ > 0; }
+
+  bool TryConsume(double amount, int64_t now_ns);
+  void Consume(double amount, int64_t now_ns);
+  double GetTokens(int64_t now_ns);
+  int64_t GetWaitNs(double amount, int64_t now_ns);
+
+ private:
+  void Refill(int64_t now_ns);
+
+  double rate_per_sec_ = 0;
+  double burst_ = 0;
+  double tokens_ = 0;
+  int64_t last_refill_ns_ = -1;
+};
+
+/**
+ * 服务器级的准入控制：总连接数上限和每个房间的发送者、接收者数量上限
+ * 超过上限的连接在accept之后立即关闭，加入房间的请求直接拒绝，
+ * 过载时只拒绝新来的工作，不影响已经接入的客户端
+ * 上限为0表示不限制
+ * 非线程安全，在服务器的事件循环线程中使用
+ */
+class AdmissionController {
+ public:
+  enum class Role { kSender, kReceiver };
+
+  struct Limits {
+    size_t max_connections = 0;
+    size_t max_senders_per_room = 0;
+    size_t max_receivers_per_room = 0;
+  };
+
+  void SetLimits(const Limits& limits) { limits_ = limits; }
+  const Limits& GetLimits() const { return limits_; }
+
+  bool TryAdmitConnection();
+  void ReleaseConnection();
+  bool TryJoin(const std::string& room, Role role);
+  void Leave(const std::string& room, Role role);
+
+  size_t GetConnectionCount() const { return connections_; }
+  size_t GetMemberCount(const std::string& room, Role role) const;
+  uint64_t GetRejectedConnections() const { return rejected_connections_; }
+  uint64_t GetRejectedJoins() const { return rejected_joins_; }
+
+ private:
+  struct RoomMembers {
+    size_t senders = 0;
+    size_t receivers = 0;
+  };
+
+  Limits limits_;
+  size_t connections_ = 0;
+  std::unordered_map<std::string, RoomMembers> rooms_;
+  uint64_t rejected_connections_ = 0;
+  uint64_t rejected_joins_ = 0;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_RATE_LIMITER_H
@@ -0,0 +1,121 @@
+#include "base/rtp_stats.h"
+
+#include <cmath>
+
+namespace avrtc {
+
+/**
+ * 构造函数
+ * @param clock_rate RTP时钟频率，视频一般为90000
+ * @param rate_window_ms 码率统计的滑动窗口
+ */
+RtpReceiveStatistics::RtpReceiveStatistics(uint32_t clock_rate,
+                                           int64_t rate_window_ms)
+    : clock_rate_(clock_rate), rate_window_ns_(rate_window_ms * 1000000) {}
+
+/**
+ * 统计收到的一个RTP包
+ * 序号跳变的包不计入收包数和抖动，只计入码率
+ * @param sequence_number RTP序号
+ * @param rtp_timestamp RTP时间戳
+ * @param bytes 包长度，计入码率
+ * @param arrival_ns 到达时间，纳秒
+ */
+void RtpReceiveStatistics::OnPacket(uint16_t sequence_number,
+                                    uint32_t rtp_timestamp,
+                                    size_t bytes,
+                                    int64_t arrival_ns) {
+    TrimRateSamples(arrival_ns);
+    rate_samples_.emplace_back(arrival_ns, bytes);
+    rate_bytes_ += bytes;
+
+    if (first_packet_) {
+        first_packet_ = false;
+        base_sequence_ = max_sequence_ = sequence_number;
+        first_arrival_ns_ = arrival_ns;
+        last_rtp_timestamp_ = rtp_timestamp;
+    } else if (!UpdateSequence(sequence_number)) {
+        return;
+    }
+    ++received_;
+
+    // RFC 3550 A.8，到达时间换算成RTP时间戳单位；
+    // 相对第一个包计算，避免纳秒乘以时钟频率溢出，RTP时间戳展开回绕
+    unwrapped_timestamp_ +=
+        static_cast<int32_t>(rtp_timestamp - last_rtp_timestamp_);
+    last_rtp_timestamp_ = rtp_timestamp;
+    double arrival =
+        static_cast<double>(arrival_ns - first_arrival_ns_) * clock_rate_ / 1e9;
+    double transit = arrival - static_cast<double>(unwrapped_timestamp_);
+    if (received_ > 1) {
+        double d = std::fabs(transit - last_transit_);
+        jitter_ += (d - jitter_) / 16.0;
+    }
+    last_transit_ = transit;
+}
+
+/**
+ * RFC 3550 A.1，按16位差值判断前进、乱序还是序号跳变
+ * 跳变的包先记下，下一个包的序号和它相接时才从这里重新开始统计，
+ * 单个异常的包不会清掉已有的统计
+ * @return 包是否有效，跳变的包返回false
+ */
+bool RtpReceiveStatistics::UpdateSequence(uint16_t sequence_number) {
+    uint16_t delta = sequence_number - max_sequence_;
+    if (delta < kMaxDropout) {
+        if (sequence_number < max_sequence_) {
+            cycles_ += kSequenceMod;
+        }
+        max_sequence_ = sequence_number;
+    } else if (delta <= kSequenceMod - kMaxMisorder) {
+        if (sequence_number != bad_sequence_) {
+            bad_sequence_ = (sequence_number + 1) & (kSequenceMod - 1);
+            return false;
+        }
+        // 连续两个包序号相接，认为对端重启了序号
+        base_sequence_ = max_sequence_ = sequence_number;
+        cycles_ = 0;
+        received_ = 0;
+    }
+    // 其余为重复或乱序到达的包
+    bad_sequence_ = kSequenceMod + 1;
+    return true;
+}
+
+/**
+ * 累计丢包数，RFC 3550 A.3：期望收到的包数减实际收到的包数，
+ * 重复包会使它变小甚至为负
+ */
+int64_t RtpReceiveStatistics::GetPacketsLost() const {
+    if (first_packet_) {
+        return 0;
+    }
+    int64_t expected =
+        static_cast<int64_t>(GetExtendedHighestSequence()) - base_sequence_ + 1;
+    return expected - static_cast<int64_t>(received_);
+}
+
+uint32_t RtpReceiveStatistics::GetExtendedHighestSequence() const {
+    return cycles_ + max_sequence_;
+}
+
+/**
+ * 滑动窗口内的接收码率
+ * @param now_ns 当前时间，和到达时间使用同一个时钟
+ * @return 码率，bit/s
+ */
+int64_t RtpReceiveStatistics::GetBitrateBps(int64_t now_ns) {
+    TrimRateSamples(now_ns);
+    return static_cast<int64_t>(rate_bytes_) * 8 * 1000000000 /
+           rate_window_ns_;
+}
+
+void RtpReceiveStatistics::TrimRateSamples(int64_t now_ns) {
+    while (!rate_samples_.empty() &&
+           rate_samples_.front().first <= now_ns - rate_window_ns_) {
+        rate_bytes_ -= rate_samples_.front().second;
+        rate_samples_.pop_front();
+    }
+}
+
+}  // namespace avrtc
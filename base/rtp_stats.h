@@ -0,0 +1,75 @@
+#ifndef BASE_RTP_STATS_H
+#define BASE_RTP_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace avrtc {
+
+/**
+ * 一个SSRC的接收统计：RFC 3550的到达间隔抖动、丢包数和接收码率
+ * 到达时间应当使用内核接收时间戳（UdpSocket::Datagram::arrival_ns），
+ * 用户态读取时的时钟包含调度和排队延迟，CPU繁忙时会把抖动估计放大
+ * 由会话的接收方用MediaDemuxer回调中的arrival_ns喂入，解复用器本身不维护统计
+ * 非线程安全
+ */
+class RtpReceiveStatistics {
+ public:
+  static const int64_t kDefaultRateWindowMs = 1000;
+
+  explicit RtpReceiveStatistics(uint32_t clock_rate,
+                                int64_t rate_window_ms = kDefaultRateWindowMs);
+
+  void OnPacket(uint16_t sequence_number,
+                uint32_t rtp_timestamp,
+                size_t bytes,
+                int64_t arrival_ns);
+
+  // 抖动，单位为RTP时间戳，RTCP接收报告中的interarrival jitter
+  uint32_t GetJitter() const { return static_cast<uint32_t>(jitter_); }
+  double GetJitterMs() const { return jitter_ * 1000.0 / clock_rate_; }
+
+  uint64_t GetPacketsReceived() const { return received_; }
+  int64_t GetPacketsLost() const;
+  uint32_t GetExtendedHighestSequence() const;
+
+  int64_t GetBitrateBps(int64_t now_ns);
+
+ private:
+  // RFC 3550 A.1：向前跳过不超过kMaxDropout、向后不超过kMaxMisorder的包
+  // 视为正常；超出这个范围的包要连续两个序号相接才认为对端重启了序号
+  static const int kMaxDropout = 3000;
+  static const int kMaxMisorder = 100;
+  static const uint32_t kSequenceMod = 1 << 16;
+
+  bool UpdateSequence(uint16_t sequence_number);
+  void TrimRateSamples(int64_t now_ns);
+
+  const uint32_t clock_rate_;
+  const int64_t rate_window_ns_;
+
+  bool first_packet_ = true;
+  uint64_t received_ = 0;
+  uint16_t base_sequence_ = 0;
+  uint16_t max_sequence_ = 0;
+  uint32_t cycles_ = 0;  // 序号回绕次数左移16位
+  // 上一个跳变包的下一个序号，kSequenceMod + 1表示没有
+  uint32_t bad_sequence_ = kSequenceMod + 1;
+
+  int64_t first_arrival_ns_ = 0;
+  uint32_t last_rtp_timestamp_ = 0;
+  int64_t unwrapped_timestamp_ = 0;  // 相对第一个包展开回绕后的RTP时间戳
+  // 上一个包的传输时间（到达时间减RTP时间戳，单位为RTP时间戳）
+  double last_transit_ = 0;
+  double jitter_ = 0;
+
+  // 码率窗口内每个包的到达时间和字节数，收包时淘汰窗口外的样本
+  std::deque<std::pair<int64_t, size_t>> rate_samples_;
+  size_t rate_bytes_ = 0;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_RTP_STATS_H
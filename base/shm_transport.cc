@@ -0,0 +1,412 @@
+#include "base/shm_transport.h"
+
+#include <errno.h>
+#include <glog/logging.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <new>
+
+namespace avrtc {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory ring requires lock-free 64-bit atomics");
+
+/**
+ * 在新映射的内存上初始化环的头部
+ * @param region 映射区域，至少GetRegionSize(capacity)字节
+ * @param capacity 数据区字节数，必须是2的幂
+ */
+void ShmRing::Initialize(void* region, size_t capacity) {
+    Header* header = new (region) Header;
+    header->magic = kMagic;
+    header->version = kVersion;
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    // 消费者挂上事件循环之前写入的数据同样需要唤醒
+    header->consumer_waiting.store(1, std::memory_order_relaxed);
+}
+
+ShmRing::ShmRing(void* region)
+    : header_(static_cast<Header*>(region)),
+      data_(static_cast<char*>(region) + sizeof(Header)),
+      capacity_(header_->capacity) {
+    cached_tail_ = header_->tail.load(std::memory_order_acquire);
+    cached_head_ = header_->head.load(std::memory_order_acquire);
+}
+
+ShmRing::ShmRing(void* region, size_t capacity)
+    : header_(static_cast<Header*>(region)),
+      data_(static_cast<char*>(region) + sizeof(Header)),
+      capacity_(capacity) {
+    cached_tail_ = header_->tail.load(std::memory_order_acquire);
+    cached_head_ = header_->head.load(std::memory_order_acquire);
+}
+
+/**
+ * 写入一条记录，只能在生产者中调用
+ * @param data 数据
+ * @param length 数据长度，不超过GetMaxRecordSize()
+ * @return 是否写入，空间不足时返回false
+ */
+bool ShmRing::Write(const char* data, size_t length) {
+    if (length > GetMaxRecordSize()) {
+        return false;
+    }
+    size_t record = RecordSize(length);
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    size_t offset = head & (capacity_ - 1);
+    size_t contiguous = capacity_ - offset;
+    size_t needed = record <= contiguous ? record : contiguous + record;
+    if (capacity_ - (head - cached_tail_) < needed) {
+        cached_tail_ = header_->tail.load(std::memory_order_acquire);
+        if (capacity_ - (head - cached_tail_) < needed) {
+            return false;
+        }
+    }
+
+    if (record > contiguous) {
+        // 偏移总是8字节对齐，尾部至少放得下回绕标记
+        uint32_t marker = kWrapMarker;
+        memcpy(data_ + offset, &marker, sizeof(marker));
+        head += contiguous;
+        offset = 0;
+    }
+    uint32_t length32 = static_cast<uint32_t>(length);
+    memcpy(data_ + offset, &length32, kRecordHeaderSize);
+    memcpy(data_ + offset + kRecordHeaderSize, data, length);
+    header_->head.store(head + record, std::memory_order_release);
+    return true;
+}
+
+/**
+ * 读取记录，只能在消费者中调用
+ * 每条记录在回调返回后才归还给生产者，回调中可以直接使用共享内存中的数据
+ * 长度超出数据区或者记录越过head时把环标记为损坏，不再回调
+ * @param cb 每条记录的回调
+ * @param max_records 最多读取的记录数
+ * @return 读取的记录数
+ */
+size_t ShmRing::Read(const RecordCallback& cb, size_t max_records) {
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    size_t count = 0;
+    while (count < max_records && !broken_) {
+        if (tail == cached_head_) {
+            cached_head_ = header_->head.load(std::memory_order_acquire);
+            if (tail == cached_head_) {
+                break;
+            }
+            if (cached_head_ - tail > capacity_) {
+                LOG(ERROR) << "Shared memory ring head out of range";
+                broken_ = true;
+                break;
+            }
+        }
+        size_t offset = tail & (capacity_ - 1);
+        uint32_t length;
+        memcpy(&length, data_ + offset, kRecordHeaderSize);
+        size_t advance = length == kWrapMarker ? capacity_ - offset
+                                               : RecordSize(length);
+        if ((length != kWrapMarker &&
+             length > capacity_ - offset - kRecordHeaderSize) ||
+            advance > cached_head_ - tail) {
+            LOG(ERROR) << "Corrupted record in shared memory ring, length: "
+                       << length;
+            broken_ = true;
+            break;
+        }
+        if (length == kWrapMarker) {
+            tail += advance;
+            continue;
+        }
+        cb(data_ + offset + kRecordHeaderSize, length);
+        tail += advance;
+        header_->tail.store(tail, std::memory_order_release);
+        ++count;
+    }
+    // 只有回绕标记时也要归还
+    header_->tail.store(tail, std::memory_order_release);
+    return count;
+}
+
+/**
+ * 消费者准备睡眠：设置等待标志后再检查一次是否有数据，
+ * 和生产者ConsumeWaiter()中的顺序配合，保证不会错过唤醒
+ * @return true表示可以睡眠，false表示期间有新数据，标志已经清除
+ */
+bool ShmRing::PrepareWait() {
+    header_->consumer_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!Empty()) {
+        header_->consumer_waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 生产者写入之后调用，消费者在等待时清除标志
+ * @return 是否需要唤醒消费者
+ */
+bool ShmRing::ConsumeWaiter() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header_->consumer_waiting.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    return header_->consumer_waiting.exchange(0) != 0;
+}
+
+bool ShmRing::Empty() const {
+    return header_->head.load(std::memory_order_acquire) ==
+           header_->tail.load(std::memory_order_relaxed);
+}
+
+/**
+ * 创建共享内存和唤醒用的eventfd，调用者作为生产者
+ * @param capacity 数据区字节数，向上取整到2的幂，至少一页
+ * @return 传输对象，失败返回nullptr
+ */
+std::shared_ptr<ShmTransport> ShmTransport::Create(size_t capacity) {
+    size_t rounded = 4096;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    size_t region_size = ShmRing::GetRegionSize(rounded);
+
+    int mem_fd = memfd_create("avrtc-shm-ring", MFD_CLOEXEC);
+    if (mem_fd < 0) {
+        LOG(ERROR) << "Failed to create memfd, " << strerror(errno);
+        return nullptr;
+    }
+    if (ftruncate(mem_fd, region_size) < 0) {
+        LOG(ERROR) << "Failed to resize memfd, " << strerror(errno);
+        close(mem_fd);
+        return nullptr;
+    }
+    void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, mem_fd, 0);
+    if (region == MAP_FAILED) {
+        LOG(ERROR) << "Failed to map memfd, " << strerror(errno);
+        close(mem_fd);
+        return nullptr;
+    }
+    ShmRing::Initialize(region, rounded);
+
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        LOG(ERROR) << "Failed to create eventfd, " << strerror(errno);
+        munmap(region, region_size);
+        close(mem_fd);
+        return nullptr;
+    }
+    return std::shared_ptr<ShmTransport>(
+        new ShmTransport(mem_fd, event_fd, region, region_size));
+}
+
+/**
+ * 打开另一个进程创建的传输，接管两个fd
+ * @param mem_fd 共享内存
+ * @param event_fd 唤醒用的eventfd
+ * @return 传输对象，头部校验失败返回nullptr
+ */
+std::shared_ptr<ShmTransport> ShmTransport::Open(int mem_fd, int event_fd) {
+    ShmRing::Header header;
+    if (pread(mem_fd, &header, sizeof(header), 0) !=
+            static_cast<ssize_t>(sizeof(header)) ||
+        header.magic != ShmRing::kMagic ||
+        header.version != ShmRing::kVersion || header.capacity < 4096 ||
+        (header.capacity & (header.capacity - 1)) != 0) {
+        LOG(ERROR) << "Invalid shared memory ring";
+        close(mem_fd);
+        close(event_fd);
+        return nullptr;
+    }
+    // 映射超出文件大小的部分在访问时产生SIGBUS
+    size_t region_size = ShmRing::GetRegionSize(header.capacity);
+    struct stat st;
+    if (fstat(mem_fd, &st) < 0 ||
+        static_cast<uint64_t>(st.st_size) < region_size) {
+        LOG(ERROR) << "Shared memory is smaller than its ring";
+        close(mem_fd);
+        close(event_fd);
+        return nullptr;
+    }
+    void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, mem_fd, 0);
+    if (region == MAP_FAILED) {
+        LOG(ERROR) << "Failed to map memfd, " << strerror(errno);
+        close(mem_fd);
+        close(event_fd);
+        return nullptr;
+    }
+    return std::shared_ptr<ShmTransport>(
+        new ShmTransport(mem_fd, event_fd, region, region_size));
+}
+
+/**
+ * 从Unix域socket接收SendDescriptors()发来的fd并打开传输
+ * @param unix_socket 已连接的Unix域socket
+ * @return 传输对象，失败返回nullptr
+ */
+std::shared_ptr<ShmTransport> ShmTransport::ReceiveDescriptors(
+    int unix_socket) {
+    char byte;
+    struct iovec iov = {&byte, 1};
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(unix_socket, &msg, MSG_CMSG_CLOEXEC) <= 0) {
+        LOG(ERROR) << "Failed to receive descriptors, " << strerror(errno);
+        return nullptr;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+        cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+        LOG(ERROR) << "Unexpected control message while receiving descriptors";
+        return nullptr;
+    }
+    int fds[2];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    return Open(fds[0], fds[1]);
+}
+
+ShmTransport::ShmTransport(int mem_fd,
+                           int event_fd,
+                           void* region,
+                           size_t region_size)
+    : mem_fd_(mem_fd),
+      event_fd_(event_fd),
+      region_(region),
+      region_size_(region_size),
+      ring_(region, region_size - sizeof(ShmRing::Header)) {}
+
+/**
+ * 析构函数，调用者必须先在事件循环线程中Detach()
+ */
+ShmTransport::~ShmTransport() {
+    munmap(region_, region_size_);
+    close(event_fd_);
+    close(mem_fd_);
+}
+
+/**
+ * 通过Unix域socket把共享内存和eventfd传给另一个进程
+ * @param unix_socket 已连接的Unix域socket
+ * @return 是否成功
+ */
+bool ShmTransport::SendDescriptors(int unix_socket) const {
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    char control[CMSG_SPACE(2 * sizeof(int))] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = {mem_fd_, event_fd_};
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if (sendmsg(unix_socket, &msg, MSG_NOSIGNAL) < 0) {
+        LOG(ERROR) << "Failed to send descriptors, " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 发送一条消息，只能在生产者进程的一个线程中调用
+ * 消费者正在处理数据时只有内存拷贝，没有系统调用
+ * @param buffer 数据缓冲区
+ * @param length 数据长度，不超过GetMaxMessageSize()
+ * @return 发送的字节数，环满或消息过大时丢弃并返回-1
+ */
+int ShmTransport::Send(const char* buffer, size_t length) {
+    if (!ring_.Write(buffer, length)) {
+        if (length > ring_.GetMaxRecordSize()) {
+            LOG(ERROR) << "Message of " << length
+                       << " bytes exceeds shared memory ring limit";
+        }
+        ++dropped_;
+        return -1;
+    }
+    if (ring_.ConsumeWaiter()) {
+        Wakeup();
+    }
+    return static_cast<int>(length);
+}
+
+/**
+ * 作为消费者挂到事件循环上，之后在循环线程中回调OnReceive
+ * @param loop 事件循环
+ * @return 是否成功
+ */
+bool ShmTransport::Attach(EventLoop* loop) {
+    if (!loop->AddFD(event_fd_, EPOLLIN,
+                     [this](uint32_t) { HandleRead(); })) {
+        return false;
+    }
+    loop_ = loop;
+    // 挂上之前写入的数据已经消耗了唤醒，主动触发一次读取
+    Wakeup();
+    return true;
+}
+
+void ShmTransport::Detach() {
+    if (loop_ != nullptr) {
+        loop_->RemoveFD(event_fd_);
+        loop_ = nullptr;
+    }
+}
+
+/**
+ * eventfd可读，读取环中的消息直到为空后重新进入等待
+ */
+void ShmTransport::HandleRead() {
+    uint64_t value;
+    ssize_t ret = read(event_fd_, &value, sizeof(value));
+    (void)ret;
+
+    auto self = shared_from_this();
+    ShmRing::RecordCallback deliver = [&](char* data, size_t length) {
+        if (OnReceive_) {
+            OnReceive_(self, data, length);
+        }
+    };
+    size_t budget = kMaxMessagesPerRead;
+    for (;;) {
+        budget -= ring_.Read(deliver, budget);
+        if (ring_.IsBroken()) {
+            // 生产者不可信，停止接收
+            Detach();
+            return;
+        }
+        if (budget == 0 && !ring_.Empty()) {
+            // 超过单次处理上限，留到下一轮，自己唤醒保证事件再次触发
+            Wakeup();
+            return;
+        }
+        if (ring_.PrepareWait()) {
+            return;
+        }
+    }
+}
+
+void ShmTransport::Wakeup() {
+    uint64_t one = 1;
+    ssize_t ret = write(event_fd_, &one, sizeof(one));
+    (void)ret;
+}
+
+}  // namespace avrtc
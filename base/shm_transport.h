@@ -0,0 +1,141 @@
+#ifndef BASE_SHM_TRANSPORT_H
+#define BASE_SHM_TRANSPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "base/event_loop.h"
+
+namespace avrtc {
+
+/**
+ * 共享内存中的单生产者单消费者字节环
+ * 每条记录是4字节长度加数据，按8字节对齐；尾部放不下时写入回绕标记，从头开始写
+ * head和tail是单调递增的字节偏移，分别只由生产者和消费者写，各占一个缓存行；
+ * 双方各自缓存对方的偏移，只有缓存的值显示空间不足或没有数据时才读取共享的值
+ * 消费者准备睡眠时设置consumer_waiting，生产者只在这个标志被设置时才需要唤醒，
+ * 消费者一直在处理数据时收发都不需要系统调用
+ * 共享内存中的内容由另一个进程写入，消费者校验每条记录的长度和head的位置，
+ * 越界时把环标记为损坏，之后不再读取
+ */
+class ShmRing {
+ public:
+  using RecordCallback = std::function<void(char* data, size_t length)>;
+
+  static const uint32_t kMagic = 0x52494e47;  // "RING"
+  static const uint32_t kVersion = 1;
+
+  // 映射区域的开头，之后紧跟capacity字节的数据区
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> consumer_waiting;
+  };
+
+  static size_t GetRegionSize(size_t capacity) {
+    return sizeof(Header) + capacity;
+  }
+  static void Initialize(void* region, size_t capacity);
+
+  // region必须已经初始化，调用者负责校验头部
+  explicit ShmRing(void* region);
+  // 使用调用者校验过的容量，不再读取对方可以修改的头部
+  ShmRing(void* region, size_t capacity);
+
+  bool Write(const char* data, size_t length);
+  size_t Read(const RecordCallback& cb, size_t max_records);
+  bool PrepareWait();
+  bool ConsumeWaiter();
+
+  bool Empty() const;
+  // 读到越界的记录后为true，环中的数据不再可信
+  bool IsBroken() const { return broken_; }
+  size_t GetCapacity() const { return capacity_; }
+  // 单条记录的最大长度，保证回绕时仍然放得下
+  size_t GetMaxRecordSize() const { return capacity_ / 2 - kRecordHeaderSize; }
+
+ private:
+  static const size_t kRecordHeaderSize = 4;
+  static const uint32_t kWrapMarker = 0xffffffff;
+
+  static size_t RecordSize(size_t length) {
+    return (kRecordHeaderSize + length + 7) & ~static_cast<size_t>(7);
+  }
+
+  Header* header_;
+  char* data_;
+  size_t capacity_;
+  uint64_t cached_tail_ = 0;  // 生产者看到的tail
+  uint64_t cached_head_ = 0;  // 消费者看到的head
+  bool broken_ = false;
+};
+
+/**
+ * 同一主机上进程间的媒体传输，在memfd共享内存的ShmRing上传递RTP包或整帧编码数据，
+ * 用eventfd唤醒睡眠中的消费者，代替每个包都要经过协议栈的回环socket
+ * 单向传输：一个进程Create()后只调用Send()，
+ * 另一个进程通过ReceiveDescriptors()或继承的fd打开后在事件循环中接收
+ * 接收回调和SessionSocket相同，每次回调对应一条完整的消息
+ * 环满时Send()丢弃消息并返回-1，媒体数据宁可丢弃也不阻塞生产者
+ */
+class ShmTransport : public std::enable_shared_from_this<ShmTransport> {
+ public:
+  static const size_t kDefaultCapacity = 4 * 1024 * 1024;
+  // 一次可读事件最多处理的消息数，避免饿死同一循环中的其他fd
+  static const size_t kMaxMessagesPerRead = 256;
+
+  using OnReceiveCallback = std::function<void(
+      std::shared_ptr<ShmTransport>, char* buffer, size_t length)>;
+
+  static std::shared_ptr<ShmTransport> Create(
+      size_t capacity = kDefaultCapacity);
+  static std::shared_ptr<ShmTransport> Open(int mem_fd, int event_fd);
+  static std::shared_ptr<ShmTransport> ReceiveDescriptors(int unix_socket);
+  ~ShmTransport();
+
+  bool SendDescriptors(int unix_socket) const;
+
+  int Send(const char* buffer, size_t length);
+
+  bool Attach(EventLoop* loop);
+  void Detach();
+  void HandleRead();
+
+  /**
+   * 设置接收数据回调,触发时机：每收到一条完整的消息时，
+   * buffer指向共享内存内部，仅在回调期间有效
+   */
+  void SetOnReceive(OnReceiveCallback cb) { OnReceive_ = cb; }
+
+  int GetMemFD() const { return mem_fd_; }
+  int GetEventFD() const { return event_fd_; }
+  size_t GetMaxMessageSize() const { return ring_.GetMaxRecordSize(); }
+  uint64_t GetDroppedCount() const { return dropped_; }
+  // 生产者写坏了环，接收已经停止
+  bool IsBroken() const { return ring_.IsBroken(); }
+
+ private:
+  ShmTransport(int mem_fd, int event_fd, void* region, size_t region_size);
+
+  void Wakeup();
+
+  int mem_fd_;
+  int event_fd_;
+  void* region_;
+  size_t region_size_;
+  ShmRing ring_;
+  EventLoop* loop_ = nullptr;
+  uint64_t dropped_ = 0;
+
+  OnReceiveCallback OnReceive_;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_SHM_TRANSPORT_H
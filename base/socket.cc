@@ -1,14 +1,22 @@
 #include "base/socket.h"
 
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <time.h>
+
+#include <algorithm>
+#include <random>
+
 namespace avrtc {
 
 /**
  * 构造函数，创建socket并绑定地址
  * @param address 绑定的地址
+ * @param type socket类型，SOCK_STREAM或SOCK_DGRAM
  * @return void
  */
-Socket::Socket(SocketAddress address) : address_(address) {
-    socket_fd_ = socket(static_cast<int>(address.GetFamily()), SOCK_STREAM, 0);
+Socket::Socket(SocketAddress address, int type) : address_(address) {
+    socket_fd_ = socket(static_cast<int>(address.GetFamily()), type, 0);
     if (socket_fd_ < 0) {
         LOG(ERROR) << "Failed to create socket";
     }
@@ -20,6 +28,14 @@ Socket::Socket(SocketAddress address) : address_(address) {
     }
 }
 
+/**
+ * 构造函数，接管一个已经存在的socket，例如accept返回的连接
+ * @param fd socket文件描述符
+ * @param address 对端地址
+ */
+Socket::Socket(int fd, SocketAddress address)
+    : address_(address), socket_fd_(fd) {}
+
 Socket::~Socket() {
     Close();
 }
@@ -35,12 +51,37 @@ void Socket::Close() {
     }
 }
 
+/**
+ * 开启socket级忙轮询：队列为空时，接收调用先在网卡队列上轮询一段时间再睡眠
+ * 只对支持NAPI的网卡生效，回环接口上设置成功但没有效果；
+ * 超过net.core.busy_read的值需要CAP_NET_ADMIN
+ * @param busy_poll_us 每次轮询的微秒数
+ * @param prefer_busy_poll 优先忙轮询，流量持续时抑制网卡中断和软中断处理
+ * @return 是否成功
+ */
+bool Socket::EnableBusyPoll(int busy_poll_us, bool prefer_busy_poll) {
+    if (setsockopt(socket_fd_, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+                   sizeof(busy_poll_us)) < 0) {
+        LOG(WARNING) << "Failed to set SO_BUSY_POLL, " << strerror(errno);
+        return false;
+    }
+    int prefer = prefer_busy_poll ? 1 : 0;
+    if (setsockopt(socket_fd_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer,
+                   sizeof(prefer)) < 0) {
+        LOG(WARNING) << "Failed to set SO_PREFER_BUSY_POLL, "
+                     << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
 /**
  * 构造函数，创建服务器socket并绑定地址
  * @param address 绑定的地址
  * @return void
  */
-ServerSocket::ServerSocket(SocketAddress address) : Socket(address) {
+ServerSocket::ServerSocket(SocketAddress address)
+    : Socket(address), session_pool_(std::make_shared<BlockPool>()) {
     int ret;
     ret = bind(socket_fd_, address.GetSockAddr(), address.GetSockLen());
     if (ret < 0) {
@@ -50,41 +91,68 @@ ServerSocket::ServerSocket(SocketAddress address) : Socket(address) {
     if (ret < 0) {
         LOG(ERROR) << "Failed to listen on socket, " << strerror(errno);
     }
+    // 绑定端口0时回填内核分配的端口
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    if (getsockname(socket_fd_, (struct sockaddr*)&local, &len) == 0) {
+        address_ = SocketAddress(local);
+    }
 }
 
 /**
- * 接受新的客户端连接，保存到clients_中，并触发OnAccept回调，
- * 接受新的连接后会将客户端socket加入到epoll监听中
+ * 接受所有等待中的客户端连接，保存到clients_中，并触发OnAccept回调，
+ * 接受新的连接后会将客户端socket加入到事件循环中
  */
 void ServerSocket::Accept() {
-    // 接收新的客户端连接
-    struct sockaddr_in client_address;
-    socklen_t addr_len = sizeof(client_address);
-    int client_fd =
-        accept(socket_fd_, (struct sockaddr*)&(client_address), &addr_len);
-    if (client_fd < 0) {
-        LOG(ERROR) << "Failed to accept client connection";
-    }
-
-    // 保存客户端连接
-    std::shared_ptr<SessionSocket> client_ptr =
-        std::make_shared<SessionSocket>(client_address);
-    client_ptr->SetFD(client_fd);
+    for (;;) {
+        // 接收新的客户端连接，直接设置为非阻塞
+        struct sockaddr_in client_address;
+        socklen_t addr_len = sizeof(client_address);
+        int client_fd = accept4(socket_fd_, (struct sockaddr*)&client_address,
+                                &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG(ERROR) << "Failed to accept client connection, "
+                           << strerror(errno);
+            }
+            return;
+        }
+        // 超过连接数上限时立即关闭，不分配任何连接状态
+        if (!admission_.TryAdmitConnection()) {
+            LOG_EVERY_N(WARNING, 100)
+                << "Connection limit reached, reject "
+                << SocketAddress(client_address).ToIpString();
+            close(client_fd);
+            continue;
+        }
 
-    clients_.insert({client_fd, client_ptr});
+        // 连接对象从池中分配，接管accept返回的fd
+        std::shared_ptr<SessionSocket> client_ptr =
+            std::allocate_shared<SessionSocket>(
+                PoolAllocator<SessionSocket>(session_pool_), client_fd,
+                SocketAddress(client_address));
 
-    // 触发回调
-    if (OnAccept_) {
-        OnAccept_(client_ptr);
-    }
+        // 加入到事件循环
+        auto on_event = [this, client_fd](uint32_t events) {
+            HandleClientEvent(client_fd, events);
+        };
+        if (!loop_.AddFD(client_fd, EPOLLIN, on_event)) {
+            LOG(ERROR) << "Failed to add client socket to epoll";
+            admission_.ReleaseConnection();
+            continue;
+        }
+        client_ptr->AttachLoop(&loop_);
+        client_ptr->SetRateLimit(session_rate_limit_);
+        if (client_fd >= static_cast<int>(clients_.size())) {
+            clients_.resize(client_fd + 1);
+        }
+        clients_[client_fd] = client_ptr;
+        ++client_count_;
 
-    // 加入到epoll监听
-    SetNonBlocking(client_fd);
-    epoll_event event = {.events = EPOLLIN, .data = {.fd = client_fd}};
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &event) == -1) {
-        LOG(ERROR) << "Failed to add client socket to epoll";
-        close(client_fd);
-        return;
+        // 触发回调
+        if (OnAccept_) {
+            OnAccept_(client_ptr);
+        }
     }
 }
 
@@ -92,7 +160,7 @@ void ServerSocket::Accept() {
  * 设置文件描述符为非阻塞模式
  * @param fd 文件描述符
  */
-void ServerSocket::SetNonBlocking(int fd) {
+void Socket::SetNonBlocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
     if (flags == -1) {
         LOG(ERROR) << "Failed to get file descriptor flags";
@@ -105,65 +173,69 @@ void ServerSocket::SetNonBlocking(int fd) {
 
 /**
  * 启动服务器socket，进入事件循环
- * 使用epoll同时监听新连接和已有连接的数据
- * 在这里处理链接断开后的清理工作
+ * 事件循环同时监听新连接、已有连接的数据和定时器
  */
 void ServerSocket::Start() {
     if (!OnAccept_) {
         LOG(INFO) << "OnAccept callback is not set, you'd better set it before "
                      "Start()";
     }
-    epoll_fd = epoll_create1(0);
 
     SetNonBlocking(socket_fd_);
-    epoll_event event = {.events = EPOLLIN, .data = {.fd = socket_fd_}};
-
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket_fd_, &event) == -1) {
+    if (!loop_.AddFD(socket_fd_, EPOLLIN, [this](uint32_t) { Accept(); })) {
         LOG(ERROR) << "Failed to add server socket to epoll";
-        close(epoll_fd);
         return;
     }
+    auto stats_timer = loop_.RunEvery(STATS_INTERVAL_MS, [this]() {
+        LOG(INFO) << "size of clients_: " << std::to_string(client_count_);
+    });
 
-    epoll_event events[MAX_EVENTS];
-
-    while (running_) {
-        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, TIMEOUT_MS);
-        if (n == -1) {
-            LOG(ERROR) << "Epoll wait error";
-            break;
-        } else if (n == 0) {
-            LOG(INFO) << "size of clients_: "
-                      << std::to_string(clients_.size());
-            continue;
-        }
-
-        for (int i = 0; i < n; ++i) {
-            // 处理新连接
-            if (events[i].data.fd == socket_fd_) {
-                Accept();
-                continue;
-            }
-            // 处理已有连接的数据
-            auto it = clients_.find(events[i].data.fd);
-            if (it == clients_.end()) {
-                LOG(ERROR) << "Unknown client socket";
-                continue;
-            }
-            std::shared_ptr<SessionSocket> client = it->second;
-            if (client->Recv()) {
-                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->GetFD(), nullptr);
-                clients_.erase(client->GetFD());
-                continue;
-            }
-        }
+    if (running_) {
+        loop_.Run();
     }
 
-    close(epoll_fd);
+    loop_.CancelTimer(stats_timer);
+    loop_.RemoveFD(socket_fd_);
     Close();
 }
 
+/**
+ * 处理已有连接的事件
+ * 在这里处理链接断开后的清理工作
+ * @param fd 连接的文件描述符
+ * @param events epoll事件
+ */
+void ServerSocket::HandleClientEvent(int fd, uint32_t events) {
+    if (fd >= static_cast<int>(clients_.size()) || !clients_[fd]) {
+        LOG(ERROR) << "Unknown client socket";
+        return;
+    }
+    std::shared_ptr<SessionSocket> client = clients_[fd];
+    bool closed = false;
+    if (events & EPOLLERR) {
+        client->HandleErrorQueue();
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        closed = client->Recv();
+    }
+    // 写失败时对端已经断开，随后的EPOLLIN/EPOLLHUP会走关闭流程
+    if (!closed && (events & EPOLLOUT)) {
+        client->HandleWrite();
+    }
+    if (closed) {
+        loop_.RemoveFD(fd);
+        clients_[fd].reset();
+        --client_count_;
+        admission_.ReleaseConnection();
+    }
+}
+
+/**
+ * 停止事件循环，可以在任意线程中调用
+ */
 void ServerSocket::Stop() {
     running_ = false;
+    loop_.Stop();
 }
 
 /**
@@ -178,84 +250,982 @@ void ServerSocket::Close() {
     }
     Socket::Close();
     for (auto& client : clients_) {
-        client.second->Close();
+        if (client) {
+            loop_.RemoveFD(client->GetFD());
+            client->Close();
+            admission_.ReleaseConnection();
+        }
     }
     clients_.clear();
+    client_count_ = 0;
+}
+
+/**
+ * 关闭socket，持有send_mutex_，其他线程中的Send()不会使用已经关闭的fd
+ */
+void SessionSocket::Close() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    Socket::Close();
+}
+
+/**
+ * 使用新创建的socket，客户端重连时在事件循环线程中调用
+ * @param fd 文件描述符
+ */
+void SessionSocket::AdoptFD(int fd) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    socket_fd_ = fd;
 }
 
 /**
- * 发送数据到socket
+ * 发送一条消息到socket，消息会被拷贝到发送队列中
  * @param buffer 数据缓冲区
  * @param length 数据长度
- * @return 发送的字节数，失败返回-1
+ * @return 加入发送队列的消息字节数，失败返回-1
  */
 int SessionSocket::Send(const char* buffer, size_t length) {
-    CHECK(socket_fd_ != -1);
-    int ret = send(socket_fd_, buffer, length, 0);
-    if (ret < 0) {
-        LOG(ERROR) << "Send failed: " << strerror(errno);
-    }
-    return ret;
+    return Send(std::make_shared<const std::string>(buffer, length));
 }
 
 /**
- * 发送字符串数据到socket
+ * 发送字符串数据到socket，字符串被移动进发送队列，不会拷贝
  * @param message 字符串数据
- * @return 发送的字节数，失败返回-1
+ * @return 加入发送队列的消息字节数，失败返回-1
  */
 int SessionSocket::Send(std::string message) {
-    return Send(message.c_str(), message.size());
+    return Send(std::make_shared<const std::string>(std::move(message)));
+}
+
+/**
+ * 将一条消息加入发送队列，并尽量立即发出，可以在任意线程中调用
+ * 队列为空时直接在调用线程写socket，写不完的部分等待EPOLLOUT后继续；
+ * 积压超过上限时按OverflowPolicy丢弃消息或断开连接
+ * @param message 消息体，多个连接可以共享同一份数据
+ * @return 加入发送队列的消息字节数，失败返回-1
+ */
+int SessionSocket::Send(SharedBuffer message) {
+    size_t length = message->size();
+    if (length > FrameCodec::kMaxFrameSize) {
+        LOG(ERROR) << "Message too large: " << length;
+        return -1;
+    }
+
+    Watermark watermark;
+    size_t queued_bytes;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (socket_fd_ == -1) {
+            // 客户端在断开和重连之间没有可用的fd
+            LOG(ERROR) << "Send on closed socket";
+            return -1;
+        }
+        size_t frame_size = FrameCodec::kHeaderSize + length;
+        if (queued_bytes_ + frame_size > send_options_.max_queued_bytes) {
+            if (send_options_.overflow_policy == OverflowPolicy::kDropNewest) {
+                LOG(WARNING) << "Send queue full, drop message, fd: "
+                             << socket_fd_;
+            } else {
+                // 只关闭写端和读端，连接的清理仍然走事件循环中的关闭流程
+                LOG(WARNING) << "Send queue full, disconnect, fd: "
+                             << socket_fd_;
+                shutdown(socket_fd_, SHUT_RDWR);
+            }
+            return -1;
+        }
+
+        OutboundFrame frame;
+        FrameCodec::EncodeHeader(static_cast<uint32_t>(length), frame.header);
+        frame.payload = std::move(message);
+        send_queue_.push_back(std::move(frame));
+        queued_bytes_ += frame_size;
+
+        if (!want_write_ && !FlushLocked()) {
+            return -1;
+        }
+        watermark = CheckWatermarkLocked();
+        queued_bytes = queued_bytes_;
+    }
+
+    NotifyWatermark(watermark, queued_bytes);
+    return static_cast<int>(length);
 }
 
 /**
- * 从socket接收数据，触发OnReceive回调
+ * socket可写时继续发送积压的数据，由事件循环在EPOLLOUT时调用
+ * 积压回落到低水位以下时触发OnLowWatermark回调
+ * @return 是否发送成功，false表示连接出错
+ */
+bool SessionSocket::HandleWrite() {
+    bool ok;
+    Watermark watermark;
+    size_t queued_bytes;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        ok = FlushLocked();
+        watermark = CheckWatermarkLocked();
+        queued_bytes = queued_bytes_;
+    }
+
+    NotifyWatermark(watermark, queued_bytes);
+    return ok;
+}
+
+/**
+ * 根据当前积压量判断是否越过了高水位或回落到低水位
+ * 高低水位之间的滞回区间避免在阈值附近反复通知
+ * @note 调用者必须持有send_mutex_
+ */
+SessionSocket::Watermark SessionSocket::CheckWatermarkLocked() {
+    if (!backpressured_ && queued_bytes_ >= send_options_.high_watermark) {
+        backpressured_ = true;
+        return Watermark::kHigh;
+    }
+    if (backpressured_ && queued_bytes_ <= send_options_.low_watermark) {
+        backpressured_ = false;
+        return Watermark::kLow;
+    }
+    return Watermark::kNone;
+}
+
+/**
+ * 在锁外触发水位回调，回调中可以再次调用Send
+ */
+void SessionSocket::NotifyWatermark(Watermark watermark, size_t queued_bytes) {
+    if (watermark == Watermark::kHigh && OnHighWatermark_)
+        OnHighWatermark_(shared_from_this(), queued_bytes);
+    else if (watermark == Watermark::kLow && OnLowWatermark_)
+        OnLowWatermark_(shared_from_this(), queued_bytes);
+}
+
+/**
+ * 把发送队列中的帧聚合成iovec，尽量多地一次写入socket
+ * 写满内核缓冲区时注册EPOLLOUT，队列清空后取消注册
+ * @return 是否发送成功，false表示连接出错
+ * @note 调用者必须持有send_mutex_
+ */
+bool SessionSocket::FlushLocked() {
+    constexpr size_t kMaxIov = 64;
+    struct iovec iov[kMaxIov];
+    bool copy_fallback = false;
+
+    while (!send_queue_.empty()) {
+        // 先统计本批次的帧数和字节数，决定是否使用零拷贝
+        size_t frame_count = 0;
+        size_t batch_bytes = 0;
+        for (auto it = send_queue_.begin();
+             it != send_queue_.end() && frame_count < kMaxIov / 2; ++it) {
+            batch_bytes += it->Size() - it->sent;
+            ++frame_count;
+        }
+        bool zerocopy = !copy_fallback && UseZeroCopyLocked(batch_bytes);
+
+        // 零拷贝发送时内核在完成通知之前一直引用这些内存，帧出队后长度前缀
+        // 随之释放，因此先拷贝到单独的块中，和消息体一起交给zerocopy_保留
+        std::shared_ptr<std::string> headers;
+        std::vector<SharedBuffer> pinned;
+        if (zerocopy) {
+            headers = std::make_shared<std::string>();
+            headers->reserve(frame_count * FrameCodec::kHeaderSize);
+            pinned.reserve(frame_count + 1);
+        }
+
+        size_t iov_count = 0;
+        auto it = send_queue_.begin();
+        for (size_t i = 0; i < frame_count; ++i, ++it) {
+            size_t payload_offset = 0;
+            if (it->sent < FrameCodec::kHeaderSize) {
+                const char* header = it->header + it->sent;
+                size_t header_length = FrameCodec::kHeaderSize - it->sent;
+                if (zerocopy) {
+                    size_t offset = headers->size();
+                    headers->append(header, header_length);
+                    header = headers->data() + offset;
+                }
+                iov[iov_count].iov_base = const_cast<char*>(header);
+                iov[iov_count].iov_len = header_length;
+                ++iov_count;
+            } else {
+                payload_offset = it->sent - FrameCodec::kHeaderSize;
+            }
+            if (payload_offset < it->payload->size()) {
+                iov[iov_count].iov_base =
+                    const_cast<char*>(it->payload->data()) + payload_offset;
+                iov[iov_count].iov_len = it->payload->size() - payload_offset;
+                ++iov_count;
+                if (zerocopy)
+                    pinned.push_back(it->payload);
+            }
+        }
+
+        // 等价于writev，MSG_NOSIGNAL避免对端关闭时进程收到SIGPIPE
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_count;
+        int flags = MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0);
+        ssize_t ret = sendmsg(socket_fd_, &msg, flags);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                UpdateWriteInterest(true);
+                return true;
+            }
+            // 固定页面占用的optmem耗尽，这一轮退回普通发送
+            if (zerocopy && errno == ENOBUFS) {
+                copy_fallback = true;
+                continue;
+            }
+            LOG(ERROR) << "Send failed: " << strerror(errno);
+            return false;
+        }
+        if (zerocopy) {
+            if (!headers->empty())
+                pinned.push_back(std::move(headers));
+            zerocopy_->OnSent(std::move(pinned));
+        }
+
+        size_t written = ret;
+        queued_bytes_ -= written;
+        while (written > 0) {
+            OutboundFrame& frame = send_queue_.front();
+            size_t remain = frame.Size() - frame.sent;
+            if (written < remain) {
+                frame.sent += written;
+                break;
+            }
+            written -= remain;
+            send_queue_.pop_front();
+        }
+    }
+
+    UpdateWriteInterest(false);
+    return true;
+}
+
+bool SessionSocket::UseZeroCopyLocked(size_t batch_bytes) const {
+    return zerocopy_ && zerocopy_->IsEffective() &&
+           batch_bytes >= zerocopy_threshold_;
+}
+
+/**
+ * 开启零拷贝发送，之后一次发送的字节数达到阈值时使用MSG_ZEROCOPY，
+ * 小消息仍然走普通发送
+ * 消息体在内核发送完成之前一直被引用，完成通知由HandleErrorQueue()处理
+ * @param threshold 使用零拷贝的最小字节数
+ * @return 是否成功，内核或协议（例如Unix域socket）不支持时返回false
+ */
+bool SessionSocket::EnableZeroCopy(size_t threshold) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (socket_fd_ == -1 || !ZeroCopyTracker::EnableOnSocket(socket_fd_)) {
+        return false;
+    }
+    if (!zerocopy_) {
+        zerocopy_ = std::make_unique<ZeroCopyTracker>();
+    }
+    zerocopy_threshold_ = threshold;
+    return true;
+}
+
+/**
+ * 处理socket错误队列中的零拷贝完成通知，事件循环收到EPOLLERR时调用
+ */
+void SessionSocket::HandleErrorQueue() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (zerocopy_ && socket_fd_ != -1) {
+        zerocopy_->ProcessErrorQueue(socket_fd_);
+    }
+}
+
+size_t SessionSocket::GetZeroCopyPending() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    return zerocopy_ ? zerocopy_->GetPendingCount() : 0;
+}
+
+/**
+ * 修改事件循环中是否关注socket可写事件
+ * 没有关联事件循环时（阻塞socket）不需要关注，下一次Send会继续发送
+ * 在其他线程中发送时，由事件循环线程按届时的状态修改关注的事件
+ * @param want_write 是否关注EPOLLOUT
+ * @note 调用者必须持有send_mutex_
+ */
+void SessionSocket::UpdateWriteInterest(bool want_write) {
+    if (want_write_ == want_write || loop_ == nullptr) {
+        return;
+    }
+    want_write_ = want_write;
+    if (loop_->IsInLoopThread()) {
+        loop_->ModifyFD(socket_fd_, InterestEventsLocked());
+        return;
+    }
+    // 其他线程中的Send()只会打开EPOLLOUT，之后的发送都在事件循环线程中进行
+    std::weak_ptr<SessionSocket> weak_self = shared_from_this();
+    loop_->QueueInLoop([weak_self]() {
+        auto self = weak_self.lock();
+        if (!self) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(self->send_mutex_);
+        // 执行前连接可能已经关闭或重置
+        if (self->want_write_ && self->socket_fd_ != -1) {
+            self->loop_->ModifyFD(self->socket_fd_,
+                                  self->InterestEventsLocked());
+        }
+    });
+}
+
+/**
+ * 当前应当关注的epoll事件，调用者必须持有send_mutex_
+ */
+uint32_t SessionSocket::InterestEventsLocked() const {
+    return (read_paused_ ? 0u : EPOLLIN) | (want_write_ ? EPOLLOUT : 0u);
+}
+
+/**
+ * 设置接收限速，桶初始是满的
+ * @param options 限速参数
+ */
+void SessionSocket::SetRateLimit(const RateLimitOptions& options) {
+    rate_options_ = options;
+    message_bucket_ =
+        TokenBucket(options.messages_per_sec, options.message_burst);
+    byte_bucket_ = TokenBucket(options.bytes_per_sec, options.byte_burst);
+    // 缓冲区中可能还有等待交付的消息，由恢复定时器按新的限速交付
+    if (read_paused_) {
+        PauseReading(0);
+    }
+}
+
+/**
+ * 把接收缓冲区中完整的消息交给OnReceive
+ * 消息令牌用完时剩余的消息留在缓冲区中，由调用者暂停读取，
+ * 超速的客户端只会被放慢，不会丢失消息（例如Close）
+ * @param now_ns 当前时间
+ * @param wait_ns 输出，剩余消息需要等待的时间，全部交付时为0
+ * @return false表示协议错误，连接应当关闭
+ */
+bool SessionSocket::DeliverFrames(int64_t now_ns, int64_t* wait_ns) {
+    auto self = shared_from_this();
+    bool limited = false;
+    bool ok = FrameCodec::Decode(
+        &recv_buffer_,
+        [this, &self](char* data, size_t length) {
+            if (OnReceive_)
+                OnReceive_(self, data, length);
+        },
+        [this, now_ns, &limited]() {
+            limited = !message_bucket_.TryConsume(1, now_ns);
+            return !limited;
+        });
+    *wait_ns = limited ? message_bucket_.GetWaitNs(1, now_ns) : 0;
+    return ok;
+}
+
+/**
+ * 令牌不足，暂停读取直到补足
+ * 数据留在内核接收缓冲区中，缓冲区满后TCP窗口关闭，客户端被迫放慢，
+ * 服务器不需要为超额的数据做任何处理
+ * 已经暂停时重新设置恢复时间
+ * @param wait_ns 令牌补足需要的时间
+ */
+void SessionSocket::PauseReading(int64_t wait_ns) {
+    if (loop_ == nullptr) {
+        return;
+    }
+    if (!read_paused_) {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        read_paused_ = true;
+        loop_->ModifyFD(socket_fd_, InterestEventsLocked());
+    }
+    CancelResumeTimer();
+    int64_t wait_ms = std::max<int64_t>((wait_ns + 999999) / 1000000, 1);
+    std::weak_ptr<SessionSocket> weak_self = shared_from_this();
+    resume_timer_ = loop_->RunAfter(wait_ms, [weak_self]() {
+        if (auto self = weak_self.lock()) {
+            self->resume_timer_ = TimerWheel::kInvalidTimerId;
+            self->OnResumeTimer();
+        }
+    });
+}
+
+/**
+ * 恢复定时器到期，先交付缓冲区中剩余的消息，令牌仍然不足时继续暂停
+ */
+void SessionSocket::OnResumeTimer() {
+    if (socket_fd_ == -1) {
+        return;
+    }
+    int64_t wait_ns = 0;
+    if (!DeliverFrames(EventLoop::NowNs(), &wait_ns)) {
+        // 协议错误，关闭读方向，随后的EPOLLIN在Recv()中走关闭流程
+        recv_buffer_.RetrieveAll();
+        shutdown(socket_fd_, SHUT_RDWR);
+    } else if (wait_ns > 0) {
+        PauseReading(wait_ns);
+        return;
+    }
+    ResumeReading();
+}
+
+void SessionSocket::ResumeReading() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    read_paused_ = false;
+    if (loop_ != nullptr && socket_fd_ != -1) {
+        loop_->ModifyFD(socket_fd_, InterestEventsLocked());
+    }
+}
+
+void SessionSocket::CancelResumeTimer() {
+    if (resume_timer_ != TimerWheel::kInvalidTimerId && loop_ != nullptr) {
+        loop_->CancelTimer(resume_timer_);
+        resume_timer_ = TimerWheel::kInvalidTimerId;
+    }
+}
+
+/**
+ * 丢弃上一个连接残留的收发状态，客户端重连前后调用
+ */
+void SessionSocket::ResetConnectionState() {
+    CancelResumeTimer();
+    read_paused_ = false;
+    message_bucket_ = TokenBucket(rate_options_.messages_per_sec,
+                                  rate_options_.message_burst);
+    byte_bucket_ =
+        TokenBucket(rate_options_.bytes_per_sec, rate_options_.byte_burst);
+
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    send_queue_.clear();
+    queued_bytes_ = 0;
+    backpressured_ = false;
+    want_write_ = false;
+    recv_buffer_.RetrieveAll();
+    // 零拷贝序号按socket计数，新的socket重新开始，并且需要重新开启SO_ZEROCOPY
+    if (zerocopy_) {
+        zerocopy_ = std::make_unique<ZeroCopyTracker>();
+        if (socket_fd_ != -1) {
+            ZeroCopyTracker::EnableOnSocket(socket_fd_);
+        }
+    }
+}
+
+size_t SessionSocket::GetQueuedBytes() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    return queued_bytes_;
+}
+
+bool SessionSocket::IsBackpressured() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    return backpressured_;
+}
+
+/**
+ * 从socket接收数据，按帧切分后对每条完整消息触发OnReceive回调
+ * 一次读取可能得到半条消息（留在缓冲区中等待后续数据）或多条消息
  * 返回值：是否成功接收数据，true表示连接已关闭
  * 链接关闭时只会触发OnClose回调，不会触发OnReceive回调
+ * 开启限速时超过消息速率或字节超限后暂停读取，超速的消息留到恢复时交付
  */
 bool SessionSocket::Recv() {
     CHECK(socket_fd_ != -1);
-    int buffer_size = 1024;
-    std::unique_ptr<char[]> buffer = std::make_unique<char[]>(buffer_size);
-    if ((buffer_size = recv(socket_fd_, buffer.get(), buffer_size, 0)) < 0) {
-        LOG(ERROR) << "Recv failed: " << strerror(errno);
+    int saved_errno = 0;
+    ssize_t n = recv_buffer_.ReadFd(socket_fd_, &saved_errno);
+    if (n < 0) {
+        if (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK ||
+            saved_errno == EINTR) {
+            return false;
+        }
+        LOG(ERROR) << "Recv failed: " << strerror(saved_errno);
     }
 
-    if (buffer_size == 0) {
+    auto self = shared_from_this();
+    int64_t now_ns = EventLoop::NowNs();
+    if (n > 0) {
+        byte_bucket_.Consume(n, now_ns);
+    }
+    int64_t wait_ns = 0;
+    bool ok = n > 0 && DeliverFrames(now_ns, &wait_ns);
+    if (!ok) {
+        CancelResumeTimer();
+        // 对端关闭前发来、因限速还留在缓冲区中的完整消息不再限速，关闭前交付
+        if (n == 0) {
+            FrameCodec::Decode(&recv_buffer_,
+                               [this, &self](char* data, size_t length) {
+                                   if (OnReceive_)
+                                       OnReceive_(self, data, length);
+                               });
+        }
+        recv_buffer_.RetrieveAll();
         if (OnClose_)
-            OnClose_(shared_from_this());
+            OnClose_(self);
         return true;
     }
 
-    if (OnReceive_)
-        OnReceive_(shared_from_this(), buffer.get(), buffer_size);
-
+    if (byte_bucket_.IsLimited() && byte_bucket_.GetTokens(now_ns) < 0) {
+        wait_ns = std::max(wait_ns, byte_bucket_.GetWaitNs(0, now_ns));
+    }
+    if (wait_ns > 0) {
+        PauseReading(wait_ns);
+    }
     return false;
 }
 
 /**
- * 连接到服务器,进入接收数据循环
+ * 连接到服务器，在当前线程中运行一个事件循环处理连接的收发，
+ * 直到Stop()被调用，或连接失败、断开且没有开启重连
  */
 void ClientSocket::Connect() {
-    CHECK(socket_fd_ != -1);
+    if (!running_) {
+        return;
+    }
+    EventLoop loop;
+    owned_loop_ = &loop;
+    ConnectAsync(&loop);
+    if (running_) {
+        loop.Run();
+    }
+    Teardown();
+    owned_loop_ = nullptr;
+    AttachLoop(nullptr);
+}
+
+/**
+ * 在事件循环中非阻塞地连接服务器，立即返回
+ * 连接结果通过OnConnected/OnConnectFailed回调通知，回调在事件循环线程中执行
+ * @param loop 事件循环，必须在它的线程中调用（或在Run()之前调用），
+ *             其他线程可以通过loop->QueueInLoop()转发
+ */
+void ClientSocket::ConnectAsync(EventLoop* loop) {
+    if (state_ != State::kDisconnected) {
+        LOG(WARNING) << "Client socket is already connecting or connected";
+        return;
+    }
+    AttachLoop(loop);
+    backoff_ms_ = 0;
+    StartConnect();
+}
+
+/**
+ * 停止连接和重连，可以在任意线程中调用
+ */
+void ClientSocket::Stop() {
+    running_ = false;
+    EventLoop* loop = GetLoop();
+    if (loop == nullptr) {
+        return;
+    }
+    loop->QueueInLoop([this]() {
+        Teardown();
+        if (owned_loop_ != nullptr) {
+            owned_loop_->Stop();
+        }
+    });
+}
+
+/**
+ * 发起一次非阻塞连接，第一次使用构造时创建的socket，重连时创建新的socket
+ */
+void ClientSocket::StartConnect() {
+    reconnect_timer_ = TimerWheel::kInvalidTimerId;
+    if (!running_) {
+        return;
+    }
+    if (socket_fd_ == -1) {
+        int fd = socket(address_.GetFamily(),
+                        SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            OnConnectError(errno);
+            return;
+        }
+        AdoptFD(fd);
+    } else {
+        SetNonBlocking(socket_fd_);
+    }
+
+    state_ = State::kConnecting;
     int ret =
         connect(socket_fd_, address_.GetSockAddr(), address_.GetSockLen());
-    if (ret < 0) {
-        LOG(ERROR) << "Failed to connect to server";
+    if (ret < 0 && errno != EINPROGRESS) {
+        OnConnectError(errno);
+        return;
     }
+    // 等待EPOLLOUT判断连接结果；本地连接可能立即成功
+    EventLoop* loop = GetLoop();
+    if (!loop->AddFD(socket_fd_, ret == 0 ? EPOLLIN : EPOLLOUT,
+                     [this](uint32_t events) { HandleEvent(events); })) {
+        OnConnectError(errno);
+        return;
+    }
+    if (ret == 0) {
+        OnConnectEstablished();
+        return;
+    }
+    if (connect_options_.connect_timeout_ms > 0) {
+        connect_timer_ =
+            loop->RunAfter(connect_options_.connect_timeout_ms, [this]() {
+                connect_timer_ = TimerWheel::kInvalidTimerId;
+                OnConnectError(ETIMEDOUT);
+            });
+    }
+}
 
+void ClientSocket::HandleEvent(uint32_t events) {
+    if (state_ == State::kConnecting) {
+        HandleConnectEvent(events);
+        return;
+    }
+    bool closed = false;
+    if (events & EPOLLERR) {
+        HandleErrorQueue();
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        closed = Recv();
+    }
+    if (!closed && (events & EPOLLOUT)) {
+        HandleWrite();
+    }
+    if (closed) {
+        OnDisconnected();
+    }
+}
+
+/**
+ * 连接中的socket可写或出错，用SO_ERROR取得连接结果
+ */
+void ClientSocket::HandleConnectEvent(uint32_t events) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(socket_fd_, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+        error = errno;
+    }
+    if (error == 0 && (events & (EPOLLERR | EPOLLHUP))) {
+        error = ECONNREFUSED;
+    }
+    if (error != 0) {
+        OnConnectError(error);
+        return;
+    }
+    GetLoop()->ModifyFD(socket_fd_, EPOLLIN);
+    OnConnectEstablished();
+}
+
+void ClientSocket::OnConnectEstablished() {
+    if (connect_timer_ != TimerWheel::kInvalidTimerId) {
+        GetLoop()->CancelTimer(connect_timer_);
+        connect_timer_ = TimerWheel::kInvalidTimerId;
+    }
+    ResetConnectionState();
+    state_ = State::kConnected;
+    backoff_ms_ = 0;
     if (OnConnected_) {
         OnConnected_();
     }
+}
 
-    while (running_)
-        Recv();
+void ClientSocket::OnConnectError(int error) {
+    LOG(WARNING) << "Failed to connect to " << address_.ToIpString() << ":"
+                 << address_.GetPort() << ", " << strerror(error);
+    Teardown();
+    if (OnConnectFailed_) {
+        OnConnectFailed_(error);
+    }
+    ScheduleReconnect();
 }
 
 /**
- * 停止客户端socket的接收循环
+ * 已建立的连接断开，OnClose回调已经在Recv()中触发
  */
-void ClientSocket::Stop() {
-    running_ = false;
+void ClientSocket::OnDisconnected() {
+    Teardown();
+    ScheduleReconnect();
+}
+
+/**
+ * 按指数退避安排下一次重连，等待时间在[backoff/2, backoff]之间随机，
+ * 避免服务器重启后大量客户端同时重连
+ * 不再重连时停止Connect()创建的事件循环
+ */
+void ClientSocket::ScheduleReconnect() {
+    if (!connect_options_.reconnect || !running_) {
+        if (owned_loop_ != nullptr) {
+            owned_loop_->Stop();
+        }
+        return;
+    }
+    if (backoff_ms_ == 0) {
+        backoff_ms_ = connect_options_.initial_backoff_ms;
+    } else {
+        backoff_ms_ =
+            std::min(backoff_ms_ * 2, connect_options_.max_backoff_ms);
+    }
+    static thread_local std::minstd_rand random(std::random_device{}());
+    std::uniform_int_distribution<int> jitter(0, backoff_ms_ / 2);
+    int delay_ms = backoff_ms_ - jitter(random);
+    reconnect_timer_ =
+        GetLoop()->RunAfter(delay_ms, [this]() { StartConnect(); });
+}
+
+/**
+ * 取消定时器，把socket移出事件循环并关闭，必须在事件循环线程中调用
+ */
+void ClientSocket::Teardown() {
+    EventLoop* loop = GetLoop();
+    if (loop != nullptr) {
+        if (connect_timer_ != TimerWheel::kInvalidTimerId) {
+            loop->CancelTimer(connect_timer_);
+        }
+        if (reconnect_timer_ != TimerWheel::kInvalidTimerId) {
+            loop->CancelTimer(reconnect_timer_);
+        }
+        if (socket_fd_ != -1 && state_ != State::kDisconnected) {
+            loop->RemoveFD(socket_fd_);
+        }
+    }
+    connect_timer_ = TimerWheel::kInvalidTimerId;
+    reconnect_timer_ = TimerWheel::kInvalidTimerId;
+    Close();
+    state_ = State::kDisconnected;
+}
+
+/**
+ * 构造函数，创建UDP socket，需要调用Bind()绑定到address_
+ * @param address 本地地址
+ */
+UdpSocket::UdpSocket(SocketAddress address) : Socket(address, SOCK_DGRAM) {}
+
+/**
+ * 绑定到本地地址
+ * @param reuse_port 是否开启SO_REUSEPORT，多个反应器线程可以各自绑定同一端口，
+ *                   由内核按5元组把数据报分散到各个socket
+ * @return 是否绑定成功
+ */
+bool UdpSocket::Bind(bool reuse_port) {
+    CHECK(socket_fd_ != -1);
+    if (reuse_port) {
+        int opt = 1;
+        if (setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEPORT, &opt,
+                       sizeof(opt)) < 0) {
+            LOG(ERROR) << "Failed to set SO_REUSEPORT, " << strerror(errno);
+            return false;
+        }
+    }
+    if (bind(socket_fd_, address_.GetSockAddr(), address_.GetSockLen()) < 0) {
+        LOG(ERROR) << "Failed to bind udp socket, " << strerror(errno);
+        return false;
+    }
+    // 绑定端口0时回填内核分配的端口
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    if (getsockname(socket_fd_, (struct sockaddr*)&local, &len) == 0) {
+        address_ = SocketAddress(local);
+    }
+    return true;
+}
+
+/**
+ * 发送一个数据报
+ * @param buffer 数据缓冲区
+ * @param length 数据长度
+ * @param to 目的地址
+ * @return 发送的字节数，失败返回-1
+ */
+ssize_t UdpSocket::SendTo(const char* buffer,
+                          size_t length,
+                          const SocketAddress& to) {
+    CHECK(socket_fd_ != -1);
+    ssize_t ret = sendto(socket_fd_, buffer, length, MSG_NOSIGNAL,
+                         to.GetSockAddr(), to.GetSockLen());
+    if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG(ERROR) << "Sendto failed: " << strerror(errno);
+    }
+    return ret;
+}
+
+/**
+ * 发送一个数据报，开启零拷贝且数据报达到阈值时使用MSG_ZEROCOPY，
+ * 数据在内核发送完成之前一直被引用
+ * @param buffer 数据报，可以同时发给多个对端
+ * @param to 对端地址
+ * @return 发送的字节数，失败返回-1
+ */
+ssize_t UdpSocket::SendTo(SharedBuffer buffer, const SocketAddress& to) {
+    CHECK(socket_fd_ != -1);
+    bool zerocopy = zerocopy_ && zerocopy_->IsEffective() &&
+                    buffer->size() >= zerocopy_threshold_;
+    if (zerocopy) {
+        ssize_t ret =
+            sendto(socket_fd_, buffer->data(), buffer->size(),
+                   MSG_NOSIGNAL | MSG_ZEROCOPY, to.GetSockAddr(),
+                   to.GetSockLen());
+        if (ret >= 0) {
+            zerocopy_->OnSent({std::move(buffer)});
+            return ret;
+        }
+        // optmem耗尽时退回普通发送
+        if (errno != ENOBUFS) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG(ERROR) << "Sendto failed: " << strerror(errno);
+            }
+            return ret;
+        }
+    }
+    return SendTo(buffer->data(), buffer->size(), to);
+}
+
+/**
+ * 开启零拷贝发送，只对SendTo(SharedBuffer)生效
+ * @param threshold 使用零拷贝的最小数据报字节数
+ * @return 是否成功
+ */
+bool UdpSocket::EnableZeroCopy(size_t threshold) {
+    if (socket_fd_ == -1 || !ZeroCopyTracker::EnableOnSocket(socket_fd_)) {
+        return false;
+    }
+    if (!zerocopy_) {
+        zerocopy_ = std::make_unique<ZeroCopyTracker>();
+    }
+    zerocopy_threshold_ = threshold;
+    return true;
+}
+
+/**
+ * 处理socket错误队列中的零拷贝完成通知，事件循环收到EPOLLERR时调用
+ */
+void UdpSocket::HandleErrorQueue() {
+    if (zerocopy_ && socket_fd_ != -1) {
+        zerocopy_->ProcessErrorQueue(socket_fd_);
+    }
+}
+
+/**
+ * 接收一个数据报
+ * @param buffer 接收缓冲区
+ * @param length 缓冲区长度
+ * @param from 输出对端地址
+ * @return 接收的字节数，失败返回-1，非阻塞模式下没有数据时errno为EAGAIN
+ */
+ssize_t UdpSocket::RecvFrom(char* buffer, size_t length, SocketAddress* from) {
+    CHECK(socket_fd_ != -1);
+    struct sockaddr_in address;
+    socklen_t addr_len = sizeof(address);
+    ssize_t ret = recvfrom(socket_fd_, buffer, length, 0,
+                           (struct sockaddr*)&address, &addr_len);
+    if (ret >= 0 && from != nullptr) {
+        *from = SocketAddress(address);
+    }
+    return ret;
+}
+
+/**
+ * 开启内核接收时间戳，之后RecvBatch()从控制消息中取得每个数据报的到达时间
+ * @param mode 时间戳来源
+ * @return 是否成功
+ */
+bool UdpSocket::EnableReceiveTimestamps(TimestampMode mode) {
+    CHECK(socket_fd_ != -1);
+    int ret = 0;
+    if (mode == TimestampMode::kSoftware) {
+        int one = 1;
+        ret = setsockopt(socket_fd_, SOL_SOCKET, SO_TIMESTAMPNS, &one,
+                         sizeof(one));
+    } else if (mode == TimestampMode::kHardware) {
+        int flags = SOF_TIMESTAMPING_RX_HARDWARE |
+                    SOF_TIMESTAMPING_RAW_HARDWARE |
+                    SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        ret = setsockopt(socket_fd_, SOL_SOCKET, SO_TIMESTAMPING, &flags,
+                         sizeof(flags));
+    }
+    if (ret < 0) {
+        LOG(WARNING) << "Failed to enable receive timestamps, "
+                     << strerror(errno);
+        return false;
+    }
+    timestamp_mode_ = mode;
+    return true;
+}
+
+/**
+ * 用一次recvmmsg批量接收数据报，并取出每个数据报的内核到达时间
+ * @param buffer 接收缓冲区，至少max_count * datagram_size字节，
+ *               第i个数据报放在buffer + i * datagram_size
+ * @param datagram_size 每个数据报的最大长度，超出的部分被截断
+ * @param datagrams 输出，至少max_count个
+ * @param max_count 最多接收的数据报数
+ * @return 收到的数据报数，失败返回-1，非阻塞模式下没有数据时errno为EAGAIN
+ */
+int UdpSocket::RecvBatch(char* buffer,
+                         size_t datagram_size,
+                         Datagram* datagrams,
+                         int max_count) {
+    CHECK(socket_fd_ != -1);
+    // 控制消息最大的是SO_TIMESTAMPING的三个timespec
+    const size_t control_size = CMSG_SPACE(sizeof(struct scm_timestamping));
+    if (static_cast<int>(mmsgs_.size()) < max_count) {
+        mmsgs_.resize(max_count);
+        iovecs_.resize(max_count);
+        addresses_.resize(max_count);
+        control_.resize(max_count * control_size);
+    }
+    for (int i = 0; i < max_count; ++i) {
+        iovecs_[i].iov_base = buffer + i * datagram_size;
+        iovecs_[i].iov_len = datagram_size;
+        struct msghdr& hdr = mmsgs_[i].msg_hdr;
+        hdr = {};
+        hdr.msg_name = &addresses_[i];
+        hdr.msg_namelen = sizeof(addresses_[i]);
+        hdr.msg_iov = &iovecs_[i];
+        hdr.msg_iovlen = 1;
+        if (timestamp_mode_ != TimestampMode::kNone) {
+            hdr.msg_control = control_.data() + i * control_size;
+            hdr.msg_controllen = control_size;
+        }
+    }
+
+    int count = recvmmsg(socket_fd_, mmsgs_.data(), max_count, 0, nullptr);
+    if (count <= 0) {
+        return count;
+    }
+
+    // 没有内核时间戳的数据报用读取时的时钟代替
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    for (int i = 0; i < count; ++i) {
+        const struct timespec* arrival = &now;
+        const struct timespec* hardware = nullptr;
+        struct msghdr& hdr = mmsgs_[i].msg_hdr;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET) {
+                continue;
+            }
+            if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                arrival = reinterpret_cast<struct timespec*>(CMSG_DATA(cmsg));
+            } else if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                // ts[0]是CLOCK_REALTIME的软件时间戳，ts[2]是网卡PHC时钟的
+                // 原始硬件时间戳，两者不能混用
+                auto* ts =
+                    reinterpret_cast<struct scm_timestamping*>(CMSG_DATA(cmsg));
+                if (ts->ts[0].tv_sec != 0 || ts->ts[0].tv_nsec != 0) {
+                    arrival = &ts->ts[0];
+                }
+                if (ts->ts[2].tv_sec != 0 || ts->ts[2].tv_nsec != 0) {
+                    hardware = &ts->ts[2];
+                }
+            }
+        }
+
+        Datagram& datagram = datagrams[i];
+        datagram.data = static_cast<char*>(iovecs_[i].iov_base);
+        datagram.length = mmsgs_[i].msg_len;
+        datagram.from = SocketAddress(addresses_[i]);
+        datagram.arrival_ns =
+            static_cast<int64_t>(arrival->tv_sec) * 1000000000 +
+            arrival->tv_nsec;
+        datagram.hardware_ns =
+            hardware == nullptr
+                ? 0
+                : static_cast<int64_t>(hardware->tv_sec) * 1000000000 +
+                      hardware->tv_nsec;
+    }
+    return count;
 }
 
-}  // namespace avrtc
\ No newline at end of file
+}  // namespace avrtc
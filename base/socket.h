@@ -8,13 +8,32 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include "base/buffer.h"
+#include "base/event_loop.h"
+#include "base/framing.h"
+#include "base/object_pool.h"
+#include "base/rate_limiter.h"
+#include "base/zerocopy.h"
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
 
 namespace avrtc {
 
@@ -77,7 +96,8 @@ class SocketAddress {
 class Socket {
  public:
   Socket() = delete;
-  Socket(SocketAddress address);
+  Socket(SocketAddress address, int type = SOCK_STREAM);
+  Socket(int fd, SocketAddress address);
   virtual ~Socket();
 
   virtual void Close();
@@ -85,60 +105,217 @@ class Socket {
   int GetFD() const { return socket_fd_; }
   void SetFD(int fd) { socket_fd_ = fd; }
 
+  bool EnableBusyPoll(int busy_poll_us, bool prefer_busy_poll = true);
+
   SocketAddress address_;
 
  protected:
+  static void SetNonBlocking(int fd);
+
   int socket_fd_ = -1;
 };
 
 // 会话Socket，支持发送和接收数据
+// 收发的数据按FrameCodec分帧，每次回调对应一条完整的消息
+// 发送的消息先进入发送队列，socket可写时用writev批量发出，不阻塞事件循环
+// Send()和发送队列的查询可以在任意线程中调用，其他接口必须在事件循环线程中调用
 class SessionSocket : public Socket,
                       public std::enable_shared_from_this<SessionSocket> {
  public:
   using Socket::Socket;
 
+  // 发送队列超过上限时的处理策略
+  enum class OverflowPolicy {
+    kDropNewest,  // 丢弃新消息，适合可以丢失的数据
+    kDisconnect,  // 断开连接，适合不能丢失的信令
+  };
+
+  struct SendQueueOptions {
+    size_t low_watermark = 64 * 1024;
+    size_t high_watermark = 1024 * 1024;
+    size_t max_queued_bytes = 4 * 1024 * 1024;
+    OverflowPolicy overflow_policy = OverflowPolicy::kDisconnect;
+  };
+
+  // 接收限速，在消息交给OnReceive解析之前执行，速率为0表示不限制
+  // 字节或消息数超限时暂停读取，由TCP流控把压力推回客户端；
+  // 超出消息速率的消息留在接收缓冲区中，恢复读取时再交付，不会丢弃
+  struct RateLimitOptions {
+    double messages_per_sec = 0;
+    double message_burst = 0;
+    double bytes_per_sec = 0;
+    double byte_burst = 0;
+  };
+
+  void Close() override;
+
   int Send(const char* buffer, size_t length);
   int Send(std::string message);
+  int Send(SharedBuffer message);
   bool Recv();
+  bool HandleWrite();
+
+  void AttachLoop(EventLoop* loop) { loop_ = loop; }
+  EventLoop* GetLoop() const { return loop_; }
+  void SetSendQueueOptions(const SendQueueOptions& options) {
+    send_options_ = options;
+  }
+  size_t GetQueuedBytes();
+  bool IsBackpressured();
+
+  // 限速接口只能在事件循环线程中调用
+  void SetRateLimit(const RateLimitOptions& options);
+  bool IsReadPaused() const { return read_paused_; }
+
+  bool EnableZeroCopy(size_t threshold = ZeroCopyTracker::kDefaultThreshold);
+  void HandleErrorQueue();
+  size_t GetZeroCopyPending();
 
   using OnReceiveCallback = std::function<void(
       std::shared_ptr<SessionSocket>, char* buffer, size_t length)>;
   using OnCloseCallback = std::function<void(std::shared_ptr<SessionSocket>)>;
+  using OnWatermarkCallback =
+      std::function<void(std::shared_ptr<SessionSocket>, size_t queued_bytes)>;
 
   /**
-   * 设置接收数据回调,触发时机：每次接收到数据时
+   * 设置接收数据回调,触发时机：每收到一条完整的消息时，
+   * buffer指向接收缓冲区内部，仅在回调期间有效
    */
   void SetOnReceive(OnReceiveCallback cb) { OnReceive_ = cb; }
   /**
    * 设置连接关闭回调,触发时机：连接断开时
    */
   void SetOnClose(OnCloseCallback cb) { OnClose_ = cb; }
+  /**
+   * 设置高水位回调,触发时机：发送队列积压超过high_watermark时，
+   * 生产者应当暂停发送
+   */
+  void SetOnHighWatermark(OnWatermarkCallback cb) { OnHighWatermark_ = cb; }
+  /**
+   * 设置低水位回调,触发时机：越过高水位后积压回落到low_watermark以下时，
+   * 生产者可以恢复发送
+   */
+  void SetOnLowWatermark(OnWatermarkCallback cb) { OnLowWatermark_ = cb; }
+
+ protected:
+  void AdoptFD(int fd);
+  void ResetConnectionState();
 
  private:
+  // 发送队列中的一帧，长度前缀内联存储，消息体共享引用
+  struct OutboundFrame {
+    char header[FrameCodec::kHeaderSize];
+    SharedBuffer payload;
+    size_t sent = 0;  // 本帧已经发出的字节数，包括长度前缀
+
+    size_t Size() const { return FrameCodec::kHeaderSize + payload->size(); }
+  };
+
+  enum class Watermark { kNone, kHigh, kLow };
+
+  bool FlushLocked();
+  bool UseZeroCopyLocked(size_t batch_bytes) const;
+  Watermark CheckWatermarkLocked();
+  void NotifyWatermark(Watermark watermark, size_t queued_bytes);
+  void UpdateWriteInterest(bool want_write);
+  uint32_t InterestEventsLocked() const;
+  bool DeliverFrames(int64_t now_ns, int64_t* wait_ns);
+  void PauseReading(int64_t wait_ns);
+  void ResumeReading();
+  void OnResumeTimer();
+  void CancelResumeTimer();
+
   OnReceiveCallback OnReceive_;
   OnCloseCallback OnClose_;
+  OnWatermarkCallback OnHighWatermark_;
+  OnWatermarkCallback OnLowWatermark_;
+  // 首次收到数据时才分配，大量空闲连接不占用接收缓冲区
+  Buffer recv_buffer_{0};
+
+  // 保护发送状态和socket_fd_的修改，其他线程中的Send()持有它读取socket_fd_
+  std::mutex send_mutex_;
+  std::deque<OutboundFrame> send_queue_;
+  size_t queued_bytes_ = 0;
+  bool backpressured_ = false;
+  bool want_write_ = false;
+  SendQueueOptions send_options_;
+  EventLoop* loop_ = nullptr;
+  // 开启零拷贝后，一次发送的字节数达到阈值时使用MSG_ZEROCOPY
+  std::unique_ptr<ZeroCopyTracker> zerocopy_;
+  size_t zerocopy_threshold_ = 0;
+
+  RateLimitOptions rate_options_;
+  TokenBucket message_bucket_;
+  TokenBucket byte_bucket_;
+  // 限速期间不关注EPOLLIN，到期后由resume_timer_恢复
+  std::atomic<bool> read_paused_{false};
+  EventLoop::TimerId resume_timer_ = TimerWheel::kInvalidTimerId;
 };
 
 // 客户端Socket，支持连接到服务器
+// ConnectAsync在事件循环中非阻塞地连接（EINPROGRESS后等待EPOLLOUT），
+// 支持连接超时和指数退避重连，大量客户端可以共享同一个事件循环
 class ClientSocket : public SessionSocket {
  public:
   using SessionSocket::SessionSocket;
+
+  enum class State { kDisconnected, kConnecting, kConnected };
+
+  struct ConnectOptions {
+    int connect_timeout_ms = 5000;  // 0表示不设超时
+    bool reconnect = false;         // 连接失败或断开后是否自动重连
+    int initial_backoff_ms = 500;   // 第一次重连的等待时间，之后每次翻倍
+    int max_backoff_ms = 30000;
+  };
+
   using OnConnectedCallback = std::function<void()>;
+  using OnConnectFailedCallback = std::function<void(int error)>;
   void SetOnConnected(OnConnectedCallback cb) { OnConnected_ = cb; }
+  /**
+   * 设置连接失败回调,触发时机：连接被拒绝、超时等，error为errno，
+   * 开启重连时之后会按退避时间重试
+   */
+  void SetOnConnectFailed(OnConnectFailedCallback cb) {
+    OnConnectFailed_ = cb;
+  }
+  void SetConnectOptions(const ConnectOptions& options) {
+    connect_options_ = options;
+  }
 
   void Connect();
+  void ConnectAsync(EventLoop* loop);
   void Stop();
 
+  State GetState() const { return state_; }
+
  private:
-  bool running_ = true;
+  void StartConnect();
+  void HandleEvent(uint32_t events);
+  void HandleConnectEvent(uint32_t events);
+  void OnConnectEstablished();
+  void OnConnectError(int error);
+  void OnDisconnected();
+  void ScheduleReconnect();
+  void Teardown();
+
+  std::atomic<bool> running_{true};
+  std::atomic<State> state_{State::kDisconnected};
+  ConnectOptions connect_options_;
+  EventLoop::TimerId connect_timer_ = TimerWheel::kInvalidTimerId;
+  EventLoop::TimerId reconnect_timer_ = TimerWheel::kInvalidTimerId;
+  int backoff_ms_ = 0;
+  // Connect()中创建的事件循环，连接结束且不再重连时停止它
+  EventLoop* owned_loop_ = nullptr;
+
   OnConnectedCallback OnConnected_;
+  OnConnectFailedCallback OnConnectFailed_;
 };
 
 // 服务器Socket，支持接受客户端连接
 class ServerSocket : public Socket {
  public:
-  const int MAX_EVENTS = 20;
-  const int TIMEOUT_MS = 1000;
+  // 定期输出连接数的间隔
+  const int STATS_INTERVAL_MS = 10000;
 
   ServerSocket(SocketAddress address);
   void Close() override;
@@ -146,18 +323,100 @@ class ServerSocket : public Socket {
   void Start();
   void Stop();
 
+  /**
+   * 获取服务器的事件循环，可以在上面注册定时器（保活、会话超时等），
+   * 与连接的收发在同一个线程中执行
+   */
+  EventLoop* GetLoop() { return &loop_; }
+
+  /**
+   * 准入控制：连接数上限在accept时执行，房间上限由上层在加入房间时查询
+   * 只能在事件循环线程中使用（或在Start()之前）
+   */
+  AdmissionController* GetAdmission() { return &admission_; }
+  // 每个新连接的接收限速，在Start()之前设置
+  void SetSessionRateLimit(const SessionSocket::RateLimitOptions& options) {
+    session_rate_limit_ = options;
+  }
+
   using OnAcceptCallback = std::function<void(std::shared_ptr<SessionSocket>)>;
   void SetOnAccept(OnAcceptCallback cb) { OnAccept_ = cb; }
 
  private:
-  static void SetNonBlocking(int fd);
-  int epoll_fd;
-  bool running_ = true;
-  std::unordered_map<int, std::shared_ptr<SessionSocket>> clients_;
+  void HandleClientEvent(int fd, uint32_t events);
+
+  EventLoop loop_;
+  std::atomic<bool> running_{true};
+  // 按fd下标存放的连接，fd由内核按最小可用分配，数组保持紧凑
+  std::vector<std::shared_ptr<SessionSocket>> clients_;
+  size_t client_count_ = 0;
+  // 连接对象和shared_ptr控制块从池中分配，断开后的内存留给后续连接复用
+  std::shared_ptr<BlockPool> session_pool_;
+  AdmissionController admission_;
+  SessionSocket::RateLimitOptions session_rate_limit_;
 
   OnAcceptCallback OnAccept_;
 };
 
+// UDP Socket，用于收发媒体数据报
+class UdpSocket : public Socket {
+ public:
+  // 接收时间戳的来源
+  enum class TimestampMode {
+    kNone,      // 不开启，到达时间取读取时的时钟
+    kSoftware,  // SO_TIMESTAMPNS，协议栈收到数据报时的时间
+    // SO_TIMESTAMPING，到达时间同样取软件时间戳，另外取网卡原始硬件时间戳
+    // 放在hardware_ns中；这里不调用SIOCSHWTSTAMP，网卡的接收时间戳需要事先
+    // 开启（例如hwstamp_ctl，需要CAP_NET_ADMIN），否则hardware_ns为0
+    kHardware,
+  };
+
+  // RecvBatch()收到的一个数据报
+  struct Datagram {
+    char* data = nullptr;
+    size_t length = 0;
+    SocketAddress from{0};
+    // 到达时间（CLOCK_REALTIME纳秒），开启时间戳时由内核记录，
+    // 不包含用户态调度和读取的延迟
+    int64_t arrival_ns = 0;
+    // 网卡PHC时钟的原始硬件时间戳，和arrival_ns不是同一个时钟，
+    // 只能和同一块网卡的硬件时间戳相减；没有时为0
+    int64_t hardware_ns = 0;
+  };
+
+  UdpSocket(SocketAddress address);
+
+  bool Bind(bool reuse_port = false);
+  void SetNonBlocking() { Socket::SetNonBlocking(socket_fd_); }
+  ssize_t SendTo(const char* buffer, size_t length, const SocketAddress& to);
+  ssize_t SendTo(SharedBuffer buffer, const SocketAddress& to);
+  ssize_t RecvFrom(char* buffer, size_t length, SocketAddress* from);
+
+  bool EnableReceiveTimestamps(TimestampMode mode);
+  int RecvBatch(char* buffer,
+                size_t datagram_size,
+                Datagram* datagrams,
+                int max_count);
+
+  // 零拷贝接口只能在事件循环线程中调用
+  bool EnableZeroCopy(size_t threshold = ZeroCopyTracker::kDefaultThreshold);
+  void HandleErrorQueue();
+  size_t GetZeroCopyPending() const {
+    return zerocopy_ ? zerocopy_->GetPendingCount() : 0;
+  }
+
+ private:
+  std::unique_ptr<ZeroCopyTracker> zerocopy_;
+  size_t zerocopy_threshold_ = 0;
+
+  TimestampMode timestamp_mode_ = TimestampMode::kNone;
+  // recvmmsg的参数数组，按批量大小复用，避免每次读取分配
+  std::vector<struct mmsghdr> mmsgs_;
+  std::vector<struct iovec> iovecs_;
+  std::vector<struct sockaddr_in> addresses_;
+  std::vector<char> control_;
+};
+
 }  // namespace avrtc
 
 #endif  // BASE_SOCKET_H
\ No newline at end of file
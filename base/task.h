@@ -0,0 +1,143 @@
+#ifndef BASE_TASK_H
+#define BASE_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace avrtc {
+
+/**
+ * 任务的优先级类别，数值越小越优先
+ * kRealtime用于音视频包处理等对延迟敏感的工作，kNormal用于信令和界面更新，
+ * kBackground用于统计、录制落盘等可以推迟的工作
+ */
+enum class TaskPriority { kRealtime, kNormal, kBackground };
+static const int kTaskPriorityCount = 3;
+
+/**
+ * 只能移动的无参任务，代替std::function<void()>
+ * 不超过kInlineSize字节、可以无异常移动的可调用对象直接存放在对象内部，
+ * 投递常见的lambda（捕获几个指针、shared_ptr或小字符串）不需要分配内存；
+ * 任务在队列中只移动不拷贝，捕获的shared_ptr不会产生额外的引用计数操作
+ * 更大的可调用对象放到堆上
+ */
+class Task {
+ public:
+  static const size_t kInlineSize = 48;
+
+  // 可调用对象能否存放在对象内部
+  template <typename F>
+  static constexpr bool FitsInline() {
+    return sizeof(F) <= kInlineSize && alignof(F) <= kInlineAlign &&
+           std::is_nothrow_move_constructible<F>::value;
+  }
+
+  Task() = default;
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same<std::decay_t<F>, Task>::value>>
+  Task(F&& f) {
+    using Callable = std::decay_t<F>;
+    // 空的std::function和空函数指针构造出空任务，函数名本身不会为空
+    if constexpr (IsNullable<Callable>::value &&
+                  !std::is_function<std::remove_reference_t<F>>::value) {
+      if (!f) {
+        return;
+      }
+    }
+    if constexpr (FitsInline<Callable>()) {
+      new (storage_) Callable(std::forward<F>(f));
+      ops_ = &InlineOps<Callable>::kOps;
+    } else {
+      *reinterpret_cast<Callable**>(storage_) =
+          new Callable(std::forward<F>(f));
+      ops_ = &HeapOps<Callable>::kOps;
+    }
+  }
+
+  Task(Task&& other) noexcept { MoveFrom(&other); }
+
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() { Reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  void operator()() { ops_->invoke(storage_); }
+
+  void Reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  static const size_t kInlineAlign = alignof(std::max_align_t);
+
+  // 可能为空的可调用对象：函数指针，或者有operator bool的类型如std::function
+  template <typename F, typename = void>
+  struct IsNullable : std::is_pointer<F> {};
+  template <typename F>
+  struct IsNullable<F, std::void_t<decltype(&F::operator bool)>>
+      : std::true_type {};
+
+  struct Ops {
+    void (*invoke)(void* storage);
+    // 把src中的对象移动到未初始化的dst，并析构src中的对象
+    void (*relocate)(void* dst, void* src);
+    void (*destroy)(void* storage);
+  };
+
+  template <typename F>
+  struct InlineOps {
+    static void Invoke(void* storage) { (*static_cast<F*>(storage))(); }
+    static void Relocate(void* dst, void* src) {
+      F* from = static_cast<F*>(src);
+      new (dst) F(std::move(*from));
+      from->~F();
+    }
+    static void Destroy(void* storage) { static_cast<F*>(storage)->~F(); }
+    static constexpr Ops kOps = {Invoke, Relocate, Destroy};
+  };
+
+  template <typename F>
+  struct HeapOps {
+    static F* Get(void* storage) { return *static_cast<F**>(storage); }
+    static void Invoke(void* storage) { (*Get(storage))(); }
+    static void Relocate(void* dst, void* src) {
+      *static_cast<F**>(dst) = Get(src);
+    }
+    static void Destroy(void* storage) { delete Get(storage); }
+    static constexpr Ops kOps = {Invoke, Relocate, Destroy};
+  };
+
+  void MoveFrom(Task* other) {
+    if (other->ops_ != nullptr) {
+      other->ops_->relocate(storage_, other->storage_);
+      ops_ = other->ops_;
+      other->ops_ = nullptr;
+    }
+  }
+
+  alignas(kInlineAlign) unsigned char storage_[kInlineSize];
+  const Ops* ops_ = nullptr;
+};
+
+static_assert(sizeof(Task) == 64, "Task should fit in one cache line");
+
+}  // namespace avrtc
+
+#endif  // BASE_TASK_H
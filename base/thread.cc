@@ -1,86 +1,916 @@
 #include "base/thread.h"
 
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <thread>
+
+#include "base/event_loop.h"
+
 namespace avrtc {
 
-Thread::Thread() {
+// set_mempolicy节点掩码的位数
+static const int kMaxNumaNodes = 1024;
+
+// 当前线程对应的Thread，不在Thread中时为nullptr
+static thread_local Thread* current_thread = nullptr;
+// 当前线程中ForEachThread()正在回调访问的线程，嵌套枚举时链到外层
+struct EnumerationFrame {
+    Thread* thread;
+    EnumerationFrame* outer;
+};
+static thread_local EnumerationFrame* current_enumeration = nullptr;
+
+/**
+ * 解析sysfs中的CPU列表，例如"0-3,8,10-11"
+ */
+static std::vector<int> ParseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string range = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (range.empty() || !isdigit(range[0])) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = dash == std::string::npos
+                       ? first
+                       : atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+static std::vector<int> ReadCpuList(const std::string& path) {
+    std::ifstream file(path);
+    std::string text;
+    if (!std::getline(file, text)) {
+        return {};
+    }
+    return ParseCpuList(text);
+}
+
+void FutexWait(std::atomic<uint32_t>* address, uint32_t expected,
+               int64_t timeout_ns) {
+    struct timespec timeout;
+    struct timespec* timeout_ptr = nullptr;
+    if (timeout_ns >= 0) {
+        timeout.tv_sec = timeout_ns / 1000000000;
+        timeout.tv_nsec = timeout_ns % 1000000000;
+        timeout_ptr = &timeout;
+    }
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address),
+            FUTEX_WAIT_PRIVATE, expected, timeout_ptr, nullptr, 0);
+}
+
+void FutexWake(std::atomic<uint32_t>* address) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address),
+            FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+Thread::Thread() : Thread(ThreadOptions()) {}
+
+/**
+ * 构造函数，按options创建并启动线程
+ * @param options 线程参数
+ */
+Thread::Thread(const ThreadOptions& options) : options_(options) {
     pthread_attr_t attr;
     pthread_attr_init(&attr);
-    pthread_create(&thread_, &attr, Thread::PreRun, this);
+    if (options_.stack_size > 0) {
+        int ret = pthread_attr_setstacksize(&attr, options_.stack_size);
+        if (ret != 0) {
+            LOG(WARNING) << "Invalid thread stack size "
+                         << options_.stack_size << ", " << strerror(ret);
+        }
+    }
+    int ret = pthread_create(&thread_, &attr, Thread::PreRun, this);
+    pthread_attr_destroy(&attr);
+    CHECK_EQ(ret, 0) << "Failed to create thread, " << strerror(ret);
+    ThreadManager::Instance()->Add(this);
 }
 
 Thread::Thread(std::shared_ptr<void> thread_local_data) : Thread() {
     thread_local_data_ = thread_local_data;
 }
 
+/**
+ * 析构函数，从ThreadManager中删除，停止线程并等待它退出，队列中的任务直接丢弃
+ * 不能在本线程的任务中析构：任务返回后线程还要访问自己的成员
+ */
 Thread::~Thread() {
-    pthread_detach(thread_);
+    CHECK(!IsCurrent()) << "Thread cannot be destroyed from its own task";
+    ThreadManager::Instance()->Remove(this);
+    Stop();
+    Join();
+}
+
+/**
+ * 停止线程，可以在任意线程中调用，不等待线程退出
+ * 正在执行的任务结束后线程退出循环；kDrainPending时先执行完队列中已有的任务，
+ * 包括执行过程中新投递的任务
+ * @param mode 如何处理队列中的任务
+ */
+void Thread::Stop(StopMode mode) {
+    stop_mode_.store(mode, std::memory_order_relaxed);
+    if (mode == StopMode::kDiscardPending) {
+        accepting_.store(false);
+    }
+    running_.store(false, std::memory_order_release);
+    Wakeup();
 }
 
-void Thread::Stop() {
-    running_ = false;
+/**
+ * 任务队列的统计快照，可以在任意线程中调用
+ */
+ThreadStats Thread::GetStats() const {
+    return metrics_.GetStats();
 }
 
+/**
+ * 等待线程退出，可以重复调用，不能在本线程中调用
+ */
 void Thread::Join() {
-    pthread_join(thread_, nullptr);
+    if (IsCurrent()) {
+        LOG(ERROR) << "Thread cannot join itself";
+        return;
+    }
+    if (!joined_.exchange(true)) {
+        pthread_join(thread_, nullptr);
+    }
+}
+
+bool Thread::IsCurrent() const {
+    return current_thread == this;
+}
+
+void Thread::MarkCurrentTaskAsLoop() {
+    if (current_thread != nullptr) {
+        current_thread->in_loop_task_ = true;
+    }
 }
 
 void* Thread::PreRun(void* pv) {
     Thread* thread = static_cast<Thread*>(pv);
+    current_thread = thread;
+    thread->ApplyOptions();
     thread->Run();
     return nullptr;
 }
 
+/**
+ * 在新线程中设置线程名、绑核、内存节点和调度策略
+ * 内存策略只影响之后分配的内存，线程中创建的事件循环、对象池等都在本节点上
+ */
+void Thread::ApplyOptions() {
+    if (!options_.name.empty()) {
+        pthread_setname_np(pthread_self(), options_.name.substr(0, 15).c_str());
+    }
+
+    std::vector<int> cpus = options_.cpus;
+    if (cpus.empty() && options_.numa_node >= 0) {
+        cpus = ReadCpuList("/sys/devices/system/node/node" +
+                           std::to_string(options_.numa_node) + "/cpulist");
+    }
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (ret != 0) {
+            LOG(WARNING) << "Failed to set affinity of thread "
+                         << options_.name << ", " << strerror(ret);
+        }
+    }
+
+    if (options_.numa_node >= 0 && options_.numa_node < kMaxNumaNodes) {
+        const int bits = sizeof(unsigned long) * 8;
+        unsigned long mask[kMaxNumaNodes / bits] = {};
+        mask[options_.numa_node / bits] |= 1UL << (options_.numa_node % bits);
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                    kMaxNumaNodes + 1) != 0) {
+            LOG(WARNING) << "Failed to prefer numa node "
+                         << options_.numa_node << ", " << strerror(errno);
+        }
+    }
+
+    if (options_.sched_policy != SCHED_OTHER) {
+        sched_param param = {};
+        param.sched_priority = options_.sched_priority;
+        int ret = pthread_setschedparam(pthread_self(), options_.sched_policy,
+                                        &param);
+        if (ret != 0) {
+            LOG(WARNING) << "Failed to set scheduling policy of thread "
+                         << options_.name << ", " << strerror(ret);
+        }
+    }
+}
+
 void Thread::Run() {
-    ThreadManager::Instance()->Add(this);
-    ThreadManager::Instance()->SetCurrentThread(this);
+    ThreadManager::Instance()->OnThreadStart(this);
 
     while (running_) {
-        std::function<void()> task;
+        int64_t wait_ns = RunDueTasks();
+        QueuedTask queued;
+        if (!PopNextTask(&queued)) {
+            Park(wait_ns);
+            continue;
+        }
+        RunQueuedTask(&queued);
+    }
+
+    bool drain =
+        stop_mode_.load(std::memory_order_relaxed) == StopMode::kDrainPending;
+    if (drain) {
+        DrainPendingTasks();
+    }
+    StopAccepting();
+    // 停止接受之前刚刚入队的任务
+    if (drain) {
+        DrainPendingTasks();
+    }
+    DiscardPendingTasks();
+    ThreadManager::Instance()->OnThreadExit(this);
+}
+
+void Thread::DrainPendingTasks() {
+    QueuedTask queued;
+    while (PopNextTask(&queued)) {
+        RunQueuedTask(&queued);
+    }
+}
+
+/**
+ * 选出下一个要执行的任务：
+ * 1. 队头距离截止时间不到deadline_slack_us的任务，多个时取截止时间最早的；
+ * 2. 被更高类别连续插队starvation_limit次的类别，多个时取最低的类别；
+ * 3. 否则取优先级最高的非空类别
+ * 只比较各类别的队头，类别内部仍然先进先出
+ * @param queued 取出的任务
+ * @return 是否取到
+ */
+bool Thread::PopNextTask(QueuedTask* queued) {
+    QueuedTask* heads[kTaskPriorityCount];
+    int chosen = -1;
+    bool has_deadline = false;
+    for (int i = 0; i < kTaskPriorityCount; ++i) {
+        heads[i] = tasks_[i].Front();
+        if (heads[i] == nullptr) {
+            continue;
+        }
+        if (chosen < 0) {
+            chosen = i;
+        }
+        has_deadline = has_deadline || heads[i]->deadline_ns > 0;
+    }
+    if (chosen < 0) {
+        return false;
+    }
+
+    int urgent = -1;
+    if (has_deadline) {
+        int64_t horizon =
+            EventLoop::NowNs() + options_.deadline_slack_us * 1000;
+        for (int i = 0; i < kTaskPriorityCount; ++i) {
+            if (heads[i] != nullptr && heads[i]->deadline_ns > 0 &&
+                heads[i]->deadline_ns <= horizon &&
+                (urgent < 0 ||
+                 heads[i]->deadline_ns < heads[urgent]->deadline_ns)) {
+                urgent = i;
+            }
+        }
+    }
+    if (urgent >= 0) {
+        chosen = urgent;
+    } else {
+        for (int i = kTaskPriorityCount - 1; i > chosen; --i) {
+            if (heads[i] != nullptr &&
+                skipped_[i] >= options_.starvation_limit) {
+                chosen = i;
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < kTaskPriorityCount; ++i) {
+        if (i == chosen || heads[i] == nullptr) {
+            skipped_[i] = 0;
+        } else if (i > chosen) {
+            ++skipped_[i];
+        }
+    }
+    return tasks_[chosen].Pop(queued);
+}
+
+void Thread::RunQueuedTask(QueuedTask* queued) {
+    bool missed = false;
+    if (queued->deadline_ns > 0) {
+        int64_t now = EventLoop::NowNs();
+        missed = now > queued->deadline_ns;
+        if (options_.enable_metrics) {
+            last_task_end_ns_ = now;
+        }
+    }
+    metrics_.OnDequeued(queued->priority, missed);
+    int64_t queue_ns = RunTask(&queued->task, queued->posted_ns, queued->from);
+    if (queue_ns >= 0) {
+        metrics_.OnQueueLatency(queued->priority, queue_ns);
+    }
+    queued->task.Reset();
+}
+
+/**
+ * 执行一个任务，开启统计时记录等待时间和执行时间，执行时间超过阈值时打印投递位置
+ * @param task 任务
+ * @param ready_ns 任务可以开始执行的时间，投递时间或延迟任务的到期时间
+ * @param from 投递位置
+ * @return 等待时间，没有统计时返回-1
+ */
+int64_t Thread::RunTask(Task* task, int64_t ready_ns, const Location& from) {
+    if (!*task) {
+        return -1;
+    }
+    if (!options_.enable_metrics) {
+        (*task)();
+        return -1;
+    }
+    // 连续执行的任务用上一个任务的结束时间作为开始时间，少读一次时钟
+    int64_t start_ns =
+        last_task_end_ns_ > 0 ? last_task_end_ns_ : EventLoop::NowNs();
+    // 循环任务中执行的任务照常统计
+    bool in_loop = in_loop_task_;
+    (*task)();
+    if (in_loop_task_ && !in_loop) {
+        in_loop_task_ = false;
+        last_task_end_ns_ = 0;
+        return start_ns - ready_ns;
+    }
+    last_task_end_ns_ = EventLoop::NowNs();
+    int64_t run_ns = last_task_end_ns_ - start_ns;
+    bool long_task = options_.long_task_threshold_ms > 0 &&
+                     run_ns >= options_.long_task_threshold_ms * 1000000;
+    metrics_.OnTaskTimed(start_ns - ready_ns, run_ns, long_task);
+    if (long_task) {
+        LOG(WARNING) << "Task posted from " << from.ToString() << " ran "
+                     << run_ns / 1000000 << " ms on thread "
+                     << options_.name;
+    }
+    return start_ns - ready_ns;
+}
+
+/**
+ * 不再接受新任务，并等待已经通过检查的投递方入队完成，
+ * 之后队列不会再增长
+ */
+void Thread::StopAccepting() {
+    accepting_.store(false);
+    while (posting_.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * 在本线程中析构队列中剩下的任务和所有延迟任务，
+ * InvokeAsync()的future随之报告broken_promise
+ */
+void Thread::DiscardPendingTasks() {
+    QueuedTask queued;
+    for (auto& tasks : tasks_) {
+        while (tasks.Pop(&queued)) {
+            metrics_.OnDiscarded(queued.priority);
+            queued.task = Task();
+        }
+    }
+    DelayedTask delayed;
+    while (incoming_delayed_.Pop(&delayed)) {
+        delayed_tasks_.push_back(std::move(delayed));
+    }
+    for (DelayedTask& delayed_task : delayed_tasks_) {
+        // 闭包在锁外析构
+        Task discarded;
+        std::lock_guard<std::mutex> lock(delayed_task.state->mutex);
+        delayed_task.state->cancelled.store(true, std::memory_order_relaxed);
+        discarded = std::move(delayed_task.state->task);
+    }
+    delayed_tasks_.clear();
+}
+
+/**
+ * 投递方入队之前调用，线程已经停止接受任务时返回false
+ * 和StopAccepting()配合：通过检查的投递方入队完成之前，线程不会清空队列
+ */
+bool Thread::BeginPost() {
+    posting_.fetch_add(1);
+    if (!accepting_.load()) {
+        posting_.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void Thread::EndPost() {
+    posting_.fetch_sub(1, std::memory_order_release);
+}
+
+/**
+ * 把新投递的延迟任务移入堆中，并执行所有已经到期的延迟任务
+ * @return 距离下一个延迟任务到期的纳秒数，没有延迟任务时返回kForever
+ */
+int64_t Thread::RunDueTasks() {
+    auto later = [](const DelayedTask& a, const DelayedTask& b) {
+        return a.deadline_ns != b.deadline_ns ? a.deadline_ns > b.deadline_ns
+                                              : a.sequence > b.sequence;
+    };
+    DelayedTask incoming;
+    while (incoming_delayed_.Pop(&incoming)) {
+        delayed_tasks_.push_back(std::move(incoming));
+        std::push_heap(delayed_tasks_.begin(), delayed_tasks_.end(), later);
+    }
+    if (delayed_tasks_.empty()) {
+        return kForever;
+    }
+
+    int64_t now = EventLoop::NowNs();
+    while (!delayed_tasks_.empty() &&
+           delayed_tasks_.front().deadline_ns <= now) {
+        std::pop_heap(delayed_tasks_.begin(), delayed_tasks_.end(), later);
+        DelayedTask due = std::move(delayed_tasks_.back());
+        delayed_tasks_.pop_back();
+        // 已经取消的任务闭包已被释放，取出的是空任务
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(due.state->mutex);
+            task = std::move(due.state->task);
+        }
+        if (!task) {
+            continue;
+        }
+        RunTask(&task, due.deadline_ns, due.from);
+        if (due.period_ns == 0 || !running_) {
+            continue;
+        }
+        // 周期任务放回共享状态，执行期间被取消时在这里析构
         {
-            std::unique_lock<std::mutex> lock(mutex_);
-            cond_var_.wait(lock, [this]() { return !tasks_.empty(); });
-            task = tasks_.front();
-            tasks_.erase(tasks_.begin());
+            std::lock_guard<std::mutex> lock(due.state->mutex);
+            if (due.state->cancelled.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            due.state->task = std::move(task);
         }
-        if (task) {
-            task();
+        // 按原定节奏重新入堆，落后超过一个周期时跳过错过的执行
+        due.deadline_ns += due.period_ns;
+        if (due.deadline_ns < now) {
+            due.deadline_ns = now + due.period_ns;
         }
+        delayed_tasks_.push_back(std::move(due));
+        std::push_heap(delayed_tasks_.begin(), delayed_tasks_.end(), later);
+    }
+    if (delayed_tasks_.empty()) {
+        return kForever;
     }
+    return std::max<int64_t>(
+        delayed_tasks_.front().deadline_ns - EventLoop::NowNs(), 0);
 }
 
-void Thread::AddTask(const std::function<void()>& task) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    tasks_.push_back(task);
-    cond_var_.notify_one();
+bool Thread::HasPendingTasks() {
+    for (auto& tasks : tasks_) {
+        if (!tasks.Empty()) {
+            return true;
+        }
+    }
+    return !incoming_delayed_.Empty();
 }
 
-ThreadManager::ThreadManager() {
-    pthread_key_create(&thread_key_, nullptr);
+/**
+ * 队列为空时睡眠，先设置parked_再检查一次队列，
+ * 和AddTask()中先入队再检查parked_的顺序配合，保证不会错过唤醒
+ * @param timeout_ns 最长睡眠时间，kForever表示直到被唤醒
+ */
+void Thread::Park(int64_t timeout_ns) {
+    last_task_end_ns_ = 0;
+    if (timeout_ns == 0) {
+        return;
+    }
+    parked_.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!HasPendingTasks() && running_.load(std::memory_order_relaxed)) {
+        if (options_.enable_metrics) {
+            int64_t start_ns = EventLoop::NowNs();
+            FutexWait(&parked_, 1, timeout_ns);
+            metrics_.OnIdle(EventLoop::NowNs() - start_ns);
+        } else {
+            FutexWait(&parked_, 1, timeout_ns);
+        }
+    }
+    parked_.store(0, std::memory_order_relaxed);
 }
 
-ThreadManager::~ThreadManager() {
-    pthread_key_delete(thread_key_);
+/**
+ * 投递任务，可以在任意线程中调用
+ * @param task 任务
+ * @param from 投递位置，默认为调用方
+ */
+void Thread::AddTask(Task&& task, const Location& from) {
+    PostTask(TaskPriority::kNormal, std::move(task), from);
 }
 
-void ThreadManager::Add(Thread* thread) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    threads_.push_back(thread);
+/**
+ * 按优先级类别投递任务，可以在任意线程中调用
+ * @param priority 优先级类别
+ * @param task 任务
+ * @param from 投递位置，默认为调用方
+ */
+void Thread::PostTask(TaskPriority priority, Task&& task,
+                      const Location& from) {
+    QueuedTask queued;
+    queued.task = std::move(task);
+    queued.posted_ns = options_.enable_metrics ? EventLoop::NowNs() : 0;
+    queued.priority = priority;
+    queued.from = from;
+    Enqueue(std::move(queued));
+}
+
+/**
+ * 投递有截止时间的任务，可以在任意线程中调用
+ * 距离截止时间不到deadline_slack_us时，任务在更高优先级类别的任务之前执行；
+ * 截止时间之后才开始执行的任务计入deadline_misses，但仍然会执行
+ * @param priority 优先级类别
+ * @param deadline_ms 从现在起最晚开始执行的毫秒数
+ * @param task 任务
+ * @param from 投递位置，默认为调用方
+ */
+void Thread::PostTaskWithDeadline(TaskPriority priority, int64_t deadline_ms,
+                                  Task&& task, const Location& from) {
+    QueuedTask queued;
+    queued.task = std::move(task);
+    queued.posted_ns = EventLoop::NowNs();
+    int64_t deadline_ns = std::max<int64_t>(deadline_ms, 0) * 1000000;
+    queued.deadline_ns = queued.posted_ns + deadline_ns;
+    queued.priority = priority;
+    queued.from = from;
+    Enqueue(std::move(queued));
+}
+
+/**
+ * 任务入队，线程已经停止接受任务时不入队，任务随queued在调用方析构
+ */
+void Thread::Enqueue(QueuedTask&& queued) {
+    if (!BeginPost()) {
+        return;
+    }
+    TaskPriority priority = queued.priority;
+    metrics_.OnPosted(priority);
+    tasks_[static_cast<int>(priority)].Push(std::move(queued));
+    Wakeup();
+    EndPost();
+}
+
+/**
+ * 投递延迟任务，可以在任意线程中调用
+ * @param delay_ms 延迟的毫秒数
+ * @param task 任务
+ * @param from 投递位置，默认为调用方
+ * @return 取消句柄
+ */
+TaskHandle Thread::PostDelayedTask(int64_t delay_ms, Task&& task,
+                                   const Location& from) {
+    return PostDelayed(delay_ms * 1000000, 0, std::move(task), from);
 }
 
+/**
+ * 投递周期任务，第一次在一个周期之后执行，可以在任意线程中调用
+ * @param period_ms 周期的毫秒数，必须大于0
+ * @param task 任务，每次到期都执行同一个对象
+ * @param from 投递位置，默认为调用方
+ * @return 取消句柄，周期任务一直执行到取消或者线程停止
+ */
+TaskHandle Thread::PostRepeatingTask(int64_t period_ms, Task&& task,
+                                     const Location& from) {
+    CHECK_GT(period_ms, 0);
+    return PostDelayed(period_ms * 1000000, period_ms * 1000000,
+                       std::move(task), from);
+}
+
+TaskHandle Thread::PostDelayed(int64_t delay_ns, int64_t period_ns,
+                               Task&& task, const Location& from) {
+    DelayedTask delayed;
+    delayed.deadline_ns =
+        EventLoop::NowNs() + std::max<int64_t>(delay_ns, 0);
+    delayed.sequence =
+        delayed_sequence_.fetch_add(1, std::memory_order_relaxed);
+    delayed.period_ns = period_ns;
+    delayed.state = std::make_shared<TaskHandle::State>();
+    delayed.from = from;
+    TaskHandle handle(delayed.state);
+    // 线程已经停止时不入队，返回已取消的句柄
+    if (!BeginPost()) {
+        delayed.state->cancelled.store(true, std::memory_order_relaxed);
+        return handle;
+    }
+    delayed.state->task = std::move(task);
+    incoming_delayed_.Push(std::move(delayed));
+    Wakeup();
+    EndPost();
+    return handle;
+}
+
+void Thread::Wakeup() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_relaxed) == 1 &&
+        parked_.exchange(0) == 1) {
+        FutexWake(&parked_);
+    }
+}
+
+/**
+ * 取消任务并释放闭包，闭包在锁外析构，析构时可以再投递或取消任务
+ * 任务正在执行时由执行的线程在执行结束后释放
+ */
+void TaskHandle::Cancel() {
+    if (!state_) {
+        return;
+    }
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->cancelled.store(true, std::memory_order_relaxed);
+        task = std::move(state_->task);
+    }
+}
+
+bool TaskHandle::IsCancelled() const {
+    return state_ && state_->cancelled.load(std::memory_order_relaxed);
+}
+
+ThreadManager::ThreadManager()
+    : threads_(std::make_shared<const ThreadList>()),
+      hooks_(std::make_shared<const HookList>()) {}
+
+ThreadManager::~ThreadManager() {}
+
 ThreadManager* ThreadManager::Instance() {
     static ThreadManager* const instance = new ThreadManager();
     return instance;
 }
 
 Thread* ThreadManager::CurrentThread() {
-    Thread* current_thread =
-        static_cast<Thread*>(pthread_getspecific(thread_key_));
-    CHECK(current_thread != nullptr);
     return current_thread;
 }
 
 void ThreadManager::SetCurrentThread(Thread* thread) {
-    pthread_setspecific(thread_key_, thread);
+    current_thread = thread;
+}
+
+/**
+ * 注册线程，Thread构造时自动调用
+ * @param thread 线程
+ */
+void ThreadManager::Add(Thread* thread) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto threads = std::make_shared<ThreadList>(*threads_);
+    threads->push_back(std::make_shared<Entry>(thread));
+    Publish(std::move(threads));
+}
+
+/**
+ * 删除线程，Thread析构时自动调用
+ * 返回前等待正在回调中访问这个线程的枚举结束，之后开始的枚举会跳过它；
+ * 不能在访问这个线程的ForEachThread()回调中调用
+ * @param thread 线程
+ */
+void ThreadManager::Remove(Thread* thread) {
+    for (EnumerationFrame* frame = current_enumeration; frame != nullptr;
+         frame = frame->outer) {
+        CHECK(frame->thread != thread)
+            << "Thread destroyed while ForEachThread() is visiting it";
+    }
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto threads = std::make_shared<ThreadList>(*threads_);
+        auto it = std::find_if(threads->begin(), threads->end(),
+                               [thread](const std::shared_ptr<Entry>& entry) {
+                                   return entry->thread == thread;
+                               });
+        if (it == threads->end()) {
+            return;
+        }
+        entry = *it;
+        threads->erase(it);
+        Publish(std::move(threads));
+    }
+    // 和ForEachThread()中先增加visitors再检查removed的顺序配合，
+    // 枚举要么看到删除标记，要么在这里被看到并等待
+    entry->removed.store(true);
+    while (entry->visitors.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * 替换当前快照，调用方持有mutex_
+ */
+void ThreadManager::Publish(std::shared_ptr<const ThreadList> threads) {
+    std::atomic_store_explicit(&threads_, std::move(threads),
+                               std::memory_order_release);
+}
+
+/**
+ * 对每个已注册的线程调用func，不阻塞线程的创建和销毁
+ * 枚举开始后删除的线程不再回调
+ * @param func 回调，其中可以创建和析构其他Thread，不能析构正在访问的Thread
+ */
+void ThreadManager::ForEachThread(const std::function<void(Thread*)>& func) {
+    // 回调抛出异常时也要撤销访问计数
+    struct Visit {
+        Visit(Entry* entry) : entry(entry) {
+            entry->visitors.fetch_add(1);
+            frame = {entry->thread, current_enumeration};
+        }
+        ~Visit() {
+            current_enumeration = frame.outer;
+            entry->visitors.fetch_sub(1, std::memory_order_release);
+        }
+
+        Entry* entry;
+        EnumerationFrame frame;
+    };
+
+    std::shared_ptr<const ThreadList> threads =
+        std::atomic_load_explicit(&threads_, std::memory_order_acquire);
+    for (const std::shared_ptr<Entry>& entry : *threads) {
+        Visit visit(entry.get());
+        if (entry->removed.load()) {
+            continue;
+        }
+        current_enumeration = &visit.frame;
+        func(entry->thread);
+    }
+}
+
+size_t ThreadManager::GetThreadCount() {
+    return std::atomic_load_explicit(&threads_, std::memory_order_acquire)
+        ->size();
+}
+
+/**
+ * 停止所有已注册的线程，不等待它们退出
+ * @param mode 如何处理队列中的任务
+ */
+void ThreadManager::StopAll(Thread::StopMode mode) {
+    ForEachThread([mode](Thread* thread) { thread->Stop(mode); });
+}
+
+/**
+ * 添加生命周期回调
+ * @param hooks 回调，可以只设置其中一个
+ * @return 回调ID，用于RemoveHooks()
+ */
+int ThreadManager::AddHooks(ThreadHooks hooks) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto list = std::make_shared<HookList>(*hooks_);
+    int id = next_hook_id_++;
+    list->emplace_back(id, std::move(hooks));
+    std::atomic_store_explicit(&hooks_, std::shared_ptr<const HookList>(list),
+                               std::memory_order_release);
+    return id;
+}
+
+/**
+ * 删除生命周期回调，正在执行的回调不受影响
+ * @param id AddHooks()返回的ID
+ */
+void ThreadManager::RemoveHooks(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto list = std::make_shared<HookList>(*hooks_);
+    list->erase(std::remove_if(list->begin(), list->end(),
+                               [id](const std::pair<int, ThreadHooks>& hook) {
+                                   return hook.first == id;
+                               }),
+                list->end());
+    std::atomic_store_explicit(&hooks_, std::shared_ptr<const HookList>(list),
+                               std::memory_order_release);
+}
+
+void ThreadManager::OnThreadStart(Thread* thread) {
+    auto hooks = std::atomic_load_explicit(&hooks_, std::memory_order_acquire);
+    for (const auto& hook : *hooks) {
+        if (hook.second.on_start) {
+            hook.second.on_start(thread);
+        }
+    }
+}
+
+void ThreadManager::OnThreadExit(Thread* thread) {
+    auto hooks = std::atomic_load_explicit(&hooks_, std::memory_order_acquire);
+    for (const auto& hook : *hooks) {
+        if (hook.second.on_exit) {
+            hook.second.on_exit(thread);
+        }
+    }
+}
+
+/**
+ * 为每个可用的物理核规划一个反应器线程，超线程的兄弟CPU只取一个
+ * 每个反应器绑定到一个CPU，并优先从该CPU所在的NUMA节点分配内存，
+ * 反应器的事件循环和对象池应当在它自己的线程中创建
+ * @param policy 放置策略
+ * @return 每个反应器的线程参数，用于创建Thread或ThreadPool
+ */
+std::vector<ThreadOptions> ThreadManager::PlanReactors(
+    const ReactorPolicy& policy) {
+    auto core_of = [](int cpu) {
+        std::vector<int> siblings =
+            ReadCpuList("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                        "/topology/thread_siblings_list");
+        return siblings.empty() ? cpu : siblings.front();
+    };
+    std::set<int> used_cores;
+    for (int cpu : policy.exclude_cpus) {
+        used_cores.insert(core_of(cpu));
+    }
+
+    std::vector<ThreadOptions> plans;
+    for (int cpu : GetAllowedCpus()) {
+        if (policy.max_reactors > 0 && plans.size() >= policy.max_reactors) {
+            break;
+        }
+        if (!used_cores.insert(core_of(cpu)).second) {
+            continue;
+        }
+        ThreadOptions options;
+        options.name = policy.name_prefix + "-" + std::to_string(cpu);
+        options.cpus = {cpu};
+        options.numa_node = GetNumaNode(cpu);
+        options.sched_policy = policy.sched_policy;
+        options.sched_priority = policy.sched_priority;
+        plans.push_back(options);
+    }
+    return plans;
+}
+
+/**
+ * 进程可以使用的CPU，受taskset和cgroup cpuset限制
+ */
+std::vector<int> ThreadManager::GetAllowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        LOG(WARNING) << "Failed to get cpu affinity, " << strerror(errno);
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/**
+ * CPU所在的NUMA节点
+ * @return 节点编号，没有NUMA信息时返回-1
+ */
+int ThreadManager::GetNumaNode(int cpu) {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return -1;
+    }
+    int node = -1;
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "node", 4) == 0 &&
+            isdigit(entry->d_name[4])) {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
 }
 
 }  // namespace avrtc
\ No newline at end of file
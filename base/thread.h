@@ -3,52 +3,352 @@
 
 #include <glog/logging.h>
 #include <pthread.h>
+#include <sched.h>
 
-#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <exception>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "base/location.h"
+#include "base/mpsc_queue.h"
+#include "base/task.h"
+#include "base/thread_metrics.h"
+
 namespace avrtc {
 
+class ThreadPool;
+
+/**
+ * 在futex上睡眠，*address不等于expected时立即返回
+ * @param timeout_ns 最长睡眠时间，负数表示不限
+ */
+void FutexWait(std::atomic<uint32_t>* address, uint32_t expected,
+               int64_t timeout_ns = -1);
+void FutexWake(std::atomic<uint32_t>* address);
+
+/**
+ * 延迟任务和周期任务的取消句柄，可以拷贝，可以在任意线程中取消
+ * 取消时立即在调用线程中释放任务的闭包，O(1)；
+ * 堆中剩下的空条目在原定的到期时间移除
+ */
+class TaskHandle {
+ public:
+  TaskHandle() = default;
+
+  void Cancel();
+  bool IsCancelled() const;
+
+ private:
+  friend class Thread;
+
+  // 延迟任务和取消句柄共享的状态
+  struct State {
+    std::atomic<bool> cancelled{false};
+    // 保护task；任务执行期间被移出，由执行的线程持有
+    std::mutex mutex;
+    Task task;
+  };
+
+  explicit TaskHandle(std::shared_ptr<State> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<State> state_;
+};
+
+/**
+ * 线程的创建参数，默认值和pthread默认属性相同
+ * 调度策略、绑核和内存节点在线程启动后由线程自己设置，失败时只打印警告，
+ * 例如没有CAP_SYS_NICE时SCHED_FIFO会失败，线程仍然以普通优先级运行
+ */
+struct ThreadOptions {
+  // 线程名，显示在top、perf中，超过15个字符的部分被截掉
+  std::string name;
+  // 允许运行的CPU，为空时不限制；指定了numa_node时默认为该节点的CPU
+  std::vector<int> cpus;
+  // SCHED_OTHER、SCHED_FIFO或SCHED_RR
+  int sched_policy = SCHED_OTHER;
+  // SCHED_FIFO和SCHED_RR的优先级，1到99
+  int sched_priority = 0;
+  // 栈大小，0表示默认
+  size_t stack_size = 0;
+  // 优先从这个NUMA节点分配内存，-1表示不限制
+  int numa_node = -1;
+  // 统计任务的等待时间、执行时间和睡眠时间，每个任务多读两次时钟
+  bool enable_metrics = true;
+  // 执行时间超过这个值的任务计为慢任务并打印投递位置，0表示不检查
+  // 默认不检查：反应器等长期运行的循环任务要在其中调用MarkCurrentTaskAsLoop()
+  int64_t long_task_threshold_ms = 0;
+  // 低优先级类别有任务时，最多连续执行多少个更高优先级的任务
+  int starvation_limit = 32;
+  // 距离截止时间不到这个值的任务优先于更高优先级类别执行
+  int64_t deadline_slack_us = 1000;
+};
+
+/**
+ * 单消费者的工作线程，任务按投递顺序在线程中依次执行
+ * 任务队列是无锁MPSC队列，投递只需要几次原子操作；
+ * 任务分为实时、普通、后台三个优先级类别，高类别优先执行，
+ * 截止时间将到的任务和被连续插队过多的低类别任务会提前执行；
+ * 任务只移动不拷贝，捕获较小的lambda投递时不分配内存；
+ * 线程没有任务时在futex上睡眠，只有它睡眠时投递方才需要系统调用唤醒
+ * 延迟任务和周期任务放在本线程的最小堆中，睡眠时以最早的到期时间为超时，
+ * 时间取自单调时钟，不受系统时间调整影响
+ * Stop()唤醒线程，当前任务结束后退出；停止后投递的任务直接析构，不再入队；
+ * 线程退出时析构队列中剩下的任务和所有延迟任务；析构时停止并等待线程退出
+ * 每个线程统计自己的队列深度、等待和执行时间分布、忙闲比例和慢任务数，
+ * 计数器只由本线程写入，GetStats()无锁读取
+ */
 class Thread {
   static const int kForever = -1;
 
  public:
+  // 停止时如何处理队列中还没执行的任务，延迟任务总是丢弃
+  // kDiscardPending在Stop()时就不再接受新任务，kDrainPending排空队列之后才不接受
+  enum class StopMode { kDiscardPending, kDrainPending };
+
   Thread();
   Thread(std::shared_ptr<void> thread_local_data);
+  explicit Thread(const ThreadOptions& options);
   ~Thread();
   void Join();
-  void AddTask(const std::function<void()>& task);
-  void Stop();
+  void AddTask(Task&& task, const Location& from = Location::Current());
+  void PostTask(TaskPriority priority, Task&& task,
+                const Location& from = Location::Current());
+  void PostTaskWithDeadline(TaskPriority priority, int64_t deadline_ms,
+                            Task&& task,
+                            const Location& from = Location::Current());
+  TaskHandle PostDelayedTask(int64_t delay_ms, Task&& task,
+                             const Location& from = Location::Current());
+  TaskHandle PostRepeatingTask(int64_t period_ms, Task&& task,
+                               const Location& from = Location::Current());
+  void Stop(StopMode mode = StopMode::kDiscardPending);
+  bool IsCurrent() const;
+  ThreadStats GetStats() const;
+
+  // 在长期运行的循环任务（线程池工作循环、事件循环、解复用循环）中调用，
+  // 这个任务不计入执行时间和慢任务，循环内部的任务和睡眠各自统计
+  static void MarkCurrentTaskAsLoop();
+
+  /**
+   * 在本线程中异步执行func
+   * @param func 可调用对象，返回值通过future取得
+   * @param from 投递位置，默认为调用方
+   * @return func的返回值或抛出的异常；线程已经停止或在执行前停止时，
+   *         future抛出std::future_error(broken_promise)
+   */
+  template <typename F, typename R = std::invoke_result_t<std::decay_t<F>&>>
+  std::future<R> InvokeAsync(F&& func,
+                             const Location& from = Location::Current()) {
+    std::promise<R> promise;
+    std::future<R> future = promise.get_future();
+    AddTask(
+        [func = std::forward<F>(func), promise = std::move(promise)]() mutable {
+          Fulfill(&promise, &func);
+        },
+        from);
+    return future;
+  }
+
+  /**
+   * 在本线程中执行func并等待返回，用于跨线程查询状态，
+   * 例如在其他线程中读取反应器的统计数据，不需要额外加锁
+   * 在本线程中调用时直接执行，不会死锁
+   * @param func 可调用对象
+   * @param from 投递位置，默认为调用方
+   * @return func的返回值
+   */
+  template <typename F, typename R = std::invoke_result_t<std::decay_t<F>&>>
+  R BlockingInvoke(F&& func, const Location& from = Location::Current()) {
+    if (IsCurrent()) {
+      return func();
+    }
+    return InvokeAsync(std::forward<F>(func), from).get();
+  }
 
  private:
+  // 线程池的工作线程直接读取任务队列并复用parked_睡眠
+  friend class ThreadPool;
+
+  struct DelayedTask {
+    int64_t deadline_ns = 0;
+    // 到期时间相同的任务按投递顺序执行
+    uint64_t sequence = 0;
+    // 0表示只执行一次
+    int64_t period_ns = 0;
+    std::shared_ptr<TaskHandle::State> state;
+    Location from;
+  };
+
+  struct QueuedTask {
+    Task task;
+    // 投递时间，关闭统计时为0
+    int64_t posted_ns = 0;
+    // 最晚开始执行的时间，0表示没有截止时间
+    int64_t deadline_ns = 0;
+    TaskPriority priority = TaskPriority::kNormal;
+    Location from;
+  };
+
+  template <typename R, typename F>
+  static void Fulfill(std::promise<R>* promise, F* func) {
+    try {
+      promise->set_value((*func)());
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  }
+
+  template <typename F>
+  static void Fulfill(std::promise<void>* promise, F* func) {
+    try {
+      (*func)();
+      promise->set_value();
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  }
+
   static void* PreRun(void* pv);
+  void ApplyOptions();
   void Run();
+  void Enqueue(QueuedTask&& queued);
+  bool PopNextTask(QueuedTask* queued);
+  void RunQueuedTask(QueuedTask* queued);
+  bool BeginPost();
+  void EndPost();
+  void StopAccepting();
+  void DrainPendingTasks();
+  void DiscardPendingTasks();
+  int64_t RunTask(Task* task, int64_t ready_ns, const Location& from);
+  int64_t RunDueTasks();
+  bool HasPendingTasks();
+  void Park(int64_t timeout_ns);
+  void Wakeup();
+  TaskHandle PostDelayed(int64_t delay_ns, int64_t period_ns, Task&& task,
+                         const Location& from);
   pthread_t thread_;
 
-  std::mutex mutex_;
-  std::condition_variable cond_var_;
-  std::vector<std::function<void()>> tasks_;
+  // 每个优先级类别一个队列，类别内先进先出
+  MpscQueue<QueuedTask> tasks_[kTaskPriorityCount];
+  // 各类别有任务时被更高类别连续插队的次数，只由本线程访问
+  int skipped_[kTaskPriorityCount] = {};
+  // 其他线程投递的延迟任务，由本线程移入delayed_tasks_
+  MpscQueue<DelayedTask> incoming_delayed_;
+  std::atomic<uint64_t> delayed_sequence_{0};
+  // 按到期时间排列的最小堆，只由本线程访问
+  std::vector<DelayedTask> delayed_tasks_;
+  // 线程准备睡眠时置1，投递方看到1才需要futex唤醒
+  std::atomic<uint32_t> parked_{0};
 
-  bool running_ = true;
+  std::atomic<bool> running_{true};
+  std::atomic<StopMode> stop_mode_{StopMode::kDiscardPending};
+  // 是否接受新任务，停止后清除
+  std::atomic<bool> accepting_{true};
+  // 正在入队的投递方数，线程退出时等它们入队完成后再清空队列
+  std::atomic<int> posting_{0};
+  std::atomic<bool> joined_{false};
   std::shared_ptr<void> thread_local_data_;
+  ThreadOptions options_;
+  ThreadMetrics metrics_;
+  // 上一个任务的结束时间，线程睡眠或执行其他工作后清零
+  int64_t last_task_end_ns_ = 0;
+  // 正在执行的任务调用了MarkCurrentTaskAsLoop()
+  bool in_loop_task_ = false;
 };
 
+/**
+ * 线程注册表，Thread在构造时注册，析构时自动删除，
+ * 可以随时创建和销毁（例如每个房间一个工作线程）
+ * 注册表是写时复制的快照：枚举时用std::atomic_load取得当前快照的引用，
+ * 增删时复制出新快照替换；枚举和增删不互斥，但shared_ptr的原子操作本身不是无锁的，
+ * libstdc++中按地址哈希到一组全局互斥锁上，临界区只有一次引用计数操作
+ * 每一项记录正在回调中访问它的枚举数，删除时先标记该项，再只等待这些枚举，
+ * 枚举跳过已经标记删除的项，因此回调中的Thread在回调返回前不会析构，
+ * 其他项上阻塞的回调（例如用BlockingInvoke()收集统计）也不会拖住删除
+ * 回调中可以创建和析构其他Thread，但不能析构、也不能阻塞等待别人析构正在访问的Thread
+ * CurrentThread()读取thread_local变量，不加锁也不检查
+ */
 class ThreadManager {
  public:
+  /**
+   * 线程生命周期回调，都在该线程中执行，
+   * 添加回调之前已经启动的线程不会再调用on_start
+   */
+  struct ThreadHooks {
+    // 应用完线程参数之后、执行第一个任务之前
+    std::function<void(Thread*)> on_start;
+    // 任务循环退出之后
+    std::function<void(Thread*)> on_exit;
+  };
+
+  /**
+   * 每个物理核一个反应器线程的放置策略
+   */
+  struct ReactorPolicy {
+    // 最多创建的反应器数，0表示每个可用的物理核一个
+    size_t max_reactors = 0;
+    // 不放置反应器的CPU，例如留给GTK主循环
+    std::vector<int> exclude_cpus;
+    std::string name_prefix = "reactor";
+    int sched_policy = SCHED_OTHER;
+    int sched_priority = 0;
+  };
+
   static ThreadManager* Instance();
-  Thread* CurrentThread();
-  void SetCurrentThread(Thread* thread);
+  // 不在Thread中时返回nullptr
+  static Thread* CurrentThread();
+  static void SetCurrentThread(Thread* thread);
+
   void Add(Thread* thread);
+  void Remove(Thread* thread);
+  void ForEachThread(const std::function<void(Thread*)>& func);
+  size_t GetThreadCount();
+  void StopAll(Thread::StopMode mode = Thread::StopMode::kDiscardPending);
+
+  int AddHooks(ThreadHooks hooks);
+  void RemoveHooks(int id);
+
+  std::vector<ThreadOptions> PlanReactors(const ReactorPolicy& policy);
+
+  static std::vector<int> GetAllowedCpus();
+  static int GetNumaNode(int cpu);
 
  private:
+  friend class Thread;
+
+  // 注册表中的一项，删除后旧快照可能仍然引用它
+  struct Entry {
+    explicit Entry(Thread* thread) : thread(thread) {}
+
+    Thread* const thread;
+    // 正在回调中访问这个线程的枚举数
+    std::atomic<int> visitors{0};
+    std::atomic<bool> removed{false};
+  };
+
+  using ThreadList = std::vector<std::shared_ptr<Entry>>;
+  using HookList = std::vector<std::pair<int, ThreadHooks>>;
+
   ThreadManager();
   ~ThreadManager();
 
-  std::vector<Thread*> threads_;
-  pthread_key_t thread_key_;
+  void OnThreadStart(Thread* thread);
+  void OnThreadExit(Thread* thread);
+  void Publish(std::shared_ptr<const ThreadList> threads);
+
+  // 当前快照，读取和替换都通过std::atomic_load/atomic_store
+  std::shared_ptr<const ThreadList> threads_;
+  std::shared_ptr<const HookList> hooks_;
+  int next_hook_id_ = 1;
+  // 只保护写入方之间的互斥
   std::mutex mutex_;
 };
 
@@ -0,0 +1,128 @@
+#include "base/thread_metrics.h"
+
+#include <algorithm>
+
+namespace avrtc {
+
+uint64_t LatencyHistogram::Snapshot::GetTotal() const {
+    uint64_t total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+/**
+ * 分位数的估计值
+ * @param percentile 0到100
+ * @return 分位数所在桶的上界，单位微秒，没有样本时返回0
+ */
+int64_t LatencyHistogram::Snapshot::GetPercentileUs(double percentile) const {
+    uint64_t total = GetTotal();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(total * percentile / 100.0);
+    rank = std::min(std::max<uint64_t>(rank, 1), total);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return GetBucketUpperUs(i);
+        }
+    }
+    return GetBucketUpperUs(kBuckets - 1);
+}
+
+void LatencyHistogram::Record(int64_t ns) {
+    std::atomic<uint64_t>& count = counts_[GetBucket(ns)];
+    count.store(count.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const {
+    Snapshot snapshot;
+    for (int i = 0; i < kBuckets; ++i) {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+int LatencyHistogram::GetBucket(int64_t ns) {
+    uint64_t us = ns > 0 ? static_cast<uint64_t>(ns) / 1000 : 0;
+    if (us == 0) {
+        return 0;
+    }
+    return std::min(64 - __builtin_clzll(us), kBuckets - 1);
+}
+
+int64_t LatencyHistogram::GetBucketUpperUs(int bucket) {
+    return int64_t(1) << bucket;
+}
+
+/**
+ * 从队列中取出一个任务，只能在所属线程中调用
+ * @param priority 任务的优先级类别
+ * @param deadline_missed 开始执行时是否已经过了截止时间
+ */
+void ThreadMetrics::OnDequeued(TaskPriority priority, bool deadline_missed) {
+    ClassCounters& counters = Get(priority);
+    Increment<uint64_t>(&counters.tasks_run, 1);
+    if (deadline_missed) {
+        Increment<uint64_t>(&counters.deadline_misses, 1);
+    }
+}
+
+/**
+ * 记录一个任务的等待时间和执行时间，只能在所属线程中调用
+ */
+void ThreadMetrics::OnTaskTimed(int64_t queue_ns, int64_t run_ns,
+                                bool long_task) {
+    queue_latency_.Record(queue_ns);
+    run_time_.Record(run_ns);
+    Increment(&busy_ns_, run_ns);
+    if (long_task) {
+        Increment<uint64_t>(&long_tasks_, 1);
+    }
+}
+
+/**
+ * 统计快照，可以在任意线程中调用
+ */
+ThreadStats ThreadMetrics::GetStats() const {
+    ThreadStats stats;
+    for (int i = 0; i < kTaskPriorityCount; ++i) {
+        const ClassCounters& counters = classes_[i];
+        TaskClassStats& class_stats = stats.classes[i];
+        // 先读执行数再读投递数，避免算出负的队列深度
+        class_stats.tasks_run =
+            counters.tasks_run.load(std::memory_order_relaxed);
+        class_stats.tasks_discarded =
+            counters.tasks_discarded.load(std::memory_order_relaxed);
+        class_stats.tasks_posted =
+            counters.tasks_posted.load(std::memory_order_relaxed);
+        uint64_t dequeued = class_stats.tasks_run + class_stats.tasks_discarded;
+        class_stats.queue_depth =
+            class_stats.tasks_posted > dequeued
+                ? class_stats.tasks_posted - dequeued
+                : 0;
+        class_stats.deadline_misses =
+            counters.deadline_misses.load(std::memory_order_relaxed);
+        class_stats.queue_latency = counters.queue_latency.GetSnapshot();
+        stats.tasks_run += class_stats.tasks_run;
+        stats.tasks_discarded += class_stats.tasks_discarded;
+        stats.tasks_posted += class_stats.tasks_posted;
+        stats.queue_depth += class_stats.queue_depth;
+    }
+    stats.long_tasks = long_tasks_.load(std::memory_order_relaxed);
+    stats.busy_ns = busy_ns_.load(std::memory_order_relaxed);
+    stats.idle_ns = idle_ns_.load(std::memory_order_relaxed);
+    int64_t total_ns = stats.busy_ns + stats.idle_ns;
+    stats.busy_ratio =
+        total_ns > 0 ? static_cast<double>(stats.busy_ns) / total_ns : 0;
+    stats.queue_latency = queue_latency_.GetSnapshot();
+    stats.run_time = run_time_.GetSnapshot();
+    return stats;
+}
+
+}  // namespace avrtc
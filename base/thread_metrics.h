@@ -0,0 +1,131 @@
+#ifndef BASE_THREAD_METRICS_H
+#define BASE_THREAD_METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "base/task.h"
+
+namespace avrtc {
+
+/**
+ * 按2的幂分桶的耗时直方图，第0个桶是1微秒以内，
+ * 第i个桶是[2^(i-1), 2^i)微秒，最后一个桶不设上限
+ * 只能由一个线程写入，任意线程无锁读取，读到的各桶计数不保证是同一时刻的
+ */
+class LatencyHistogram {
+ public:
+  static const int kBuckets = 24;
+
+  struct Snapshot {
+    uint64_t counts[kBuckets] = {};
+
+    uint64_t GetTotal() const;
+    int64_t GetPercentileUs(double percentile) const;
+  };
+
+  void Record(int64_t ns);
+  Snapshot GetSnapshot() const;
+
+  static int GetBucket(int64_t ns);
+  static int64_t GetBucketUpperUs(int bucket);
+
+ private:
+  std::atomic<uint64_t> counts_[kBuckets] = {};
+};
+
+/**
+ * 一个优先级类别的队列统计
+ */
+struct TaskClassStats {
+  uint64_t tasks_posted = 0;
+  uint64_t tasks_run = 0;
+  // 线程停止时丢弃、没有执行的任务数
+  uint64_t tasks_discarded = 0;
+  size_t queue_depth = 0;
+  // 开始执行时已经过了截止时间的任务数
+  uint64_t deadline_misses = 0;
+  LatencyHistogram::Snapshot queue_latency;
+};
+
+/**
+ * 线程负载统计的快照
+ */
+struct ThreadStats {
+  // 立即执行的任务，不含延迟任务
+  uint64_t tasks_posted = 0;
+  uint64_t tasks_run = 0;
+  // 线程停止时丢弃、没有执行的任务数
+  uint64_t tasks_discarded = 0;
+  // 已投递还没开始执行的任务数，不含延迟任务
+  size_t queue_depth = 0;
+  // 执行时间超过阈值的任务数
+  uint64_t long_tasks = 0;
+  int64_t busy_ns = 0;
+  int64_t idle_ns = 0;
+  // 执行任务的时间占执行和睡眠总时间的比例
+  double busy_ratio = 0;
+  // 从投递（延迟任务从到期）到开始执行的等待时间
+  LatencyHistogram::Snapshot queue_latency;
+  LatencyHistogram::Snapshot run_time;
+  // 按TaskPriority下标
+  TaskClassStats classes[kTaskPriorityCount];
+};
+
+/**
+ * 一个线程的任务队列计数器，计数器属于这个线程，只有投递计数由其他线程写入
+ * 线程自己写入时不需要原子的读改写，GetStats()在任意线程中无锁读取
+ */
+class ThreadMetrics {
+ public:
+  // 投递和取出只统计立即执行的任务，用于计算队列深度
+  void OnPosted(TaskPriority priority) {
+    Get(priority).tasks_posted.fetch_add(1, std::memory_order_relaxed);
+  }
+  void OnDequeued(TaskPriority priority, bool deadline_missed);
+  void OnDiscarded(TaskPriority priority) {
+    Increment<uint64_t>(&Get(priority).tasks_discarded, 1);
+  }
+  void OnQueueLatency(TaskPriority priority, int64_t queue_ns) {
+    Get(priority).queue_latency.Record(queue_ns);
+  }
+  void OnTaskTimed(int64_t queue_ns, int64_t run_ns, bool long_task);
+  void OnIdle(int64_t idle_ns) { Increment(&idle_ns_, idle_ns); }
+  // 不经过任务队列执行的工作，例如线程池的任务，只计入忙碌时间
+  void OnBusy(int64_t busy_ns) { Increment(&busy_ns_, busy_ns); }
+
+  ThreadStats GetStats() const;
+
+ private:
+  template <typename T>
+  static void Increment(std::atomic<T>* counter, T amount) {
+    counter->store(counter->load(std::memory_order_relaxed) + amount,
+                   std::memory_order_relaxed);
+  }
+
+  struct ClassCounters {
+    std::atomic<uint64_t> tasks_posted{0};
+    // 以下只由所属线程写入
+    alignas(64) std::atomic<uint64_t> tasks_run{0};
+    std::atomic<uint64_t> deadline_misses{0};
+    std::atomic<uint64_t> tasks_discarded{0};
+    LatencyHistogram queue_latency;
+  };
+
+  ClassCounters& Get(TaskPriority priority) {
+    return classes_[static_cast<int>(priority)];
+  }
+
+  ClassCounters classes_[kTaskPriorityCount];
+  // 以下只由所属线程写入
+  alignas(64) std::atomic<uint64_t> long_tasks_{0};
+  std::atomic<int64_t> busy_ns_{0};
+  std::atomic<int64_t> idle_ns_{0};
+  LatencyHistogram queue_latency_;
+  LatencyHistogram run_time_;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_THREAD_METRICS_H
@@ -0,0 +1,342 @@
+#include "base/thread_pool.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "base/event_loop.h"
+
+namespace avrtc {
+
+// 当前线程所属的线程池和工作线程序号，非工作线程为nullptr
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+namespace {
+
+/**
+ * ParallelFor()的共享状态，调用方和辅助任务按块领取下标区间
+ * 辅助任务可能在ParallelFor()返回之后才开始执行，因此用shared_ptr持有，
+ * 它们只在领到块之后才访问func
+ */
+struct ParallelForState {
+    const std::function<void(size_t)>* func = nullptr;
+    size_t begin = 0;
+    size_t end = 0;
+    size_t grain = 1;
+    size_t chunks = 0;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+
+    void RunChunks() {
+        size_t chunk;
+        while ((chunk = next.fetch_add(1, std::memory_order_relaxed)) <
+               chunks) {
+            size_t first = begin + chunk * grain;
+            size_t last = std::min(end, first + grain);
+            for (size_t i = first; i < last; ++i) {
+                (*func)(i);
+            }
+            done.fetch_add(1, std::memory_order_release);
+        }
+    }
+};
+
+}  // namespace
+
+/**
+ * 构造函数，创建并启动工作线程
+ * @param num_workers 工作线程数，0表示CPU核数，超过kMaxWorkers时取kMaxWorkers
+ */
+ThreadPool::ThreadPool(size_t num_workers)
+    : ThreadPool(std::vector<ThreadOptions>(
+          num_workers > 0 ? num_workers : GetDefaultWorkerCount())) {}
+
+/**
+ * 默认工作线程数：CPU核数，最多kMaxWorkers个
+ */
+size_t ThreadPool::GetDefaultWorkerCount() {
+    size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    return cpus < kMaxWorkers ? cpus : kMaxWorkers;
+}
+
+/**
+ * 构造函数，每个工作线程按对应的参数创建
+ * @param worker_options 每个工作线程的参数，个数即工作线程数
+ */
+ThreadPool::ThreadPool(const std::vector<ThreadOptions>& worker_options) {
+    size_t num_workers = worker_options.size();
+    CHECK_GT(num_workers, 0u);
+    CHECK_LE(num_workers, kMaxWorkers);
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers_.emplace_back(new Worker);
+        workers_[i]->random = static_cast<uint32_t>(i) * 2654435761u + 1;
+    }
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers_[i]->thread.reset(new Thread(worker_options[i]));
+        workers_[i]->thread->AddTask([this, i]() { WorkerLoop(i); });
+    }
+}
+
+/**
+ * 析构函数，停止并等待所有工作线程，还没执行的任务直接丢弃
+ */
+ThreadPool::~ThreadPool() {
+    stopping_.store(true, std::memory_order_release);
+    for (auto& worker : workers_) {
+        worker->thread->Stop();
+    }
+    for (auto& worker : workers_) {
+        worker->thread->Join();
+    }
+    Task* task = nullptr;
+    for (auto& worker : workers_) {
+        while (worker->deque.Pop(&task)) {
+            delete task;
+        }
+    }
+    for (Task* pending : inject_queue_) {
+        delete pending;
+    }
+}
+
+/**
+ * 当前线程所属的线程池
+ * @return 不在线程池的工作线程中时返回nullptr
+ */
+ThreadPool* ThreadPool::Current() {
+    return current_pool;
+}
+
+/**
+ * 投递任务，可以在任意线程中调用
+ * 在本线程池的工作线程中投递时放入本线程的队列，否则放入注入队列
+ * @param task 任务
+ */
+void ThreadPool::Post(Task&& task) {
+    Task* node = new Task(std::move(task));
+    if (current_pool == this) {
+        workers_[current_index]->deque.Push(node);
+    } else {
+        std::lock_guard<std::mutex> lock(inject_mutex_);
+        inject_queue_.push_back(node);
+        inject_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    WakeOne();
+}
+
+/**
+ * 对[begin, end)中的每个下标并行调用func，全部完成后返回
+ * 下标按grain个一块分配，调用线程同样领取并执行，
+ * 在工作线程中调用也不会因为等待其他任务而死锁
+ * @param begin 起始下标
+ * @param end 结束下标，不包含
+ * @param func 处理一个下标的函数，会在多个线程中同时调用
+ * @param grain 每块的下标个数
+ */
+void ThreadPool::ParallelFor(size_t begin, size_t end,
+                             const std::function<void(size_t)>& func,
+                             size_t grain) {
+    if (end <= begin) {
+        return;
+    }
+    auto state = std::make_shared<ParallelForState>();
+    state->func = &func;
+    state->begin = begin;
+    state->end = end;
+    state->grain = std::max<size_t>(grain, 1);
+    state->chunks = (end - begin + state->grain - 1) / state->grain;
+
+    size_t helpers = std::min(workers_.size(), state->chunks - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        Post([state]() { state->RunChunks(); });
+    }
+    state->RunChunks();
+    // 剩下的块都已经被其他线程领走，正在执行
+    while (state->done.load(std::memory_order_acquire) < state->chunks) {
+        std::this_thread::yield();
+    }
+}
+
+std::shared_ptr<Strand> ThreadPool::CreateStrand() {
+    return std::shared_ptr<Strand>(new Strand(this));
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    Thread::MarkCurrentTaskAsLoop();
+    current_pool = this;
+    current_index = index;
+    Worker* worker = workers_[index].get();
+    while (!stopping_.load(std::memory_order_acquire)) {
+        int64_t wait_ns = worker->thread->RunDueTasks();
+        Task* task = FindTask(index);
+        if (task != nullptr) {
+            RunPoolTask(worker, task);
+            continue;
+        }
+        if (RunThreadTasks(worker)) {
+            continue;
+        }
+        ParkWorker(index, wait_ns);
+    }
+    current_pool = nullptr;
+}
+
+/**
+ * 执行线程池的任务，开启统计时计入工作线程的忙碌时间
+ */
+void ThreadPool::RunPoolTask(Worker* worker, Task* task) {
+    Thread* thread = worker->thread.get();
+    if (thread->options_.enable_metrics) {
+        int64_t start_ns = EventLoop::NowNs();
+        (*task)();
+        thread->metrics_.OnBusy(EventLoop::NowNs() - start_ns);
+    } else {
+        (*task)();
+    }
+    delete task;
+}
+
+/**
+ * 依次尝试本线程队列、注入队列，再从其他工作线程窃取
+ * @return 任务，没有找到时返回nullptr
+ */
+Task* ThreadPool::FindTask(size_t index) {
+    Worker* worker = workers_[index].get();
+    Task* task = nullptr;
+    if (worker->deque.Pop(&task)) {
+        return task;
+    }
+    if (inject_size_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(inject_mutex_);
+        if (!inject_queue_.empty()) {
+            task = inject_queue_.front();
+            inject_queue_.pop_front();
+            inject_size_.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    // 从随机位置开始窃取，避免所有空闲线程都挤在同一个队列上
+    uint32_t random = worker->random;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    worker->random = random;
+    size_t count = workers_.size();
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (random + i) % count;
+        if (victim != index && workers_[victim]->deque.Steal(&task)) {
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * 执行直接投递给工作线程Thread的任务
+ * @return 是否执行了任务
+ */
+bool ThreadPool::RunThreadTasks(Worker* worker) {
+    bool ran = false;
+    worker->thread->last_task_end_ns_ = 0;
+    Thread::QueuedTask queued;
+    while (worker->thread->PopNextTask(&queued)) {
+        worker->thread->RunQueuedTask(&queued);
+        ran = true;
+    }
+    return ran;
+}
+
+bool ThreadPool::HasWork(size_t index) {
+    if (inject_size_.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+    for (auto& worker : workers_) {
+        if (!worker->deque.Empty()) {
+            return true;
+        }
+    }
+    return workers_[index]->thread->HasPendingTasks();
+}
+
+/**
+ * 没有任务时睡眠，先登记到idle_mask_再检查一次所有队列，
+ * 和投递方先入队再检查idle_mask_的顺序配合，保证不会错过唤醒
+ * 直接投递给工作线程Thread的任务通过Thread::Wakeup()唤醒同一个futex
+ * @param timeout_ns 工作线程Thread上下一个延迟任务的等待时间
+ */
+void ThreadPool::ParkWorker(size_t index, int64_t timeout_ns) {
+    if (timeout_ns == 0) {
+        return;
+    }
+    Thread* thread = workers_[index]->thread.get();
+    uint64_t bit = uint64_t(1) << index;
+    thread->parked_.store(1, std::memory_order_relaxed);
+    idle_mask_.fetch_or(bit, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!HasWork(index) && !stopping_.load(std::memory_order_acquire)) {
+        if (thread->options_.enable_metrics) {
+            int64_t start_ns = EventLoop::NowNs();
+            FutexWait(&thread->parked_, 1, timeout_ns);
+            thread->metrics_.OnIdle(EventLoop::NowNs() - start_ns);
+        } else {
+            FutexWait(&thread->parked_, 1, timeout_ns);
+        }
+    }
+    thread->parked_.store(0, std::memory_order_relaxed);
+    idle_mask_.fetch_and(~bit, std::memory_order_relaxed);
+}
+
+/**
+ * 唤醒一个睡眠中的工作线程，没有睡眠的线程时只有一次原子读
+ */
+void ThreadPool::WakeOne() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t mask = idle_mask_.load(std::memory_order_relaxed);
+    while (mask != 0) {
+        size_t index = __builtin_ctzll(mask);
+        if (idle_mask_.compare_exchange_weak(mask,
+                                             mask & ~(uint64_t(1) << index),
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_relaxed)) {
+            workers_[index]->thread->Wakeup();
+            return;
+        }
+    }
+}
+
+/**
+ * 投递任务，可以在任意线程中调用
+ * @param task 任务
+ */
+void Strand::Post(Task&& task) {
+    tasks_.Push(std::move(task));
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        auto self = shared_from_this();
+        pool_->Post([self]() { self->Drain(); });
+    }
+}
+
+/**
+ * 在线程池中依次执行任务，同一时刻只有一个Drain()在执行
+ */
+void Strand::Drain() {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        Task task;
+        // pending_计入的任务都已经写完，但队头的投递方可能还没写完
+        while (!tasks_.Pop(&task)) {
+            std::this_thread::yield();
+        }
+        task();
+        task.Reset();
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            return;
+        }
+    }
+    auto self = shared_from_this();
+    pool_->Post([self]() { self->Drain(); });
+}
+
+}  // namespace avrtc
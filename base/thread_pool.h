@@ -0,0 +1,110 @@
+#ifndef BASE_THREAD_POOL_H
+#define BASE_THREAD_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/mpsc_queue.h"
+#include "base/task.h"
+#include "base/thread.h"
+#include "base/work_stealing_deque.h"
+
+namespace avrtc {
+
+class Strand;
+
+/**
+ * 工作窃取线程池，用于解码、转码、FEC、SRTP等可以并行的媒体处理
+ * 每个工作线程有自己的Chase-Lev双端队列，工作线程中投递的任务放入本线程队列，
+ * 其他线程投递的任务放入全局注入队列；空闲的工作线程先取注入队列，
+ * 再从其他线程的队列顶部窃取，都没有任务时在futex上睡眠
+ * 工作线程是avrtc::Thread，任务中ThreadManager::CurrentThread()返回所在的工作线程，
+ * 向它AddTask()或PostDelayedTask()的任务同样在这个工作线程中执行
+ * 任务之间没有顺序保证，需要按顺序执行的任务（例如同一路流的包）投递到Strand
+ * 工作线程可以按ThreadOptions绑核，例如ThreadManager::PlanReactors()的结果
+ * 最多kMaxWorkers个工作线程，默认按CPU核数创建，核数更多时取kMaxWorkers
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t num_workers = 0);
+  explicit ThreadPool(const std::vector<ThreadOptions>& worker_options);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Post(Task&& task);
+  void ParallelFor(size_t begin, size_t end,
+                   const std::function<void(size_t)>& func, size_t grain = 1);
+  std::shared_ptr<Strand> CreateStrand();
+
+  size_t GetWorkerCount() const { return workers_.size(); }
+  uint64_t GetStealCount() const {
+    return steals_.load(std::memory_order_relaxed);
+  }
+
+  static ThreadPool* Current();
+  static size_t GetDefaultWorkerCount();
+
+  static const size_t kMaxWorkers = 64;
+
+ private:
+  struct Worker {
+    std::unique_ptr<Thread> thread;
+    WorkStealingDeque<Task*> deque;
+    uint32_t random = 0;
+  };
+
+  void WorkerLoop(size_t index);
+  Task* FindTask(size_t index);
+  void RunPoolTask(Worker* worker, Task* task);
+  bool RunThreadTasks(Worker* worker);
+  bool HasWork(size_t index);
+  void ParkWorker(size_t index, int64_t timeout_ns);
+  void WakeOne();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // 非工作线程投递的任务
+  std::mutex inject_mutex_;
+  std::deque<Task*> inject_queue_;
+  std::atomic<size_t> inject_size_{0};
+
+  // 睡眠中的工作线程，第i位对应workers_[i]
+  std::atomic<uint64_t> idle_mask_{0};
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> steals_{0};
+};
+
+/**
+ * 串行执行器，投递到同一个Strand的任务在线程池中按投递顺序依次执行，
+ * 不会并发，但不固定在某个工作线程上
+ * 有任务时只占用线程池中的一个任务，连续执行一批后重新投递，避免长期占住工作线程
+ * 必须在线程池销毁之前停止使用
+ */
+class Strand : public std::enable_shared_from_this<Strand> {
+ public:
+  void Post(Task&& task);
+
+ private:
+  friend class ThreadPool;
+  static const size_t kBatchSize = 64;
+
+  explicit Strand(ThreadPool* pool) : pool_(pool) {}
+  void Drain();
+
+  ThreadPool* pool_;
+  MpscQueue<Task> tasks_;
+  // 已入队还没执行完的任务数，从0变为1的投递方负责调度Drain()
+  std::atomic<size_t> pending_{0};
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_THREAD_POOL_H
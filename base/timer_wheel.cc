@@ -0,0 +1,204 @@
+#include "base/timer_wheel.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace avrtc {
+
+/**
+ * 构造函数
+ * @param slot_count 槽位数量，必须是2的幂，决定一圈覆盖多少tick
+ */
+TimerWheel::TimerWheel(size_t slot_count)
+    : slots_(slot_count, kNil),
+      occupied_((slot_count + 63) / 64, 0),
+      mask_(slot_count - 1) {
+    CHECK(slot_count > 0 && (slot_count & mask_) == 0)
+        << "slot_count must be a power of two";
+}
+
+/**
+ * 添加定时器
+ * @param delay_ticks 距离首次到期的tick数，0按1处理，即最早在下一个tick触发
+ * @param period_ticks 周期tick数，0表示一次性定时器
+ * @param cb 到期回调，可以在回调中添加或取消定时器
+ * @return 定时器ID，用于取消
+ */
+TimerWheel::TimerId TimerWheel::Add(uint64_t delay_ticks,
+                                    uint64_t period_ticks,
+                                    Callback cb) {
+    uint32_t index = AllocNode();
+    Node& node = nodes_[index];
+    node.cb = std::move(cb);
+    node.period = period_ticks;
+    Schedule(index, delay_ticks);
+    ++size_;
+    return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+}
+
+/**
+ * 取消定时器，对已经到期或已经取消的定时器调用是安全的
+ * @param id 定时器ID
+ * @return 是否取消了一个仍然有效的定时器
+ */
+bool TimerWheel::Cancel(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id & 0xFFFFFFFF) - 1;
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (id == kInvalidTimerId || index >= nodes_.size()) {
+        return false;
+    }
+    Node& node = nodes_[index];
+    if (node.generation != generation) {
+        return false;
+    }
+    switch (node.state) {
+        case State::kPending:
+            Unlink(index);
+            FreeNode(index);
+            return true;
+        case State::kFiring:
+            // 正在执行回调，等回调返回后再释放节点
+            node.state = State::kCancelled;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * 推进时间轮，依次处理经过的每个tick上到期的定时器
+ * @param ticks 推进的tick数
+ */
+void TimerWheel::Advance(uint64_t ticks) {
+    for (uint64_t i = 0; i < ticks; ++i) {
+        ++current_tick_;
+        uint32_t slot = current_tick_ & mask_;
+        if (slots_[slot] != kNil) {
+            ProcessSlot(slot);
+        }
+    }
+}
+
+/**
+ * 查找下一个非空槽位距离当前tick的tick数
+ * 槽位中的定时器可能还有剩余圈数，所以这只是下一次到期时间的下界，
+ * 足够用来设置事件循环的唤醒时间
+ * @return tick数，范围[1, slot_count]；没有定时器时返回-1
+ */
+int64_t TimerWheel::TicksUntilNextSlot() const {
+    if (size_ == 0) {
+        return -1;
+    }
+    uint64_t slot_count = mask_ + 1;
+    for (uint64_t distance = 1; distance <= slot_count;) {
+        uint64_t slot = (current_tick_ + distance) & mask_;
+        uint64_t word = occupied_[slot / 64] >> (slot % 64);
+        if (word != 0) {
+            return distance + __builtin_ctzll(word);
+        }
+        // 跳到下一个64位字的开头，槽位少于64个时跳到环的开头
+        distance += std::min(64 - slot % 64, slot_count - slot);
+    }
+    return -1;
+}
+
+uint32_t TimerWheel::AllocNode() {
+    if (free_head_ == kNil) {
+        nodes_.emplace_back();
+        return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+    uint32_t index = free_head_;
+    free_head_ = nodes_[index].next;
+    return index;
+}
+
+void TimerWheel::FreeNode(uint32_t index) {
+    Node& node = nodes_[index];
+    node.cb = nullptr;
+    node.state = State::kFree;
+    ++node.generation;
+    node.next = free_head_;
+    free_head_ = index;
+    --size_;
+}
+
+void TimerWheel::Schedule(uint32_t index, uint64_t delay_ticks) {
+    if (delay_ticks == 0) {
+        delay_ticks = 1;
+    }
+    Node& node = nodes_[index];
+    node.rounds = (delay_ticks - 1) / (mask_ + 1);
+    node.state = State::kPending;
+    Link(index, (current_tick_ + delay_ticks) & mask_);
+}
+
+void TimerWheel::Link(uint32_t index, uint32_t slot) {
+    Node& node = nodes_[index];
+    node.slot = slot;
+    node.prev = kNil;
+    node.next = slots_[slot];
+    if (node.next != kNil) {
+        nodes_[node.next].prev = index;
+    }
+    slots_[slot] = index;
+    occupied_[slot / 64] |= 1ULL << (slot % 64);
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+    Node& node = nodes_[index];
+    if (node.prev != kNil) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        slots_[node.slot] = node.next;
+    }
+    if (node.next != kNil) {
+        nodes_[node.next].prev = node.prev;
+    }
+    if (slots_[node.slot] == kNil) {
+        occupied_[node.slot / 64] &= ~(1ULL << (node.slot % 64));
+    }
+    node.prev = node.next = kNil;
+}
+
+/**
+ * 处理一个槽位：圈数为0的定时器到期，其余的圈数减一
+ * 先把到期节点全部摘下再执行回调，回调中修改时间轮不会影响遍历
+ */
+void TimerWheel::ProcessSlot(uint32_t slot) {
+    expired_.clear();
+    for (uint32_t index = slots_[slot]; index != kNil;) {
+        uint32_t next = nodes_[index].next;
+        if (nodes_[index].rounds == 0) {
+            Unlink(index);
+            nodes_[index].state = State::kFiring;
+            expired_.push_back(index);
+        } else {
+            --nodes_[index].rounds;
+        }
+        index = next;
+    }
+
+    for (size_t i = 0; i < expired_.size(); ++i) {
+        uint32_t index = expired_[i];
+        // 被同一批次中先执行的回调取消了
+        if (nodes_[index].state == State::kCancelled) {
+            FreeNode(index);
+            continue;
+        }
+        // 回调中添加定时器可能导致nodes_扩容，先把回调移出来
+        Callback cb = std::move(nodes_[index].cb);
+        cb();
+        Node& node = nodes_[index];
+        if (node.state == State::kFiring && node.period != 0) {
+            node.cb = std::move(cb);
+            Schedule(index, node.period);
+        } else {
+            FreeNode(index);
+        }
+    }
+    expired_.clear();
+}
+
+}  // namespace avrtc
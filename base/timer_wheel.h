@@ -0,0 +1,69 @@
+#ifndef BASE_TIMER_WHEEL_H
+#define BASE_TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace avrtc {
+
+/**
+ * 哈希时间轮，时间以tick为单位推进
+ * 每个槽位是一个侵入式双向链表，定时器按到期tick取模落入槽位，
+ * 超过一圈的定时器记录剩余圈数，添加和取消都是O(1)
+ * 非线程安全，所有调用必须在同一个线程中进行
+ */
+class TimerWheel {
+ public:
+  // 高32位是代数，低32位是节点下标加一，0表示无效
+  using TimerId = uint64_t;
+  using Callback = std::function<void()>;
+  static constexpr TimerId kInvalidTimerId = 0;
+
+  explicit TimerWheel(size_t slot_count = 1024);
+
+  TimerId Add(uint64_t delay_ticks, uint64_t period_ticks, Callback cb);
+  bool Cancel(TimerId id);
+  void Advance(uint64_t ticks);
+  int64_t TicksUntilNextSlot() const;
+
+  uint64_t CurrentTick() const { return current_tick_; }
+  size_t Size() const { return size_; }
+
+ private:
+  static constexpr uint32_t kNil = UINT32_MAX;
+
+  enum class State : uint8_t { kFree, kPending, kFiring, kCancelled };
+
+  struct Node {
+    Callback cb;
+    uint64_t period = 0;  // 0表示一次性定时器
+    uint64_t rounds = 0;  // 还需要经过几圈才到期
+    uint32_t slot = 0;
+    uint32_t prev = kNil;
+    uint32_t next = kNil;
+    uint32_t generation = 0;
+    State state = State::kFree;
+  };
+
+  uint32_t AllocNode();
+  void FreeNode(uint32_t index);
+  void Schedule(uint32_t index, uint64_t delay_ticks);
+  void Link(uint32_t index, uint32_t slot);
+  void Unlink(uint32_t index);
+  void ProcessSlot(uint32_t slot);
+
+  std::vector<Node> nodes_;
+  uint32_t free_head_ = kNil;
+  std::vector<uint32_t> slots_;     // 每个槽位链表的头节点
+  std::vector<uint64_t> occupied_;  // 非空槽位的位图，用于查找下一个到期槽位
+  std::vector<uint32_t> expired_;   // 处理槽位时暂存到期节点
+  uint64_t mask_;
+  uint64_t current_tick_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_TIMER_WHEEL_H
@@ -0,0 +1,148 @@
+#ifndef BASE_WORK_STEALING_DEQUE_H
+#define BASE_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace avrtc {
+
+/**
+ * Chase-Lev工作窃取双端队列
+ * 所有者线程在底部Push/Pop，后进先出，刚投递的任务数据还在缓存中；
+ * 其他线程从顶部Steal，先进先出，和所有者只在剩最后一个元素时竞争
+ * 环形数组写满时扩容为两倍，旧数组可能还在被窃取方读取，保留到队列销毁
+ * 元素必须可以平凡拷贝，通常存放指针
+ */
+template <typename T>
+class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "WorkStealingDeque element must be trivially copyable");
+
+ public:
+  explicit WorkStealingDeque(size_t capacity = 256) {
+    size_t power = 1;
+    while (power < capacity) {
+      power <<= 1;
+    }
+    array_.store(new Array(power), std::memory_order_relaxed);
+  }
+
+  ~WorkStealingDeque() { delete array_.load(std::memory_order_relaxed); }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  /**
+   * 在底部放入元素，只能在所有者线程中调用
+   */
+  void Push(T value) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Array* array = array_.load(std::memory_order_relaxed);
+    if (bottom - top > static_cast<int64_t>(array->capacity) - 1) {
+      array = Grow(array, bottom, top);
+    }
+    array->Put(bottom, value);
+    bottom_.store(bottom + 1, std::memory_order_release);
+  }
+
+  /**
+   * 从底部取出元素，只能在所有者线程中调用
+   * @return 是否取到
+   */
+  bool Pop(T* value) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+    *value = array->Get(bottom);
+    if (top == bottom) {
+      // 最后一个元素，和窃取方竞争
+      bool won = top_.compare_exchange_strong(top, top + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  /**
+   * 从顶部窃取元素，可以在任意线程中调用
+   * @return 是否取到，队列为空或者和其他线程竞争失败时返回false
+   */
+  bool Steal(T* value) {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return false;
+    }
+    Array* array = array_.load(std::memory_order_acquire);
+    T stolen = array->Get(top);
+    if (!top_.compare_exchange_strong(top, top + 1,
+                                      std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    *value = stolen;
+    return true;
+  }
+
+  /**
+   * 元素个数的近似值，可以在任意线程中调用
+   */
+  size_t Size() const {
+    int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_seq_cst);
+    return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+ private:
+  struct Array {
+    explicit Array(size_t cap)
+        : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+
+    T Get(int64_t index) const {
+      return slots[index & mask].load(std::memory_order_relaxed);
+    }
+    void Put(int64_t index, T value) {
+      slots[index & mask].store(value, std::memory_order_relaxed);
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+  Array* Grow(Array* array, int64_t bottom, int64_t top) {
+    Array* bigger = new Array(array->capacity * 2);
+    for (int64_t i = top; i < bottom; ++i) {
+      bigger->Put(i, array->Get(i));
+    }
+    retired_.emplace_back(array);
+    array_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  std::atomic<Array*> array_{nullptr};
+  // 扩容前的数组，只由所有者访问
+  std::vector<std::unique_ptr<Array>> retired_;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_WORK_STEALING_DEQUE_H
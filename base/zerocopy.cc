@@ -0,0 +1,113 @@
+#include "base/zerocopy.h"
+
+#include <errno.h>
+#include <glog/logging.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <string.h>
+
+namespace avrtc {
+
+/**
+ * 在socket上开启SO_ZEROCOPY，之后带MSG_ZEROCOPY的发送才会走零拷贝路径
+ * @param fd TCP或UDP socket
+ * @return 是否成功，内核或协议不支持时返回false
+ */
+bool ZeroCopyTracker::EnableOnSocket(int fd) {
+    int one = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+        LOG(WARNING) << "Failed to enable SO_ZEROCOPY, " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 记录一次成功的零拷贝发送，内核为它分配下一个序号
+ * @param buffers 这次发送引用的所有缓冲区，保留到完成通知到达
+ */
+void ZeroCopyTracker::OnSent(std::vector<SharedBuffer> buffers) {
+    PendingSend send;
+    send.buffers = std::move(buffers);
+    pending_.push_back(std::move(send));
+}
+
+/**
+ * 读取socket错误队列中的零拷贝完成通知，释放已经完成的发送引用的缓冲区
+ * 在事件循环收到EPOLLERR时调用，错误队列不读空会持续触发EPOLLERR
+ * @param fd socket
+ * @return 本次处理的完成通知数，读取失败返回-1
+ */
+int ZeroCopyTracker::ProcessErrorQueue(int fd) {
+    int notifications = 0;
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+                 CMSG_SPACE(sizeof(struct sockaddr_in6))];
+    for (;;) {
+        struct msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG(ERROR) << "Failed to read error queue, " << strerror(errno);
+            return -1;
+        }
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            bool is_recverr =
+                (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                (cmsg->cmsg_level == SOL_IPV6 &&
+                 cmsg->cmsg_type == IPV6_RECVERR);
+            if (!is_recverr) {
+                continue;
+            }
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0) {
+                continue;
+            }
+            // ee_info到ee_data是完成的序号区间（闭区间）
+            Complete(err.ee_info, err.ee_data,
+                     err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+            ++notifications;
+        }
+    }
+    return notifications;
+}
+
+/**
+ * 标记序号区间内的发送已经完成，从队头释放连续完成的发送
+ * 通知可能合并多个序号，也可能不按顺序到达
+ */
+void ZeroCopyTracker::Complete(uint32_t first, uint32_t last, bool copied) {
+    uint32_t count = last - first + 1;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index = first + i - first_seq_;
+        if (index < pending_.size() && !pending_[index].done) {
+            pending_[index].done = true;
+            ++completed_;
+        }
+    }
+    while (!pending_.empty() && pending_.front().done) {
+        pending_.pop_front();
+        ++first_seq_;
+    }
+
+    if (copied) {
+        copied_ += count;
+        ++consecutive_copied_;
+        if (consecutive_copied_ == kMaxCopiedCompletions) {
+            LOG(INFO) << "Kernel keeps copying zerocopy sends, fall back to "
+                         "regular sends";
+        }
+    } else {
+        consecutive_copied_ = 0;
+    }
+}
+
+}  // namespace avrtc
@@ -0,0 +1,67 @@
+#ifndef BASE_ZEROCOPY_H
+#define BASE_ZEROCOPY_H
+
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "base/buffer.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+namespace avrtc {
+
+/**
+ * MSG_ZEROCOPY发送的完成通知跟踪
+ * 零拷贝发送时内核直接引用用户内存，数据真正发出之前这块内存不能释放或修改
+ * 内核为每次成功的零拷贝发送调用分配一个递增的32位序号，
+ * 发送完成后通过socket错误队列通知一个序号区间；
+ * 每次发送引用的缓冲区保存到对应的通知到达后才释放
+ * 非线程安全，调用者负责和发送路径串行化
+ */
+class ZeroCopyTracker {
+ public:
+  // 内核文档给出的经验值：小于约10KB的发送，页面固定和通知的开销超过拷贝
+  static const size_t kDefaultThreshold = 16 * 1024;
+  // 连续这么多次完成通知都报告数据被内核拷贝（例如回环接口或网卡不支持）时，
+  // 零拷贝只会增加开销，停止使用
+  static const int kMaxCopiedCompletions = 32;
+
+  static bool EnableOnSocket(int fd);
+
+  void OnSent(std::vector<SharedBuffer> buffers);
+  int ProcessErrorQueue(int fd);
+
+  bool IsEffective() const {
+    return consecutive_copied_ < kMaxCopiedCompletions;
+  }
+  size_t GetPendingCount() const { return pending_.size(); }
+  uint64_t GetCompletedCount() const { return completed_; }
+  uint64_t GetCopiedCount() const { return copied_; }
+
+ private:
+  struct PendingSend {
+    std::vector<SharedBuffer> buffers;
+    bool done = false;
+  };
+
+  void Complete(uint32_t first, uint32_t last, bool copied);
+
+  std::deque<PendingSend> pending_;
+  uint32_t first_seq_ = 0;  // pending_.front()的序号
+  uint64_t completed_ = 0;
+  uint64_t copied_ = 0;
+  int consecutive_copied_ = 0;
+};
+
+}  // namespace avrtc
+
+#endif  // BASE_ZEROCOPY_H
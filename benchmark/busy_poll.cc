@@ -0,0 +1,137 @@
+// 比较阻塞等待和忙轮询两种事件循环模式下，媒体数据报从内核收到到转发出去的延迟
+// 用法：bench_busy_poll [包数] [发包间隔微秒] [反应器CPU，默认最后一个CPU]
+#include <base/event_loop.h>
+#include <base/socket.h>
+#include <glog/logging.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t kPayloadSize = 1200;
+const int kBatch = 16;
+
+int64_t RealtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct Result {
+    int64_t p50_ns = 0;
+    int64_t p99_ns = 0;
+    int64_t p999_ns = 0;
+    size_t samples = 0;
+    uint64_t idle_backoffs = 0;
+};
+
+/**
+ * 运行一种模式：反应器线程收包后立即转发，记录内核接收时间戳到转发完成的延迟
+ * @param options 事件循环的忙轮询配置
+ * @param packets 发送的包数
+ * @param interval_us 发包间隔
+ */
+Result RunMode(const avrtc::EventLoop::BusyPollOptions& options,
+               int packets,
+               int interval_us) {
+    avrtc::UdpSocket reactor(avrtc::SocketAddress("127.0.0.1", 0));
+    avrtc::UdpSocket sink(avrtc::SocketAddress("127.0.0.1", 0));
+    avrtc::UdpSocket sender(avrtc::SocketAddress("127.0.0.1", 0));
+    CHECK(reactor.Bind() && sink.Bind() && sender.Bind());
+    reactor.SetNonBlocking();
+    sink.SetNonBlocking();
+    reactor.EnableReceiveTimestamps(
+        avrtc::UdpSocket::TimestampMode::kSoftware);
+    if (options.enabled) {
+        // 回环接口上没有NAPI队列可轮询，真实网卡上才有效果
+        reactor.EnableBusyPoll(50);
+    }
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(packets);
+    std::vector<char> buffer(kBatch * kPayloadSize);
+    avrtc::UdpSocket::Datagram datagrams[kBatch];
+    const avrtc::SocketAddress to = sink.address_;
+
+    avrtc::EventLoop loop;
+    loop.SetBusyPoll(options);
+    loop.AddFD(reactor.GetFD(), EPOLLIN, [&](uint32_t) {
+        int n;
+        while ((n = reactor.RecvBatch(buffer.data(), kPayloadSize, datagrams,
+                                      kBatch)) > 0) {
+            for (int i = 0; i < n; ++i) {
+                reactor.SendTo(datagrams[i].data, datagrams[i].length, to);
+                latencies.push_back(RealtimeNs() - datagrams[i].arrival_ns);
+            }
+        }
+    });
+    std::thread reactor_thread([&]() { loop.Run(); });
+
+    // 等待时间戳开关生效、反应器线程进入循环
+    usleep(50 * 1000);
+    std::vector<char> payload(kPayloadSize, 'x');
+    std::vector<char> drain(kPayloadSize);
+    for (int i = 0; i < packets; ++i) {
+        sender.SendTo(payload.data(), payload.size(), reactor.address_);
+        while (sink.RecvFrom(drain.data(), drain.size(), nullptr) > 0) {
+        }
+        usleep(interval_us);
+    }
+    usleep(50 * 1000);
+    loop.Stop();
+    reactor_thread.join();
+    loop.RemoveFD(reactor.GetFD());
+
+    Result result;
+    result.samples = latencies.size();
+    result.idle_backoffs = loop.GetIdleBackoffs();
+    if (latencies.empty()) {
+        return result;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        size_t index = static_cast<size_t>(p * (latencies.size() - 1));
+        return latencies[index];
+    };
+    result.p50_ns = percentile(0.50);
+    result.p99_ns = percentile(0.99);
+    result.p999_ns = percentile(0.999);
+    return result;
+}
+
+void Print(const char* name, const Result& result) {
+    printf("%-18s %8zu %10.1f %10.1f %10.1f %10llu\n", name, result.samples,
+           result.p50_ns / 1000.0, result.p99_ns / 1000.0,
+           result.p999_ns / 1000.0,
+           static_cast<unsigned long long>(result.idle_backoffs));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int packets = argc > 1 ? atoi(argv[1]) : 20000;
+    int interval_us = argc > 2 ? atoi(argv[2]) : 100;
+    int cpu = argc > 3 ? atoi(argv[3])
+                       : static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)) - 1;
+
+    avrtc::EventLoop::BusyPollOptions blocking;
+    avrtc::EventLoop::BusyPollOptions busy;
+    busy.enabled = true;
+    avrtc::EventLoop::BusyPollOptions pinned = busy;
+    pinned.cpu = cpu;
+
+    printf("%d packets, %d us interval, receive-to-forward latency in us\n",
+           packets, interval_us);
+    printf("%-18s %8s %10s %10s %10s %10s\n", "mode", "samples", "p50",
+           "p99", "p99.9", "backoffs");
+    Print("blocking", RunMode(blocking, packets, interval_us));
+    Print("busy-poll", RunMode(busy, packets, interval_us));
+    Print("busy-poll+pinned", RunMode(pinned, packets, interval_us));
+    return 0;
+}
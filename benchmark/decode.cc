@@ -0,0 +1,149 @@
+// 解码线程配置对比：单线程、帧级多线程、片级多线程（可加低延迟）的吞吐量和单帧延迟
+// 单帧延迟是从送入一个包到输出pts相同的帧的时间，帧级多线程会按线程数推迟输出
+// 用法：bench_decode [媒体文件] [线程数] [重复次数]
+#include <base/codec.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    int frames = 0;
+    double fps = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    double max_ms = 0;
+    int active_thread_type = 0;
+};
+
+/**
+ * 把视频流的包全部读到内存中，测量时不包含读文件和解复用的时间
+ */
+std::vector<AVPacket*> LoadVideoPackets(avrtc::FormatContext* ctx,
+                                        AVStream** stream) {
+    std::vector<AVPacket*> packets;
+    *stream = ctx->GetStream(avrtc::FormatContext::MediaType::VIDEO);
+    if (*stream == nullptr) {
+        return packets;
+    }
+    AVPacket* packet = nullptr;
+    while ((packet = ctx->GetNextPacket()) != nullptr) {
+        if (packet->stream_index == (*stream)->index) {
+            AVPacket* copy = av_packet_alloc();
+            av_packet_move_ref(copy, packet);
+            packets.push_back(copy);
+        }
+        av_packet_unref(packet);
+    }
+    return packets;
+}
+
+Result RunDecode(AVStream* stream, const std::vector<AVPacket*>& packets,
+                 const avrtc::DecoderOptions& options, int rounds) {
+    Result result;
+    std::vector<double> latencies;
+    Clock::duration total{0};
+    for (int round = 0; round < rounds; ++round) {
+        avrtc::Codec codec(stream->codecpar->codec_id);
+        codec.SetDecoderOptions(options);
+        codec.CopyParamsFromStream(stream);
+        result.active_thread_type = codec.GetActiveThreadType();
+
+        std::unordered_map<int64_t, Clock::time_point> sent;
+        codec.SetOnDecodeCallback([&](AVFrame* frame) {
+            ++result.frames;
+            auto it = sent.find(frame->pts);
+            if (it != sent.end()) {
+                latencies.push_back(
+                    std::chrono::duration<double, std::milli>(Clock::now() -
+                                                              it->second)
+                        .count());
+                sent.erase(it);
+            }
+        });
+        auto start = Clock::now();
+        for (AVPacket* packet : packets) {
+            sent[packet->pts] = Clock::now();
+            codec.DecodeFrame(packet);
+        }
+        codec.FlushDecoder();
+        total += Clock::now() - start;
+    }
+
+    double seconds = std::chrono::duration<double>(total).count();
+    result.fps = seconds > 0 ? result.frames / seconds : 0;
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        result.p50_ms = latencies[latencies.size() / 2];
+        result.p99_ms = latencies[(latencies.size() - 1) * 99 / 100];
+        result.max_ms = latencies.back();
+    }
+    return result;
+}
+
+const char* ThreadTypeName(int thread_type) {
+    switch (thread_type) {
+        case FF_THREAD_FRAME:
+            return "frame";
+        case FF_THREAD_SLICE:
+            return "slice";
+        default:
+            return "none";
+    }
+}
+
+void Print(const char* name, const Result& result) {
+    printf("%-20s %-6s %8d %10.1f %10.2f %10.2f %10.2f\n", name,
+           ThreadTypeName(result.active_thread_type), result.frames,
+           result.fps, result.p50_ms, result.p99_ms, result.max_ms);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "test_data/oceans.mp4";
+    int threads = argc > 2 ? atoi(argv[2])
+                           : std::max(2u, std::thread::hardware_concurrency());
+    int rounds = argc > 3 ? atoi(argv[3]) : 3;
+
+    avrtc::FormatContext ctx(path);
+    AVStream* stream = nullptr;
+    std::vector<AVPacket*> packets = LoadVideoPackets(&ctx, &stream);
+    if (packets.empty()) {
+        fprintf(stderr, "No video packets in %s\n", path.c_str());
+        return 1;
+    }
+
+    avrtc::DecoderOptions single;
+    avrtc::DecoderOptions frame;
+    frame.thread_count = threads;
+    frame.thread_type = FF_THREAD_FRAME;
+    avrtc::DecoderOptions slice;
+    slice.thread_count = threads;
+    slice.thread_type = FF_THREAD_SLICE;
+    avrtc::DecoderOptions realtime = avrtc::DecoderOptions::RealTime(threads);
+
+    printf("%s: %zu packets, %d threads, %d rounds, latency in ms\n",
+           path.c_str(), packets.size(), threads, rounds);
+    printf("%-20s %-6s %8s %10s %10s %10s %10s\n", "mode", "active",
+           "frames", "fps", "p50", "p99", "max");
+    Print("single", RunDecode(stream, packets, single, rounds));
+    Print("frame", RunDecode(stream, packets, frame, rounds));
+    Print("slice", RunDecode(stream, packets, slice, rounds));
+    Print("slice+low-delay", RunDecode(stream, packets, realtime, rounds));
+
+    for (AVPacket*& packet : packets) {
+        av_packet_free(&packet);
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+// 跨线程投递任务的开销：avrtc::Thread和互斥锁加条件变量的队列对比
+// 用法：bench_thread_task [生产者线程数] [每个生产者的任务数]
+#include <base/thread.h>
+#include <glog/logging.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * 原来的任务队列实现：互斥锁保护的vector，每次投递都通知条件变量，
+ * 取任务时从头部erase
+ */
+class LockedTaskQueue {
+   public:
+    LockedTaskQueue() : thread_([this]() { Run(); }) {}
+    ~LockedTaskQueue() {
+        AddTask([this]() { running_ = false; });
+        thread_.join();
+    }
+
+    void AddTask(const std::function<void()>& task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(task);
+        cond_var_.notify_one();
+    }
+
+   private:
+    void Run() {
+        while (running_) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_var_.wait(lock, [this]() { return !tasks_.empty(); });
+                task = tasks_.front();
+                tasks_.erase(tasks_.begin());
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_var_;
+    std::vector<std::function<void()>> tasks_;
+    bool running_ = true;
+    std::thread thread_;
+};
+
+/**
+ * 多个生产者同时投递，统计从开始投递到全部执行完的时间
+ * @return 每个任务的平均纳秒数
+ */
+template <typename Queue>
+double Measure(Queue* queue, int producers, int tasks_per_producer) {
+    std::atomic<int> executed{0};
+    const int total = producers * tasks_per_producer;
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < tasks_per_producer; ++i) {
+                queue->AddTask([&executed]() {
+                    executed.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    while (executed.load(std::memory_order_relaxed) < total) {
+        std::this_thread::yield();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start);
+    return static_cast<double>(elapsed.count()) / total;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    int tasks_per_producer = argc > 2 ? atoi(argv[2]) : 200000;
+
+    printf("%d producers x %d tasks\n", producers, tasks_per_producer);
+    {
+        LockedTaskQueue queue;
+        printf("%-20s %8.1f ns/task\n", "mutex+condvar",
+               Measure(&queue, producers, tasks_per_producer));
+    }
+    {
+        avrtc::Thread thread;
+        printf("%-20s %8.1f ns/task\n", "avrtc::Thread",
+               Measure(&thread, producers, tasks_per_producer));
+        thread.AddTask([&thread]() { thread.Stop(); });
+        thread.Join();
+    }
+    return 0;
+}
@@ -31,6 +31,11 @@ void AvrtcClient::OnReceive(char* buffer, size_t length) {
     if (response_type == "Add") {
         id_ = std::stoi(sdp_msg->z[1]);
         LOG(INFO) << "Assigned ID: " << id_;
+    } else if (response_type == "Reject") {
+        // 房间已满，重连也会再次被拒绝，直接断开
+        LOG(WARNING) << "Rejected by server, room is full";
+        id_ = -1;
+        Stop();
     }
 
     // sdp_handler_ = std::make_shared<avrtc::SDPHandler>();
@@ -48,12 +48,29 @@ class AvrtcServer : public avrtc::ServerSocket {
                            std::shared_ptr<avrtc::SessionSocket> socket) {
         std::string name =
             sdp_msg->o->username_ + "@" + sdp_msg->o->unicast_address_;
-        current_sender_id_++;
 
         std::shared_ptr<SocketSdpPair> pair = std::make_shared<SocketSdpPair>();
         pair->socket = socket;
         pair->sdp = sdp_msg;
 
+        // 房间人数已满时直接拒绝，不占用ID和UI资源
+        avrtc::AdmissionController::Role role;
+        if (sdp_msg->z[1] == "Sender")
+            role = avrtc::AdmissionController::Role::kSender;
+        else if (sdp_msg->z[1] == "Receiver")
+            role = avrtc::AdmissionController::Role::kReceiver;
+        else
+            return;
+        if (!GetAdmission()->TryJoin(sdp_msg->s, role)) {
+            LOG(WARNING) << "Room " << sdp_msg->s << " is full, reject "
+                         << name;
+            avrtc::SDPHandler reject_sdp;
+            reject_sdp.z.push_back("Reject");
+            socket->Send(reject_sdp.ToString());
+            return;
+        }
+        current_sender_id_++;
+
         if (sdp_msg->z[1] == "Sender") {
             server_ui_->AddSender(name, current_sender_id_);
             senders_.insert({current_sender_id_, pair});
@@ -82,9 +99,19 @@ class AvrtcServer : public avrtc::ServerSocket {
 
         if (sdp_msg->z[1] == "Sender") {
             LOG(INFO) << "Removing sender with ID: " << id;
+            auto it = senders_.find(id);
+            if (it != senders_.end())
+                GetAdmission()->Leave(
+                    it->second->sdp->s,
+                    avrtc::AdmissionController::Role::kSender);
             server_ui_->RemoveSender(id);
             senders_.erase(id);
         } else if (sdp_msg->z[1] == "Receiver") {
+            auto it = receivers_.find(id);
+            if (it != receivers_.end())
+                GetAdmission()->Leave(
+                    it->second->sdp->s,
+                    avrtc::AdmissionController::Role::kReceiver);
             server_ui_->RemoveReceiver(id);
             receivers_.erase(id);
         } else {
@@ -179,6 +206,19 @@ int main(int argc, char** argv) {
     auto server = std::make_shared<AvrtcServer>(
         avrtc::SocketAddress(14562, AF_INET), server_ui);
 
+    // 信令连接的消息量很小，限速只影响行为异常的客户端
+    avrtc::AdmissionController::Limits limits;
+    limits.max_connections = 1024;
+    limits.max_senders_per_room = 16;
+    limits.max_receivers_per_room = 256;
+    server->GetAdmission()->SetLimits(limits);
+    avrtc::SessionSocket::RateLimitOptions rate_limit;
+    rate_limit.messages_per_sec = 50;
+    rate_limit.message_burst = 100;
+    rate_limit.bytes_per_sec = 256 * 1024;
+    rate_limit.byte_burst = 1024 * 1024;
+    server->SetSessionRateLimit(rate_limit);
+
     thread->AddTask([server]() {
         server->Start();
         avrtc::ThreadManager::Instance()->CurrentThread()->Stop();
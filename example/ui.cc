@@ -4,7 +4,18 @@ ClientUI::ClientUI() : Gtk::Window() {
     set_default_size(800, 500);
     set_title("Client Window");
     add(m_Stack_);
+    // 客户端连接在socket线程的事件循环中非阻塞地建立和收发
+    socket_loop_ = std::make_shared<avrtc::EventLoop>();
     socket_thread_ = std::make_shared<avrtc::Thread>();
+    std::shared_ptr<avrtc::EventLoop> loop = socket_loop_;
+    socket_thread_->AddTask([loop]() { loop->Run(); });
+}
+
+ClientUI::~ClientUI() {
+    if (client_) {
+        client_->Stop();
+    }
+    socket_loop_->Stop();
 }
 
 void ClientUI::SetClient(std::shared_ptr<AvrtcClient> client) {
@@ -117,12 +128,15 @@ void ClientInputServerInfoPage::OnFileButtonClicked() {
 }
 
 void ClientInputServerInfoPage::OnConnectButtonClicked() {
-    // 更新客户端地址并连接
-    client_ui_->socket_thread_->AddTask([this]() {
-        auto address_ = client_ui_->client_->address_;
-        address_.SetIP(GetServerIP());
-        address_.SetPort(GetServerPort());
-        client_ui_->client_->Connect();
+    // 更新客户端地址并连接，地址在UI线程中读取，连接切换到事件循环线程中发起
+    std::string ip = GetServerIP();
+    uint16_t port = GetServerPort();
+    std::shared_ptr<AvrtcClient> client = client_ui_->client_;
+    std::shared_ptr<avrtc::EventLoop> loop = client_ui_->socket_loop_;
+    loop->QueueInLoop([client, loop, ip, port]() {
+        client->address_.SetIP(ip);
+        client->address_.SetPort(port);
+        client->ConnectAsync(loop.get());
     });
 
     // 切换页面
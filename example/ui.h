@@ -67,7 +67,7 @@ class ClientInputServerInfoPage : public Gtk::Box {
 class ClientUI : public Gtk::Window {
  public:
   ClientUI();
-  ~ClientUI() = default;
+  ~ClientUI();
 
   void SetClient(std::shared_ptr<AvrtcClient> client);
 
@@ -78,6 +78,7 @@ class ClientUI : public Gtk::Window {
 
  public:
   std::shared_ptr<AvrtcClient> client_;
+  std::shared_ptr<avrtc::EventLoop> socket_loop_;
   std::shared_ptr<avrtc::Thread> socket_thread_;
 };
 
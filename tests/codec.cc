@@ -3,7 +3,10 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <memory>
+#include <thread>
+#include <vector>
 
 void onNewFrame(AVFrame* frame) {
     EXPECT_EQ(frame->width, 960);
@@ -29,4 +32,125 @@ TEST(CodecTest, CheckDecoder) {
         av_packet_unref(packet);
     }
     codec->FlushDecoder();
-}
\ No newline at end of file
+}
+
+namespace {
+
+/**
+ * Decode the video stream of the test file.
+ * @param options The decoder options.
+ * @param pts Receives the pts of the decoded frames in output order.
+ * @param thread_type Receives the threading type the decoder used.
+ */
+void DecodeVideo(const avrtc::DecoderOptions& options,
+                 std::vector<int64_t>* pts, int* thread_type) {
+    pts->clear();
+    avrtc::FormatContext ctx("test_data/oceans.mp4");
+    AVStream* stream = ctx.GetStream(avrtc::FormatContext::MediaType::VIDEO);
+    ASSERT_NE(stream, nullptr);
+    avrtc::Codec codec(stream->codecpar->codec_id);
+    codec.SetDecoderOptions(options);
+    codec.CopyParamsFromStream(stream);
+    *thread_type = codec.GetActiveThreadType();
+    codec.SetOnDecodeCallback(
+        [pts](AVFrame* frame) { pts->push_back(frame->pts); });
+    AVPacket* packet = nullptr;
+    while ((packet = ctx.GetNextPacket()) != nullptr) {
+        if (packet->stream_index == stream->index)
+            codec.DecodeFrame(packet);
+        av_packet_unref(packet);
+    }
+    codec.FlushDecoder();
+}
+
+}  // namespace
+
+TEST(CodecTest, SliceThreadedDecoderDecodesEveryFrame) {
+    std::vector<int64_t> expected;
+    int thread_type = -1;
+    ASSERT_NO_FATAL_FAILURE(
+        DecodeVideo(avrtc::DecoderOptions(), &expected, &thread_type));
+    ASSERT_FALSE(expected.empty());
+    EXPECT_TRUE(std::is_sorted(expected.begin(), expected.end()));
+    EXPECT_EQ(thread_type, 0);
+
+    std::vector<int64_t> pts;
+    avrtc::DecoderOptions slice;
+    slice.thread_count = 2;
+    slice.thread_type = FF_THREAD_SLICE;
+    DecodeVideo(slice, &pts, &thread_type);
+    EXPECT_EQ(pts, expected);
+    EXPECT_EQ(thread_type, FF_THREAD_SLICE);
+
+    // Low delay must not reorder or drop frames of a stream with B-frames
+    DecodeVideo(avrtc::DecoderOptions::RealTime(2), &pts, &thread_type);
+    EXPECT_EQ(pts, expected);
+    EXPECT_EQ(thread_type, FF_THREAD_SLICE);
+}
+
+TEST(CodecTest, OpensTheGivenFileAndStreams) {
+    avrtc::FormatContext ctx("test_data/oceans.mp4");
+    AVStream* video = ctx.GetStream(avrtc::FormatContext::MediaType::VIDEO);
+    AVStream* audio = ctx.GetStream(avrtc::FormatContext::MediaType::AUDIO);
+    ASSERT_NE(video, nullptr);
+    ASSERT_NE(audio, nullptr);
+    EXPECT_EQ(video->codecpar->codec_type, AVMEDIA_TYPE_VIDEO);
+    EXPECT_EQ(audio->codecpar->codec_type, AVMEDIA_TYPE_AUDIO);
+    EXPECT_NE(video->index, audio->index);
+
+    // A missing file has no streams and yields no packets
+    avrtc::FormatContext missing("test_data/missing.mp4");
+    EXPECT_EQ(missing.GetStream(avrtc::FormatContext::MediaType::VIDEO),
+              nullptr);
+    EXPECT_EQ(missing.GetNextPacket(), nullptr);
+    EXPECT_FALSE(missing.StartReadAhead());
+}
+
+TEST(CodecTest, ReadAheadMatchesSynchronousDemux) {
+    // Count packets per stream with synchronous demuxing
+    avrtc::FormatContext sync_ctx("test_data/oceans.mp4");
+    int video_index =
+        sync_ctx.GetStream(avrtc::FormatContext::MediaType::VIDEO)->index;
+    int expected[2] = {0, 0};
+    AVPacket* packet = nullptr;
+    while ((packet = sync_ctx.GetNextPacket()) != nullptr) {
+        ++expected[packet->stream_index == video_index ? 0 : 1];
+        av_packet_unref(packet);
+    }
+
+    // A small queue depth makes the demux thread wait for the consumer
+    avrtc::FormatContext ctx("test_data/oceans.mp4");
+    avrtc::ReadAheadOptions options;
+    options.queue_depth = 4;
+    ASSERT_TRUE(ctx.StartReadAhead(options));
+    EXPECT_FALSE(ctx.StartReadAhead(options));
+    AVPacket* popped = av_packet_alloc();
+    int received[2] = {0, 0};
+    bool finished[2] = {false, false};
+    const avrtc::FormatContext::MediaType types[2] = {
+        avrtc::FormatContext::MediaType::VIDEO,
+        avrtc::FormatContext::MediaType::AUDIO};
+    while (!finished[0] || !finished[1]) {
+        for (int i = 0; i < 2; ++i) {
+            if (finished[i]) {
+                continue;
+            }
+            int ret = ctx.PopPacket(types[i], popped);
+            if (ret == 0) {
+                EXPECT_GT(popped->size, 0);
+                EXPECT_LE(ctx.GetQueuedPackets(types[i]), 4u);
+                ++received[i];
+            } else if (ret == AVERROR(EAGAIN)) {
+                std::this_thread::yield();
+            } else {
+                // A read error is reported instead of a clean end of file.
+                EXPECT_EQ(ret, AVERROR_EOF);
+                finished[i] = true;
+            }
+        }
+    }
+    av_packet_free(&popped);
+    EXPECT_EQ(received[0], expected[0]);
+    EXPECT_EQ(received[1], expected[1]);
+    ctx.StopReadAhead();
+}
@@ -0,0 +1,179 @@
+#include "base/coroutine.h"
+
+// 只在C++20下编译，见CMake选项AVRTC_ENABLE_COROUTINES
+#if defined(__cpp_impl_coroutine)
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+avrtc::CoTask<int> AddOnThread(avrtc::Thread* thread, int a, int b) {
+    co_await avrtc::SwitchTo(thread);
+    EXPECT_TRUE(thread->IsCurrent());
+    co_return a + b;
+}
+
+avrtc::CoTask<int> Fail() {
+    throw std::runtime_error("failed");
+    co_return 0;
+}
+
+// 析构时计数，检查协程帧中的局部变量是否被析构
+struct DestroyCounter {
+    explicit DestroyCounter(std::atomic<int>* count) : count(count) {}
+    ~DestroyCounter() { ++*count; }
+    std::atomic<int>* count;
+};
+
+avrtc::CoTask<int> SleepOn(avrtc::Thread* thread, std::atomic<int>* destroyed,
+                           std::atomic<bool>* resumed) {
+    DestroyCounter counter(destroyed);
+    co_await avrtc::SleepFor(thread, 10000);
+    *resumed = true;
+    co_return 0;
+}
+
+}  // namespace
+
+TEST(CoroutineTest, AwaitsValuesAcrossThreads) {
+    avrtc::Thread main_thread;
+    avrtc::Thread worker;
+    std::promise<int> result;
+    auto run = [&]() -> avrtc::CoTask<void> {
+        int sum = 0;
+        for (int i = 0; i < 10; ++i) {
+            sum += co_await AddOnThread(&worker, i, 1);
+            EXPECT_TRUE(worker.IsCurrent());
+            co_await avrtc::SwitchTo(&main_thread);
+            EXPECT_TRUE(main_thread.IsCurrent());
+        }
+        result.set_value(sum);
+    };
+    avrtc::Spawn(&main_thread, run());
+    EXPECT_EQ(result.get_future().get(), 55);
+}
+
+TEST(CoroutineTest, ExceptionRethrownAtAwait) {
+    avrtc::Thread thread;
+    std::promise<std::string> result;
+    auto run = [&]() -> avrtc::CoTask<void> {
+        try {
+            co_await Fail();
+            result.set_value("no exception");
+        } catch (const std::runtime_error& e) {
+            result.set_value(e.what());
+        }
+    };
+    avrtc::Spawn(&thread, run());
+    EXPECT_EQ(result.get_future().get(), "failed");
+}
+
+TEST(CoroutineTest, SleepForResumesOnSameThread) {
+    avrtc::Thread thread;
+    std::promise<int64_t> elapsed_ms;
+    auto run = [&]() -> avrtc::CoTask<void> {
+        auto start = std::chrono::steady_clock::now();
+        co_await avrtc::SleepFor(20);
+        EXPECT_TRUE(thread.IsCurrent());
+        elapsed_ms.set_value(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count());
+    };
+    avrtc::Spawn(&thread, run());
+    EXPECT_GE(elapsed_ms.get_future().get(), 20);
+}
+
+TEST(CoroutineTest, ReadableResumesOnEventLoop) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    avrtc::EventLoop loop;
+    std::thread loop_thread([&loop]() { loop.Run(); });
+
+    std::promise<std::string> received;
+    auto run = [&]() -> avrtc::CoTask<void> {
+        std::string data;
+        while (data.size() < 6) {
+            uint32_t events = co_await avrtc::Readable(&loop, fds[0]);
+            EXPECT_TRUE(events & EPOLLIN);
+            char buf[16];
+            ssize_t n = read(fds[0], buf, sizeof(buf));
+            if (n > 0) {
+                data.append(buf, n);
+            }
+        }
+        received.set_value(data);
+    };
+    avrtc::Spawn(&loop, run());
+    ASSERT_EQ(write(fds[1], "abc", 3), 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(write(fds[1], "def", 3), 3);
+    EXPECT_EQ(received.get_future().get(), "abcdef");
+
+    loop.Stop();
+    loop_thread.join();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(CoroutineTest, StoppedThreadDestroysAwaitingChain) {
+    std::atomic<int> destroyed{0};
+    std::atomic<bool> resumed{false};
+
+    // 切换到已经停止的线程，投递被拒绝，帧在co_await中被销毁
+    avrtc::Thread stopped;
+    stopped.Stop();
+    stopped.Join();
+    {
+        avrtc::Thread thread;
+        auto run = [&]() -> avrtc::CoTask<void> {
+            DestroyCounter counter(&destroyed);
+            co_await avrtc::SwitchTo(&stopped);
+            resumed = true;
+        };
+        avrtc::Spawn(&thread, run());
+        thread.Stop(avrtc::Thread::StopMode::kDrainPending);
+        thread.Join();
+    }
+    EXPECT_EQ(destroyed, 1);
+
+    // 父协程等待的子协程还在定时等待中，线程析构时丢弃定时任务，整条链被销毁
+    {
+        avrtc::Thread thread;
+        std::promise<void> sleeping;
+        auto run = [&]() -> avrtc::CoTask<void> {
+            DestroyCounter counter(&destroyed);
+            avrtc::CoTask<int> child = SleepOn(&thread, &destroyed, &resumed);
+            sleeping.set_value();
+            co_await std::move(child);
+            resumed = true;
+        };
+        avrtc::Spawn(&thread, run());
+        sleeping.get_future().wait();
+    }
+    EXPECT_EQ(destroyed, 3);
+    EXPECT_FALSE(resumed);
+}
+
+TEST(CoroutineTest, FramesReusedFromThreadPool) {
+    // 协程创建后不执行，销毁时帧归还到当前线程的空闲链表
+    { avrtc::CoTask<int> task = Fail(); }
+    size_t cached = avrtc::internal::FramePool::GetCachedCount();
+    EXPECT_GT(cached, 0u);
+    {
+        avrtc::CoTask<int> task = Fail();
+        EXPECT_EQ(avrtc::internal::FramePool::GetCachedCount(), cached - 1);
+    }
+    EXPECT_EQ(avrtc::internal::FramePool::GetCachedCount(), cached);
+}
+
+#endif  // defined(__cpp_impl_coroutine)
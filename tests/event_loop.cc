@@ -0,0 +1,176 @@
+#include "base/event_loop.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "base/timer_wheel.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+TEST(TimerWheelTest, OneShotAndPeriodic) {
+    avrtc::TimerWheel wheel(8);
+    std::vector<uint64_t> fired;
+    wheel.Add(3, 0, [&]() { fired.push_back(wheel.CurrentTick()); });
+    wheel.Add(2, 5, [&]() { fired.push_back(100 + wheel.CurrentTick()); });
+    EXPECT_EQ(wheel.Size(), 2);
+    EXPECT_EQ(wheel.TicksUntilNextSlot(), 2);
+
+    wheel.Advance(12);
+    EXPECT_EQ(fired, (std::vector<uint64_t>{102, 3, 107, 112}));
+    EXPECT_EQ(wheel.Size(), 1);
+}
+
+TEST(TimerWheelTest, DelayLongerThanOneRevolution) {
+    avrtc::TimerWheel wheel(8);
+    uint64_t fired_at = 0;
+    wheel.Add(21, 0, [&]() { fired_at = wheel.CurrentTick(); });
+    // 下一个非空槽位只是到期时间的下界
+    EXPECT_EQ(wheel.TicksUntilNextSlot(), 5);
+
+    wheel.Advance(20);
+    EXPECT_EQ(fired_at, 0);
+    wheel.Advance(1);
+    EXPECT_EQ(fired_at, 21);
+    EXPECT_EQ(wheel.TicksUntilNextSlot(), -1);
+}
+
+TEST(TimerWheelTest, Cancel) {
+    avrtc::TimerWheel wheel(64);
+    int count = 0;
+    auto id = wheel.Add(5, 0, [&]() { ++count; });
+    EXPECT_TRUE(wheel.Cancel(id));
+    EXPECT_FALSE(wheel.Cancel(id));
+    EXPECT_FALSE(wheel.Cancel(avrtc::TimerWheel::kInvalidTimerId));
+
+    // 节点复用后，旧ID不能取消新的定时器
+    auto reused = wheel.Add(5, 0, [&]() { ++count; });
+    EXPECT_FALSE(wheel.Cancel(id));
+    wheel.Advance(5);
+    EXPECT_EQ(count, 1);
+    EXPECT_FALSE(wheel.Cancel(reused));
+}
+
+TEST(TimerWheelTest, CancelFromCallback) {
+    avrtc::TimerWheel wheel(64);
+    int periodic_count = 0;
+    int other_count = 0;
+    avrtc::TimerWheel::TimerId periodic = 0;
+    avrtc::TimerWheel::TimerId other = 0;
+    periodic = wheel.Add(1, 1, [&]() {
+        if (++periodic_count == 3)
+            wheel.Cancel(periodic);
+    });
+    // 同一槽位中，先执行的回调取消后执行的定时器（槽位链表头插，后添加的先执行）
+    other = wheel.Add(4, 0, [&]() { ++other_count; });
+    wheel.Add(4, 0, [&]() { EXPECT_TRUE(wheel.Cancel(other)); });
+
+    wheel.Advance(10);
+    EXPECT_EQ(periodic_count, 3);
+    EXPECT_EQ(wheel.Size(), 0);
+    EXPECT_EQ(other_count, 0);
+}
+
+TEST(EventLoopTest, TimersFireInOrder) {
+    avrtc::EventLoop loop;
+    std::vector<int> order;
+    int periodic_count = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    loop.RunAfter(30, [&]() { order.push_back(30); });
+    loop.RunAfter(10, [&]() { order.push_back(10); });
+    auto cancelled = loop.RunAfter(20, [&]() { order.push_back(20); });
+    EXPECT_TRUE(loop.CancelTimer(cancelled));
+    avrtc::EventLoop::TimerId periodic = 0;
+    periodic = loop.RunEvery(5, [&]() {
+        if (++periodic_count == 4)
+            loop.CancelTimer(periodic);
+    });
+    loop.RunAfter(40, [&]() { loop.Stop(); });
+    loop.Run();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    EXPECT_EQ(order, (std::vector<int>{10, 30}));
+    EXPECT_EQ(periodic_count, 4);
+    EXPECT_GE(elapsed.count(), 40);
+}
+
+TEST(EventLoopTest, BusyPollBacksOffWhenIdle) {
+    avrtc::EventLoop loop;
+    avrtc::EventLoop::BusyPollOptions options;
+    options.enabled = true;
+    options.idle_spin_us = 1000;
+    options.cpu = sched_getcpu();
+    loop.SetBusyPoll(options);
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    int reads = 0;
+    loop.AddFD(fds[0], EPOLLIN, [&](uint32_t) {
+        char c;
+        ASSERT_EQ(read(fds[0], &c, 1), 1);
+        ++reads;
+    });
+    loop.RunAfter(5, [&]() { ASSERT_EQ(write(fds[1], "x", 1), 1); });
+    loop.RunAfter(30, [&]() { loop.Stop(); });
+    loop.Run();
+
+    EXPECT_EQ(reads, 1);
+    // 两次定时器之间空闲远超空转预算，至少退回过一次阻塞等待
+    EXPECT_GE(loop.GetIdleBackoffs(), 1);
+    loop.RemoveFD(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(EventLoopTest, StopBeforeRun) {
+    avrtc::EventLoop loop;
+    loop.Stop();
+    loop.Run();
+    SUCCEED();
+}
+
+TEST(EventLoopTest, StaleEventAfterFdReuse) {
+    avrtc::EventLoop loop;
+    int pipes[2][2];
+    ASSERT_EQ(pipe(pipes[0]), 0);
+    ASSERT_EQ(pipe(pipes[1]), 0);
+    int fired = 0;
+    int reused_fired = 0;
+    int reused_fds[2] = {-1, -1};
+
+    // 先触发的回调关闭另一个fd，并用同一个fd号注册新的回调，
+    // 同一批次中属于旧fd的事件必须被丢弃
+    for (int i = 0; i < 2; ++i) {
+        int other = pipes[1 - i][0];
+        loop.AddFD(pipes[i][0], EPOLLIN, [&, i, other](uint32_t) {
+            ++fired;
+            char c;
+            ASSERT_EQ(read(pipes[i][0], &c, 1), 1);
+            loop.RemoveFD(other);
+            close(other);
+            ASSERT_EQ(pipe(reused_fds), 0);
+            ASSERT_EQ(reused_fds[0], other);
+            loop.AddFD(reused_fds[0], EPOLLIN,
+                       [&](uint32_t) { ++reused_fired; });
+            loop.RemoveFD(pipes[i][0]);
+        });
+    }
+    ASSERT_EQ(write(pipes[0][1], "x", 1), 1);
+    ASSERT_EQ(write(pipes[1][1], "x", 1), 1);
+    loop.RunOnce(100);
+    loop.RunOnce(0);
+
+    EXPECT_EQ(fired, 1);
+    EXPECT_EQ(reused_fired, 0);
+    loop.RemoveFD(reused_fds[0]);
+    int survivor =
+        pipes[0][0] == reused_fds[0] ? pipes[1][0] : pipes[0][0];
+    for (int fd : {survivor, pipes[0][1], pipes[1][1], reused_fds[0],
+                   reused_fds[1]}) {
+        close(fd);
+    }
+}
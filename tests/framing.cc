@@ -0,0 +1,103 @@
+#include "base/framing.h"
+
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+
+#include "base/socket.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+std::vector<std::string> DecodeAll(avrtc::Buffer* buffer, bool* ok) {
+    std::vector<std::string> messages;
+    *ok = avrtc::FrameCodec::Decode(buffer, [&](char* data, size_t length) {
+        messages.emplace_back(data, length);
+    });
+    return messages;
+}
+
+}  // namespace
+
+TEST(FrameCodecTest, DecodeCoalescedFrames) {
+    avrtc::Buffer buffer;
+    std::string stream = avrtc::FrameCodec::Encode("v=0\n") +
+                         avrtc::FrameCodec::Encode("") +
+                         avrtc::FrameCodec::Encode("z=Add\n");
+    buffer.Append(stream.data(), stream.size());
+
+    bool ok = false;
+    auto messages = DecodeAll(&buffer, &ok);
+    EXPECT_TRUE(ok);
+    ASSERT_EQ(messages.size(), 3);
+    EXPECT_EQ(messages[0], "v=0\n");
+    EXPECT_EQ(messages[1], "");
+    EXPECT_EQ(messages[2], "z=Add\n");
+    EXPECT_EQ(buffer.ReadableBytes(), 0);
+}
+
+TEST(FrameCodecTest, DecodeSplitFrame) {
+    avrtc::Buffer buffer;
+    std::string stream = avrtc::FrameCodec::Encode("o=alice 1 0 IN IP4 x\n");
+
+    bool ok = false;
+    for (size_t i = 0; i + 1 < stream.size(); ++i) {
+        buffer.Append(stream.data() + i, 1);
+        EXPECT_TRUE(DecodeAll(&buffer, &ok).empty());
+        EXPECT_TRUE(ok);
+    }
+    buffer.Append(stream.data() + stream.size() - 1, 1);
+    auto messages = DecodeAll(&buffer, &ok);
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(messages[0], "o=alice 1 0 IN IP4 x\n");
+}
+
+TEST(FrameCodecTest, RejectOversizedFrame) {
+    avrtc::Buffer buffer;
+    char header[avrtc::FrameCodec::kHeaderSize];
+    avrtc::FrameCodec::EncodeHeader(avrtc::FrameCodec::kMaxFrameSize + 1,
+                                    header);
+    buffer.Append(header, sizeof(header));
+
+    bool ok = true;
+    EXPECT_TRUE(DecodeAll(&buffer, &ok).empty());
+    EXPECT_FALSE(ok);
+}
+
+TEST(FrameCodecTest, SessionSocketDeliversWholeMessages) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    auto session = std::make_shared<avrtc::SessionSocket>(
+        avrtc::SocketAddress("127.0.0.1", 0));
+    session->Close();
+    session->SetFD(fds[0]);
+
+    std::vector<std::string> messages;
+    session->SetOnReceive([&](std::shared_ptr<avrtc::SessionSocket>,
+                              char* buffer, size_t length) {
+        messages.emplace_back(buffer, length);
+    });
+
+    // 两条完整消息加半条消息在一次读取中到达
+    std::string first = avrtc::FrameCodec::Encode("first");
+    std::string second = avrtc::FrameCodec::Encode("second");
+    std::string third = avrtc::FrameCodec::Encode("third");
+    std::string chunk = first + second + third.substr(0, 6);
+    ASSERT_EQ(write(fds[1], chunk.data(), chunk.size()), chunk.size());
+    EXPECT_FALSE(session->Recv());
+    ASSERT_EQ(messages.size(), 2);
+    EXPECT_EQ(messages[0], "first");
+    EXPECT_EQ(messages[1], "second");
+
+    std::string rest = third.substr(6);
+    ASSERT_EQ(write(fds[1], rest.data(), rest.size()), rest.size());
+    EXPECT_FALSE(session->Recv());
+    ASSERT_EQ(messages.size(), 3);
+    EXPECT_EQ(messages[2], "third");
+
+    close(fds[1]);
+    EXPECT_TRUE(session->Recv());
+}
@@ -0,0 +1,144 @@
+#include "base/impairment.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "base/event_loop.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Received {
+    int sequence;
+    Clock::time_point at;
+};
+
+// 每个包的前4字节是序号
+avrtc::NetworkImpairment::DeliverCallback Collect(
+    std::vector<Received>* received) {
+    return [received](const char* data, size_t length) {
+        int sequence;
+        memcpy(&sequence, data, sizeof(sequence));
+        received->push_back({sequence, Clock::now()});
+    };
+}
+
+void SendSequence(avrtc::NetworkImpairment* impairment,
+                  int sequence,
+                  size_t length = 100) {
+    std::vector<char> packet(length);
+    memcpy(packet.data(), &sequence, sizeof(sequence));
+    impairment->Send(packet.data(), packet.size());
+}
+
+}  // namespace
+
+TEST(NetworkImpairmentTest, DisabledIsPassthrough) {
+    avrtc::EventLoop loop;
+    std::vector<Received> received;
+    avrtc::NetworkImpairment impairment(&loop, Collect(&received));
+    for (int i = 0; i < 10; ++i)
+        SendSequence(&impairment, i);
+    EXPECT_EQ(received.size(), 10);
+    EXPECT_EQ(impairment.GetPendingCount(), 0);
+}
+
+TEST(NetworkImpairmentTest, RandomAndBurstLoss) {
+    avrtc::EventLoop loop;
+    std::vector<Received> received;
+    avrtc::NetworkImpairment impairment(&loop, Collect(&received));
+    const int kPackets = 20000;
+
+    avrtc::ImpairmentConfig config;
+    config.loss_rate = 0.1;
+    impairment.SetConfig(config);
+    for (int i = 0; i < kPackets; ++i)
+        SendSequence(&impairment, i);
+    EXPECT_NEAR(1.0 - received.size() / double(kPackets), 0.1, 0.01);
+
+    // 稳态坏状态概率0.05 / (0.05 + 0.25)，平均突发长度1 / 0.25
+    received.clear();
+    config = avrtc::ImpairmentConfig();
+    config.burst_loss = true;
+    config.good_to_bad = 0.05;
+    config.bad_to_good = 0.25;
+    impairment.SetConfig(config);
+    for (int i = 0; i < kPackets; ++i)
+        SendSequence(&impairment, i);
+    EXPECT_NEAR(1.0 - received.size() / double(kPackets), 1.0 / 6, 0.02);
+    int bursts = 0;
+    int previous = -1;
+    for (const auto& packet : received) {
+        if (packet.sequence != previous + 1)
+            ++bursts;
+        previous = packet.sequence;
+    }
+    double mean_burst = (kPackets - received.size()) / double(bursts);
+    EXPECT_NEAR(mean_burst, 4.0, 0.5);
+}
+
+TEST(NetworkImpairmentTest, DelayJitterAndReorder) {
+    avrtc::EventLoop loop;
+    std::vector<Received> received;
+    avrtc::NetworkImpairment impairment(&loop, Collect(&received));
+    avrtc::ImpairmentConfig config;
+    config.delay_ms = 20;
+    config.jitter_ms = 10;
+    impairment.SetConfig(config);
+
+    const int kPackets = 50;
+    auto start = Clock::now();
+    for (int i = 0; i < kPackets; ++i)
+        SendSequence(&impairment, i);
+    EXPECT_TRUE(received.empty());
+    while (received.size() < kPackets)
+        loop.RunOnce(100);
+    for (int i = 0; i < kPackets; ++i) {
+        EXPECT_EQ(received[i].sequence, i);
+        EXPECT_GE(received[i].at - start, std::chrono::milliseconds(10));
+    }
+
+    // 一部分包不经过延迟，越过排队中的包
+    received.clear();
+    config.jitter_ms = 0;
+    config.reorder_rate = 0.3;
+    impairment.SetConfig(config);
+    for (int i = 0; i < kPackets; ++i)
+        SendSequence(&impairment, i);
+    EXPECT_EQ(received.size(), impairment.GetStats().reordered);
+    while (received.size() < kPackets)
+        loop.RunOnce(100);
+    bool out_of_order = false;
+    for (int i = 1; i < kPackets; ++i)
+        out_of_order |= received[i].sequence < received[i - 1].sequence;
+    EXPECT_TRUE(out_of_order);
+}
+
+TEST(NetworkImpairmentTest, BandwidthCapAndQueueLimit) {
+    avrtc::EventLoop loop;
+    std::vector<Received> received;
+    avrtc::NetworkImpairment impairment(&loop, Collect(&received));
+    avrtc::ImpairmentConfig config;
+    config.rate_bps = 8000000;  // 每毫秒1000字节
+    config.queue_limit_bytes = 40000;
+    impairment.SetConfig(config);
+
+    // 突发100个1000字节的包，瓶颈队列只能容纳约40个，其余丢弃
+    auto start = Clock::now();
+    for (int i = 0; i < 100; ++i)
+        SendSequence(&impairment, i, 1000);
+    const auto& stats = impairment.GetStats();
+    EXPECT_NEAR(stats.queue_dropped, 60, 1);
+    while (impairment.GetPendingCount() > 0)
+        loop.RunOnce(100);
+    // 按链路速率串行化，最后一个包在约40毫秒后发出
+    auto elapsed = received.back().at - start;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(38));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(200));
+    EXPECT_EQ(received.size() + stats.queue_dropped, 100);
+}
@@ -0,0 +1,91 @@
+#include "base/mapped_file.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+/**
+ * 测试用的临时文件，析构时删除
+ */
+class TempFile {
+   public:
+    explicit TempFile(const std::string& content) {
+        char path[] = "/tmp/avrtc-mapped-XXXXXX";
+        int fd = mkstemp(path);
+        EXPECT_GE(fd, 0);
+        EXPECT_EQ(write(fd, content.data(), content.size()),
+                  static_cast<ssize_t>(content.size()));
+        close(fd);
+        path_ = path;
+    }
+    ~TempFile() { unlink(path_.c_str()); }
+
+    const std::string& GetPath() const { return path_; }
+
+   private:
+    std::string path_;
+};
+
+}  // namespace
+
+TEST(MappedFileTest, ReadsAndSeeksLikeAFile) {
+    std::string content;
+    for (int i = 0; i < 100000; ++i) {
+        content += static_cast<char>('a' + i % 26);
+    }
+    TempFile temp(content);
+    auto file = avrtc::MappedFile::Open(temp.GetPath());
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->GetSize(), content.size());
+
+    // 分块读完整个文件
+    avrtc::MappedFileReader reader(file);
+    std::string read_back;
+    std::vector<uint8_t> buffer(4096);
+    size_t n;
+    while ((n = reader.Read(buffer.data(), buffer.size())) > 0) {
+        read_back.append(buffer.begin(), buffer.begin() + n);
+    }
+    EXPECT_EQ(read_back, content);
+
+    EXPECT_EQ(reader.Seek(-10, SEEK_END),
+              static_cast<int64_t>(content.size() - 10));
+    EXPECT_EQ(reader.Read(buffer.data(), buffer.size()), 10u);
+    EXPECT_EQ(reader.Seek(100, SEEK_SET), 100);
+    EXPECT_EQ(reader.Seek(5, SEEK_CUR), 105);
+    ASSERT_EQ(reader.Read(buffer.data(), 1), 1u);
+    EXPECT_EQ(buffer[0], content[105]);
+    EXPECT_EQ(reader.Seek(-1000, SEEK_CUR), -1);
+    EXPECT_EQ(reader.GetPosition(), 106u);
+    // 超出文件末尾的位置可以跳转，但读不到数据
+    EXPECT_EQ(reader.Seek(1, SEEK_END),
+              static_cast<int64_t>(content.size() + 1));
+    EXPECT_EQ(reader.Read(buffer.data(), buffer.size()), 0u);
+}
+
+TEST(MappedFileTest, SameFileSharesOneMapping) {
+    TempFile temp("media");
+    auto first = avrtc::MappedFile::Open(temp.GetPath());
+    auto second = avrtc::MappedFile::Open(temp.GetPath());
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(first->GetData(), second->GetData());
+
+    first.reset();
+    second.reset();
+    // 所有引用释放后重新打开会建立新的映射
+    auto reopened = avrtc::MappedFile::Open(temp.GetPath());
+    ASSERT_NE(reopened, nullptr);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(reopened->GetData()),
+                          reopened->GetSize()),
+              "media");
+
+    EXPECT_EQ(avrtc::MappedFile::Open("/nonexistent/avrtc-media"), nullptr);
+    EXPECT_EQ(avrtc::MappedFile::Open("/tmp"), nullptr);
+}
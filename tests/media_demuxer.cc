@@ -0,0 +1,233 @@
+#include "base/media_demuxer.h"
+
+#include <arpa/inet.h>
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// 构造一个最小的RTP包：V=2，PT=96，指定SSRC
+std::string MakeRtp(uint32_t ssrc) {
+    std::string packet(12, '\0');
+    packet[0] = static_cast<char>(0x80);
+    packet[1] = 96;
+    uint32_t be_ssrc = htonl(ssrc);
+    memcpy(&packet[8], &be_ssrc, sizeof(be_ssrc));
+    return packet;
+}
+
+avrtc::FlowTable::Key MakeKey(uint64_t n) {
+    avrtc::FlowTable::Key key;
+    key.hi = n;
+    key.lo = ~n;
+    return key;
+}
+
+}  // namespace
+
+TEST(MediaDemuxerTest, ClassifyPacket) {
+    using avrtc::ClassifyPacket;
+    using avrtc::PacketKind;
+    uint8_t packet[12] = {};
+
+    packet[0] = 0x00;
+    EXPECT_EQ(ClassifyPacket(packet, sizeof(packet)), PacketKind::kStun);
+    packet[0] = 17;
+    EXPECT_EQ(ClassifyPacket(packet, sizeof(packet)), PacketKind::kZrtp);
+    packet[0] = 22;
+    EXPECT_EQ(ClassifyPacket(packet, sizeof(packet)), PacketKind::kDtls);
+    packet[0] = 0x40;
+    EXPECT_EQ(ClassifyPacket(packet, sizeof(packet)),
+              PacketKind::kTurnChannel);
+    packet[0] = 0x80;
+    packet[1] = 96;
+    EXPECT_EQ(ClassifyPacket(packet, sizeof(packet)), PacketKind::kRtp);
+    packet[1] = 200;  // SR
+    EXPECT_EQ(ClassifyPacket(packet, sizeof(packet)), PacketKind::kRtcp);
+    packet[0] = 0xff;
+    EXPECT_EQ(ClassifyPacket(packet, sizeof(packet)), PacketKind::kUnknown);
+    EXPECT_EQ(ClassifyPacket(packet, 0), PacketKind::kUnknown);
+
+    // 长度不足一个RTP固定头
+    packet[0] = 0x80;
+    packet[1] = 96;
+    EXPECT_EQ(ClassifyPacket(packet, 8), PacketKind::kUnknown);
+
+    std::string rtp = MakeRtp(0x12345678);
+    uint32_t ssrc = 0;
+    EXPECT_TRUE(avrtc::ExtractSsrc(PacketKind::kRtp,
+                                   reinterpret_cast<uint8_t*>(&rtp[0]),
+                                   rtp.size(), &ssrc));
+    EXPECT_EQ(ssrc, 0x12345678u);
+}
+
+TEST(MediaDemuxerTest, FlowTableInsertFindErase) {
+    avrtc::FlowTable table(64);
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < 64; ++i) {
+        ASSERT_TRUE(table.Insert(MakeKey(i), i * 10));
+    }
+    EXPECT_EQ(table.Size(), 64);
+
+    // 重复插入更新值
+    EXPECT_TRUE(table.Insert(MakeKey(7), 777));
+    EXPECT_TRUE(table.Find(MakeKey(7), &value));
+    EXPECT_EQ(value, 777);
+    EXPECT_EQ(table.Size(), 64);
+
+    for (uint64_t i = 0; i < 64; i += 2) {
+        EXPECT_TRUE(table.Erase(MakeKey(i)));
+    }
+    EXPECT_FALSE(table.Erase(MakeKey(0)));
+    EXPECT_EQ(table.Size(), 32);
+    for (uint64_t i = 1; i < 64; i += 2) {
+        ASSERT_TRUE(table.Find(MakeKey(i), &value));
+        EXPECT_EQ(value, i == 7 ? 777 : i * 10);
+    }
+    EXPECT_FALSE(table.Find(MakeKey(2), &value));
+
+    // 反复插入删除不会因墓碑堆积而耗尽槽位
+    for (uint64_t i = 1000; i < 11000; ++i) {
+        ASSERT_TRUE(table.Insert(MakeKey(i), i));
+        ASSERT_TRUE(table.Erase(MakeKey(i)));
+    }
+    EXPECT_EQ(table.Size(), 32);
+}
+
+TEST(MediaDemuxerTest, FlowTableConcurrentReaders) {
+    avrtc::FlowTable table(1024);
+    const uint64_t kStable = 256;
+    for (uint64_t i = 0; i < kStable; ++i) {
+        table.Insert(MakeKey(i), i);
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> errors{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&]() {
+            uint64_t value;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (uint64_t i = 0; i < kStable; ++i) {
+                    if (!table.Find(MakeKey(i), &value) || value != i)
+                        errors.fetch_add(1);
+                }
+            }
+        });
+    }
+
+    // 写者不断增删其他键，读者必须始终看到稳定键的正确值
+    for (int round = 0; round < 200; ++round) {
+        for (uint64_t i = 10000; i < 10500; ++i) {
+            table.Insert(MakeKey(i), i);
+        }
+        for (uint64_t i = 10000; i < 10500; ++i) {
+            table.Erase(MakeKey(i));
+        }
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(errors.load(), 0);
+}
+
+TEST(MediaDemuxerTest, RouteBySsrcAndLearnFlow) {
+    auto router = std::make_shared<avrtc::MediaRouter>(1024);
+    avrtc::MediaDemuxer demuxer(router, avrtc::SocketAddress("127.0.0.1", 0));
+    ASSERT_GT(demuxer.GetSocket()->address_.GetPort(), 0);
+    router->AddSsrc(0xabcd, 42);
+
+    avrtc::EventLoop loop;
+    ASSERT_TRUE(demuxer.Attach(&loop));
+    std::vector<avrtc::MediaDemuxer::SessionId> routed;
+    int unknown = 0;
+    demuxer.SetOnPacket([&](avrtc::MediaDemuxer::SessionId id,
+                            avrtc::PacketKind kind, char*, size_t,
+                            const avrtc::SocketAddress&, int64_t arrival_ns) {
+        EXPECT_EQ(kind, avrtc::PacketKind::kRtp);
+        EXPECT_GT(arrival_ns, 0);
+        routed.push_back(id);
+    });
+    demuxer.SetOnUnknownFlow([&](avrtc::PacketKind kind, char*, size_t,
+                                 const avrtc::SocketAddress&) {
+        EXPECT_EQ(kind, avrtc::PacketKind::kStun);
+        ++unknown;
+    });
+
+    avrtc::UdpSocket peer(avrtc::SocketAddress("127.0.0.1", 0));
+    ASSERT_TRUE(peer.Bind());
+    const avrtc::SocketAddress& to = demuxer.GetSocket()->address_;
+    std::string rtp = MakeRtp(0xabcd);
+    std::string stun(20, '\0');
+    ASSERT_EQ(peer.SendTo(stun.data(), stun.size(), to), stun.size());
+    ASSERT_EQ(peer.SendTo(rtp.data(), rtp.size(), to), rtp.size());
+    while (routed.size() + unknown < 2) {
+        loop.RunOnce(100);
+    }
+    EXPECT_EQ(unknown, 1);
+    EXPECT_EQ(routed, (std::vector<avrtc::MediaDemuxer::SessionId>{42}));
+
+    // 第一个RTP包学到了5元组，之后即使SSRC未知也按5元组路由
+    avrtc::FiveTuple tuple(peer.address_, to);
+    avrtc::MediaDemuxer::SessionId id = 0;
+    EXPECT_TRUE(router->Route(tuple, avrtc::PacketKind::kRtp, nullptr, 0, &id));
+    EXPECT_EQ(id, 42);
+    std::string other = MakeRtp(0x1111);
+    ASSERT_EQ(peer.SendTo(other.data(), other.size(), to), other.size());
+    while (routed.size() < 2) {
+        loop.RunOnce(100);
+    }
+    EXPECT_EQ(routed.back(), 42);
+
+    // 删除SSRC后学到的5元组也一并删除
+    EXPECT_TRUE(router->RemoveSsrc(0xabcd));
+    EXPECT_FALSE(
+        router->Route(tuple, avrtc::PacketKind::kRtp, nullptr, 0, &id));
+
+    demuxer.Detach();
+}
+
+TEST(MediaDemuxerTest, LearnedFlowsPerSsrcAreBounded) {
+    avrtc::MediaRouter router(1024);
+    router.AddSsrc(0xabcd, 42);
+    std::string rtp = MakeRtp(0xabcd);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(rtp.data());
+    avrtc::SocketAddress local("127.0.0.1", 5000);
+    std::vector<avrtc::FiveTuple> tuples;
+    for (size_t i = 0; i <= avrtc::MediaRouter::kMaxLearnedFlows; ++i) {
+        avrtc::SocketAddress remote("10.0.0.1", 6000 + i);
+        tuples.emplace_back(remote, local);
+        avrtc::MediaRouter::SessionId id = 0;
+        EXPECT_TRUE(router.Route(tuples.back(), avrtc::PacketKind::kRtp, data,
+                                 rtp.size(), &id));
+        EXPECT_EQ(id, 42);
+    }
+
+    // 最早学到的5元组被淘汰，其余的仍可不带SSRC路由
+    avrtc::MediaRouter::SessionId id = 0;
+    EXPECT_FALSE(
+        router.Route(tuples[0], avrtc::PacketKind::kRtp, nullptr, 0, &id));
+    for (size_t i = 1; i < tuples.size(); ++i) {
+        EXPECT_TRUE(
+            router.Route(tuples[i], avrtc::PacketKind::kRtp, nullptr, 0, &id));
+    }
+
+    // 显式添加的5元组不随SSRC删除
+    router.AddFlow(tuples[1], 7);
+    router.RemoveSsrc(0xabcd);
+    EXPECT_TRUE(
+        router.Route(tuples[1], avrtc::PacketKind::kRtp, nullptr, 0, &id));
+    EXPECT_EQ(id, 7);
+    for (size_t i = 2; i < tuples.size(); ++i) {
+        EXPECT_FALSE(
+            router.Route(tuples[i], avrtc::PacketKind::kRtp, nullptr, 0, &id));
+    }
+}
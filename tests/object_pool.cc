@@ -0,0 +1,59 @@
+#include "base/object_pool.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+TEST(BlockPoolTest, ReuseFreedBlocks) {
+    avrtc::BlockPool pool(4);
+    std::vector<void*> blocks;
+    for (int i = 0; i < 6; ++i) {
+        blocks.push_back(pool.Allocate(40));
+    }
+    EXPECT_EQ(pool.GetBlockSize() % alignof(std::max_align_t), 0);
+    EXPECT_GE(pool.GetBlockSize(), 40);
+    EXPECT_EQ(std::set<void*>(blocks.begin(), blocks.end()).size(), 6);
+    EXPECT_EQ(pool.GetFreeCount(), 2);
+
+    // 后释放的块先被复用
+    pool.Deallocate(blocks[3], 40);
+    EXPECT_EQ(pool.Allocate(40), blocks[3]);
+
+    // 超过块大小的请求不走空闲链表
+    void* large = pool.Allocate(4096);
+    EXPECT_EQ(pool.GetFreeCount(), 2);
+    pool.Deallocate(large, 4096);
+    EXPECT_EQ(pool.GetFreeCount(), 2);
+
+    for (void* block : blocks) {
+        pool.Deallocate(block, 40);
+    }
+    EXPECT_EQ(pool.GetFreeCount(), 8);
+}
+
+TEST(BlockPoolTest, AllocateShared) {
+    auto pool = std::make_shared<avrtc::BlockPool>();
+    avrtc::PoolAllocator<std::string> allocator(pool);
+    auto first = std::allocate_shared<std::string>(allocator, "first");
+    const std::string* address = first.get();
+    size_t free_count = pool->GetFreeCount();
+    first.reset();
+    EXPECT_EQ(pool->GetFreeCount(), free_count + 1);
+
+    // 对象和控制块在同一个块中，释放后原地复用
+    auto second = std::allocate_shared<std::string>(allocator, "second");
+    EXPECT_EQ(second.get(), address);
+    EXPECT_EQ(*second, "second");
+
+    // 池在最后一个对象释放后才销毁
+    std::weak_ptr<avrtc::BlockPool> weak_pool = pool;
+    pool.reset();
+    allocator = avrtc::PoolAllocator<std::string>(nullptr);
+    EXPECT_FALSE(weak_pool.expired());
+    second.reset();
+    EXPECT_TRUE(weak_pool.expired());
+}
@@ -0,0 +1,55 @@
+#include "base/rate_limiter.h"
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+TEST(TokenBucketTest, BurstAndRefill) {
+    avrtc::TokenBucket bucket(10, 5);  // 每秒10个，最多积累5个
+    const int64_t kSecond = 1000000000;
+    for (int i = 0; i < 5; ++i)
+        EXPECT_TRUE(bucket.TryConsume(1, 0));
+    EXPECT_FALSE(bucket.TryConsume(1, 0));
+    EXPECT_EQ(bucket.GetWaitNs(1, 0), kSecond / 10);
+
+    EXPECT_TRUE(bucket.TryConsume(1, kSecond / 10));
+    EXPECT_FALSE(bucket.TryConsume(1, kSecond / 10));
+    // 长时间空闲后最多积累burst个
+    EXPECT_DOUBLE_EQ(bucket.GetTokens(100 * kSecond), 5);
+
+    // 无条件消耗可以形成欠额，补充的令牌先还欠额
+    bucket.Consume(15, 100 * kSecond);
+    EXPECT_DOUBLE_EQ(bucket.GetTokens(100 * kSecond), -10);
+    EXPECT_EQ(bucket.GetWaitNs(0, 100 * kSecond), kSecond);
+    EXPECT_FALSE(bucket.TryConsume(1, 100 * kSecond + kSecond / 2));
+
+    avrtc::TokenBucket unlimited;
+    EXPECT_FALSE(unlimited.IsLimited());
+    EXPECT_TRUE(unlimited.TryConsume(1e9, 0));
+}
+
+TEST(AdmissionControllerTest, ConnectionAndRoomLimits) {
+    using Role = avrtc::AdmissionController::Role;
+    avrtc::AdmissionController admission;
+    avrtc::AdmissionController::Limits limits;
+    limits.max_connections = 2;
+    limits.max_senders_per_room = 1;
+    admission.SetLimits(limits);
+
+    EXPECT_TRUE(admission.TryAdmitConnection());
+    EXPECT_TRUE(admission.TryAdmitConnection());
+    EXPECT_FALSE(admission.TryAdmitConnection());
+    admission.ReleaseConnection();
+    EXPECT_TRUE(admission.TryAdmitConnection());
+    EXPECT_EQ(admission.GetRejectedConnections(), 1);
+
+    EXPECT_TRUE(admission.TryJoin("a", Role::kSender));
+    EXPECT_FALSE(admission.TryJoin("a", Role::kSender));
+    EXPECT_TRUE(admission.TryJoin("b", Role::kSender));
+    // 接收者没有上限
+    for (int i = 0; i < 100; ++i)
+        EXPECT_TRUE(admission.TryJoin("a", Role::kReceiver));
+    EXPECT_EQ(admission.GetMemberCount("a", Role::kReceiver), 100);
+    admission.Leave("a", Role::kSender);
+    EXPECT_TRUE(admission.TryJoin("a", Role::kSender));
+    EXPECT_EQ(admission.GetRejectedJoins(), 1);
+}
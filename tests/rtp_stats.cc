@@ -0,0 +1,89 @@
+#include "base/rtp_stats.h"
+
+#include <cstdint>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const int64_t kMs = 1000000;
+const int64_t kBaseNs = 1700000000LL * 1000000000;
+
+}  // namespace
+
+TEST(RtpReceiveStatisticsTest, NoJitterForSteadyArrival) {
+    avrtc::RtpReceiveStatistics stats(90000);
+    // 每20ms一帧，RTP时间戳每帧增加1800，跨过32位回绕
+    uint32_t timestamp = 0xffffffff - 3600;
+    for (int i = 0; i < 100; ++i) {
+        stats.OnPacket(65530 + i, timestamp, 1000, kBaseNs + i * 20 * kMs);
+        timestamp += 1800;
+    }
+    EXPECT_EQ(stats.GetJitter(), 0);
+    EXPECT_EQ(stats.GetPacketsReceived(), 100);
+    EXPECT_EQ(stats.GetPacketsLost(), 0);
+    // 序号从65530回绕到93
+    EXPECT_EQ(stats.GetExtendedHighestSequence(), (1u << 16) + 93);
+}
+
+TEST(RtpReceiveStatisticsTest, JitterConvergesToDeviation) {
+    avrtc::RtpReceiveStatistics stats(90000);
+    // 到达时间交替提前和推迟5ms，相邻包的传输时间差为10ms（900个时间戳单位）
+    for (int i = 0; i < 500; ++i) {
+        int64_t offset = (i % 2 == 0 ? 5 : -5) * kMs;
+        stats.OnPacket(i, i * 1800, 1000, kBaseNs + i * 20 * kMs + offset);
+    }
+    EXPECT_NEAR(stats.GetJitter(), 900, 1);
+    EXPECT_NEAR(stats.GetJitterMs(), 10.0, 0.1);
+}
+
+TEST(RtpReceiveStatisticsTest, LossAndReorder) {
+    avrtc::RtpReceiveStatistics stats(90000);
+    for (uint16_t seq : {1, 2, 4, 3, 7, 8}) {
+        stats.OnPacket(seq, seq * 1800, 100, kBaseNs + seq * 20 * kMs);
+    }
+    // 期望1~8共8个包，收到6个
+    EXPECT_EQ(stats.GetPacketsLost(), 2);
+    EXPECT_EQ(stats.GetExtendedHighestSequence(), 8);
+}
+
+TEST(RtpReceiveStatisticsTest, BitrateWindow) {
+    avrtc::RtpReceiveStatistics stats(90000, 1000);
+    // 每10ms一个1250字节的包，即1Mbps
+    for (int i = 0; i < 200; ++i) {
+        stats.OnPacket(i, i * 900, 1250, kBaseNs + i * 10 * kMs);
+    }
+    int64_t now = kBaseNs + 199 * 10 * kMs;
+    EXPECT_EQ(stats.GetBitrateBps(now), 1000000);
+    // 窗口滑过之后码率回落为0
+    EXPECT_EQ(stats.GetBitrateBps(now + 1000 * kMs), 0);
+}
+
+TEST(RtpReceiveStatisticsTest, SequenceJumpNeedsTwoConsecutivePackets) {
+    avrtc::RtpReceiveStatistics stats(90000);
+    for (uint16_t seq = 100; seq < 110; ++seq) {
+        stats.OnPacket(seq, seq * 1800, 100, kBaseNs + seq * 20 * kMs);
+    }
+    // 单个跳变的包被丢弃，不影响已有的统计
+    stats.OnPacket(40000, 0, 100, kBaseNs + 110 * 20 * kMs);
+    stats.OnPacket(110, 110 * 1800, 100, kBaseNs + 110 * 20 * kMs);
+    EXPECT_EQ(stats.GetPacketsReceived(), 11);
+    EXPECT_EQ(stats.GetPacketsLost(), 0);
+    EXPECT_EQ(stats.GetExtendedHighestSequence(), 110);
+
+    // 落后超过kMaxMisorder的包同样按跳变处理
+    stats.OnPacket(5, 5 * 1800, 100, kBaseNs + 111 * 20 * kMs);
+    EXPECT_EQ(stats.GetPacketsReceived(), 11);
+    // 落后不超过kMaxMisorder的包是乱序或重复
+    stats.OnPacket(60, 60 * 1800, 100, kBaseNs + 111 * 20 * kMs);
+    EXPECT_EQ(stats.GetPacketsReceived(), 12);
+    EXPECT_EQ(stats.GetExtendedHighestSequence(), 110);
+
+    // 连续两个相接的跳变包，从新序号重新统计
+    stats.OnPacket(40000, 0, 100, kBaseNs + 112 * 20 * kMs);
+    stats.OnPacket(40001, 1800, 100, kBaseNs + 113 * 20 * kMs);
+    EXPECT_EQ(stats.GetPacketsReceived(), 1);
+    EXPECT_EQ(stats.GetExtendedHighestSequence(), 40001);
+    EXPECT_EQ(stats.GetPacketsLost(), 0);
+}
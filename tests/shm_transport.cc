@@ -0,0 +1,131 @@
+#include "base/shm_transport.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/event_loop.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+TEST(ShmRingTest, WrapAroundAndFull) {
+    const size_t capacity = 4096;
+    void* region = aligned_alloc(64, avrtc::ShmRing::GetRegionSize(capacity));
+    avrtc::ShmRing::Initialize(region, capacity);
+    avrtc::ShmRing producer(region);
+    avrtc::ShmRing consumer(region);
+
+    // 不同长度的记录反复写满读空，覆盖各种回绕位置
+    int next_write = 0;
+    int next_read = 0;
+    for (int round = 0; round < 50; ++round) {
+        for (;;) {
+            std::string message(next_write % 300 + 1, 'a' + next_write % 26);
+            if (!producer.Write(message.data(), message.size()))
+                break;
+            ++next_write;
+        }
+        EXPECT_FALSE(producer.Write("x", producer.GetMaxRecordSize() + 1));
+        consumer.Read(
+            [&](char* data, size_t length) {
+                EXPECT_EQ(length, next_read % 300 + 1);
+                EXPECT_EQ(data[0], 'a' + next_read % 26);
+                EXPECT_EQ(data[length - 1], 'a' + next_read % 26);
+                ++next_read;
+            },
+            1000);
+        EXPECT_EQ(next_read, next_write);
+        EXPECT_TRUE(consumer.Empty());
+    }
+    EXPECT_GT(next_write, 50 * 4096 / 304);
+    free(region);
+}
+
+TEST(ShmTransportTest, DeliverAcrossMappings) {
+    auto producer = avrtc::ShmTransport::Create(64 * 1024);
+    ASSERT_NE(producer, nullptr);
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    ASSERT_TRUE(producer->SendDescriptors(sockets[0]));
+    auto consumer = avrtc::ShmTransport::ReceiveDescriptors(sockets[1]);
+    ASSERT_NE(consumer, nullptr);
+    close(sockets[0]);
+    close(sockets[1]);
+
+    const int kMessages = 20000;
+    avrtc::EventLoop loop;
+    int received = 0;
+    consumer->SetOnReceive([&](std::shared_ptr<avrtc::ShmTransport>,
+                               char* buffer, size_t length) {
+        ASSERT_EQ(length, sizeof(int) + received % 1000);
+        int sequence;
+        memcpy(&sequence, buffer, sizeof(sequence));
+        EXPECT_EQ(sequence, received);
+        if (++received == kMessages)
+            loop.Stop();
+    });
+    ASSERT_TRUE(consumer->Attach(&loop));
+
+    // 生产者比消费者快时环会写满，重试直到写入，验证不丢、不乱序
+    std::thread writer([&]() {
+        std::vector<char> message(sizeof(int) + 1000);
+        for (int i = 0; i < kMessages; ++i) {
+            memcpy(message.data(), &i, sizeof(i));
+            size_t length = sizeof(int) + i % 1000;
+            while (producer->Send(message.data(), length) < 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    loop.Run();
+    writer.join();
+    consumer->Detach();
+
+    EXPECT_EQ(received, kMessages);
+}
+
+TEST(ShmRingTest, RejectsCorruptedRecords) {
+    const size_t capacity = 4096;
+    void* region = aligned_alloc(64, avrtc::ShmRing::GetRegionSize(capacity));
+    avrtc::ShmRing::Initialize(region, capacity);
+    avrtc::ShmRing producer(region);
+    avrtc::ShmRing consumer(region, capacity);
+    char* data = static_cast<char*>(region) + sizeof(avrtc::ShmRing::Header);
+
+    // 生产者写入的长度超出数据区，消费者不回调并停止读取
+    ASSERT_TRUE(producer.Write("abcd", 4));
+    uint32_t length = capacity;
+    memcpy(data, &length, sizeof(length));
+    int delivered = 0;
+    auto count = [&](char*, size_t) { ++delivered; };
+    EXPECT_EQ(consumer.Read(count, 10), 0u);
+    EXPECT_TRUE(consumer.IsBroken());
+    EXPECT_EQ(delivered, 0);
+
+    // 长度在数据区内，但记录越过了已经发布的head
+    avrtc::ShmRing::Initialize(region, capacity);
+    avrtc::ShmRing producer2(region);
+    avrtc::ShmRing consumer2(region, capacity);
+    ASSERT_TRUE(producer2.Write("abcd", 4));
+    length = 100;
+    memcpy(data, &length, sizeof(length));
+    EXPECT_EQ(consumer2.Read(count, 10), 0u);
+    EXPECT_TRUE(consumer2.IsBroken());
+    EXPECT_EQ(delivered, 0);
+    free(region);
+}
+
+TEST(ShmTransportTest, OpenRejectsShortMemory) {
+    auto producer = avrtc::ShmTransport::Create(64 * 1024);
+    ASSERT_NE(producer, nullptr);
+    // 头部有效但文件被截短，映射后访问会产生SIGBUS
+    int mem_fd = dup(producer->GetMemFD());
+    ASSERT_EQ(ftruncate(mem_fd, 8192), 0);
+    EXPECT_EQ(avrtc::ShmTransport::Open(mem_fd, dup(producer->GetEventFD())),
+              nullptr);
+}
@@ -0,0 +1,530 @@
+#include "base/socket.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// 把socketpair的一端包装成非阻塞的SessionSocket，并加入事件循环
+std::shared_ptr<avrtc::SessionSocket> MakeSession(int fd,
+                                                  avrtc::EventLoop* loop) {
+    auto session = std::make_shared<avrtc::SessionSocket>(
+        avrtc::SocketAddress("127.0.0.1", 0));
+    session->Close();
+    session->SetFD(fd);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    avrtc::SessionSocket* raw = session.get();
+    loop->AddFD(fd, EPOLLIN, [raw](uint32_t events) {
+        if (events & EPOLLOUT)
+            raw->HandleWrite();
+    });
+    session->AttachLoop(loop);
+    return session;
+}
+
+size_t DrainPeer(int fd) {
+    size_t total = 0;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        total += n;
+    }
+    return total;
+}
+
+// 等待条件成立，最多等待1秒
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+    for (int i = 0; i < 1000 && !predicate(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return predicate();
+}
+
+int ConnectTo(const avrtc::SocketAddress& address) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, address.GetSockAddr(), address.GetSockLen()) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}  // namespace
+
+TEST(SessionSocketTest, SendQueueWatermarks) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    avrtc::EventLoop loop;
+    auto session = MakeSession(fds[0], &loop);
+
+    avrtc::SessionSocket::SendQueueOptions options;
+    options.low_watermark = 16 * 1024;
+    options.high_watermark = 256 * 1024;
+    options.max_queued_bytes = 8 * 1024 * 1024;
+    session->SetSendQueueOptions(options);
+
+    int high_count = 0;
+    int low_count = 0;
+    session->SetOnHighWatermark(
+        [&](std::shared_ptr<avrtc::SessionSocket>, size_t) { ++high_count; });
+    session->SetOnLowWatermark(
+        [&](std::shared_ptr<avrtc::SessionSocket>, size_t) { ++low_count; });
+
+    // 对端不读，积压直到越过高水位
+    auto message = std::make_shared<const std::string>(16 * 1024, 'x');
+    size_t sent = 0;
+    while (!session->IsBackpressured()) {
+        ASSERT_EQ(session->Send(message), message->size());
+        sent += avrtc::FrameCodec::kHeaderSize + message->size();
+        ASSERT_LT(sent, options.max_queued_bytes);
+    }
+    EXPECT_EQ(high_count, 1);
+    EXPECT_GE(session->GetQueuedBytes(), options.high_watermark);
+
+    // 对端读走数据后，EPOLLOUT驱动队列清空并通知低水位
+    size_t received = 0;
+    while (session->GetQueuedBytes() > 0) {
+        received += DrainPeer(fds[1]);
+        loop.RunOnce(100);
+    }
+    received += DrainPeer(fds[1]);
+    EXPECT_EQ(received, sent);
+    EXPECT_EQ(low_count, 1);
+    EXPECT_FALSE(session->IsBackpressured());
+
+    loop.RemoveFD(fds[0]);
+    close(fds[1]);
+}
+
+TEST(SessionSocketTest, SendQueueOverflowPolicy) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    avrtc::EventLoop loop;
+    auto session = MakeSession(fds[0], &loop);
+
+    avrtc::SessionSocket::SendQueueOptions options;
+    options.max_queued_bytes = 1024 * 1024;
+    options.overflow_policy =
+        avrtc::SessionSocket::OverflowPolicy::kDropNewest;
+    session->SetSendQueueOptions(options);
+
+    auto message = std::make_shared<const std::string>(64 * 1024, 'x');
+    int result = 0;
+    for (int i = 0; i < 1024 && result >= 0; ++i) {
+        result = session->Send(message);
+    }
+    EXPECT_EQ(result, -1);
+    EXPECT_LE(session->GetQueuedBytes(), options.max_queued_bytes);
+
+    // 丢弃策略下连接仍然可用
+    DrainPeer(fds[1]);
+    EXPECT_TRUE(session->HandleWrite());
+
+    loop.RemoveFD(fds[0]);
+    close(fds[1]);
+}
+
+TEST(SessionSocketTest, SendFromOtherThread) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    avrtc::EventLoop loop;
+    auto session = MakeSession(fds[0], &loop);
+    // 事件循环同时注册新的fd，fd表扩容和其他线程的发送并发
+    std::vector<int> extra_fds;
+    auto timer = loop.RunEvery(1, [&]() {
+        int fd = eventfd(0, EFD_NONBLOCK);
+        loop.AddFD(fd, EPOLLIN, [](uint32_t) {});
+        extra_fds.push_back(fd);
+    });
+    std::thread loop_thread([&loop]() { loop.Run(); });
+
+    // 生产者线程发送得比对端读取快，EPOLLOUT由事件循环线程打开
+    const int kMessages = 256;
+    auto message = std::make_shared<const std::string>(16 * 1024, 'x');
+    std::thread producer([&]() {
+        for (int i = 0; i < kMessages; ++i) {
+            EXPECT_EQ(session->Send(message), message->size());
+        }
+    });
+    size_t expected =
+        kMessages * (avrtc::FrameCodec::kHeaderSize + message->size());
+    size_t received = 0;
+    EXPECT_TRUE(WaitFor([&]() {
+        received += DrainPeer(fds[1]);
+        return received == expected;
+    }));
+    producer.join();
+    EXPECT_TRUE(WaitFor([&]() { return session->GetQueuedBytes() == 0; }));
+
+    loop.Stop();
+    loop_thread.join();
+    loop.CancelTimer(timer);
+    for (int fd : extra_fds) {
+        loop.RemoveFD(fd);
+        close(fd);
+    }
+    loop.RemoveFD(fds[0]);
+    close(fds[1]);
+}
+
+TEST(SessionSocketTest, ReceiveRateLimit) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    avrtc::EventLoop loop;
+    auto session = MakeSession(fds[0], &loop);
+    int received = 0;
+    session->SetOnReceive(
+        [&](std::shared_ptr<avrtc::SessionSocket>, char*, size_t) {
+            ++received;
+        });
+
+    // 突发5条之后暂停读取，其余的消息按速率交付，不会丢弃
+    avrtc::SessionSocket::RateLimitOptions options;
+    options.messages_per_sec = 100;
+    options.message_burst = 5;
+    session->SetRateLimit(options);
+    std::string frames;
+    for (int i = 0; i < 20; ++i)
+        frames += avrtc::FrameCodec::Encode("message");
+    ASSERT_EQ(send(fds[1], frames.data(), frames.size(), 0), frames.size());
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(session->Recv());
+    EXPECT_EQ(received, 5);
+    EXPECT_TRUE(session->IsReadPaused());
+    while (received < 20)
+        loop.RunOnce(100);
+    EXPECT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(140));
+    EXPECT_FALSE(session->IsReadPaused());
+
+    // 字节超出突发量后暂停读取，按速率还清欠额后恢复
+    options = avrtc::SessionSocket::RateLimitOptions();
+    options.bytes_per_sec = 100 * 1000;
+    options.byte_burst = 1000;
+    session->SetRateLimit(options);
+    std::string large = avrtc::FrameCodec::Encode(std::string(10000, 'x'));
+    ASSERT_EQ(send(fds[1], large.data(), large.size(), 0), large.size());
+    start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(session->Recv());
+    EXPECT_TRUE(session->IsReadPaused());
+    while (session->IsReadPaused())
+        loop.RunOnce(100);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(85));
+    EXPECT_EQ(received, 21);
+
+    loop.RemoveFD(fds[0]);
+    close(fds[1]);
+}
+
+TEST(SessionSocketTest, RateLimitedMessagesDeliveredBeforeClose) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    avrtc::EventLoop loop;
+    auto session = MakeSession(fds[0], &loop);
+    std::vector<std::string> received;
+    bool closed = false;
+    session->SetOnReceive([&](std::shared_ptr<avrtc::SessionSocket>,
+                              char* data, size_t length) {
+        received.emplace_back(data, length);
+    });
+    session->SetOnClose(
+        [&](std::shared_ptr<avrtc::SessionSocket>) { closed = true; });
+
+    avrtc::SessionSocket::RateLimitOptions options;
+    options.messages_per_sec = 1;
+    options.message_burst = 1;
+    session->SetRateLimit(options);
+    std::string frames = avrtc::FrameCodec::Encode("Add") +
+                         avrtc::FrameCodec::Encode("Update") +
+                         avrtc::FrameCodec::Encode("Close");
+    ASSERT_EQ(send(fds[1], frames.data(), frames.size(), 0), frames.size());
+    EXPECT_FALSE(session->Recv());
+    EXPECT_EQ(received, (std::vector<std::string>{"Add"}));
+
+    // 对端关闭时，限速留在缓冲区中的消息在OnClose之前全部交付
+    shutdown(fds[1], SHUT_WR);
+    EXPECT_TRUE(session->Recv());
+    EXPECT_EQ(received,
+              (std::vector<std::string>{"Add", "Update", "Close"}));
+    EXPECT_TRUE(closed);
+
+    loop.RemoveFD(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ServerSocketTest, RejectOverConnectionLimit) {
+    avrtc::ServerSocket server(avrtc::SocketAddress("127.0.0.1", 0));
+    avrtc::AdmissionController::Limits limits;
+    limits.max_connections = 2;
+    server.GetAdmission()->SetLimits(limits);
+    std::atomic<int> accepted{0};
+    server.SetOnAccept(
+        [&](std::shared_ptr<avrtc::SessionSocket>) { ++accepted; });
+    std::thread server_thread([&]() { server.Start(); });
+
+    std::vector<int> fds;
+    for (int i = 0; i < 3; ++i) {
+        int fd = ConnectTo(server.address_);
+        ASSERT_NE(fd, -1);
+        fds.push_back(fd);
+    }
+    // 超出上限的连接被服务器直接关闭，读到EOF
+    char c;
+    EXPECT_EQ(recv(fds[2], &c, 1, 0), 0);
+    EXPECT_EQ(accepted, 2);
+
+    // 释放一个连接后可以再次接入
+    close(fds[0]);
+    ASSERT_TRUE(WaitFor([&]() {
+        int fd = ConnectTo(server.address_);
+        bool admitted = recv(fd, &c, 1, MSG_DONTWAIT) < 0 &&
+                        WaitFor([&]() { return accepted == 3; });
+        close(fd);
+        return admitted;
+    }));
+
+    server.Stop();
+    server_thread.join();
+    for (int fd : {fds[1], fds[2]})
+        close(fd);
+}
+
+TEST(ServerSocketTest, AcceptEchoAndReuseFd) {
+    avrtc::ServerSocket server(avrtc::SocketAddress("127.0.0.1", 0));
+    ASSERT_GT(server.address_.GetPort(), 0);
+    std::atomic<int> accepted{0};
+    std::atomic<int> closed{0};
+    server.SetOnAccept([&](std::shared_ptr<avrtc::SessionSocket> socket) {
+        ++accepted;
+        socket->SetOnReceive([](std::shared_ptr<avrtc::SessionSocket> socket,
+                                char* buffer, size_t length) {
+            socket->Send(buffer, length);
+        });
+        socket->SetOnClose(
+            [&](std::shared_ptr<avrtc::SessionSocket>) { ++closed; });
+    });
+    std::thread server_thread([&]() { server.Start(); });
+
+    // 两轮连接，第二轮复用第一轮释放的fd
+    const int kClients = 16;
+    for (int round = 1; round <= 2; ++round) {
+        std::vector<int> fds;
+        for (int i = 0; i < kClients; ++i) {
+            int fd = ConnectTo(server.address_);
+            ASSERT_NE(fd, -1);
+            fds.push_back(fd);
+        }
+        ASSERT_TRUE(WaitFor([&]() { return accepted == round * kClients; }));
+
+        for (int fd : fds) {
+            std::string frame = avrtc::FrameCodec::Encode("ping");
+            ASSERT_EQ(send(fd, frame.data(), frame.size(), 0), frame.size());
+            std::string echo(frame.size(), '\0');
+            ASSERT_EQ(recv(fd, &echo[0], echo.size(), MSG_WAITALL),
+                      echo.size());
+            EXPECT_EQ(echo, frame);
+            close(fd);
+        }
+        ASSERT_TRUE(WaitFor([&]() { return closed == round * kClients; }));
+    }
+
+    server.Stop();
+    server_thread.join();
+}
+
+TEST(ClientSocketTest, ConnectAsyncOnSharedLoop) {
+    avrtc::ServerSocket server(avrtc::SocketAddress("127.0.0.1", 0));
+    server.SetOnAccept([](std::shared_ptr<avrtc::SessionSocket> socket) {
+        socket->SetOnReceive([](std::shared_ptr<avrtc::SessionSocket> socket,
+                                char* buffer, size_t length) {
+            socket->Send(buffer, length);
+        });
+    });
+    std::thread server_thread([&]() { server.Start(); });
+
+    // 所有客户端共享一个事件循环
+    const int kClients = 64;
+    avrtc::EventLoop loop;
+    std::vector<std::shared_ptr<avrtc::ClientSocket>> clients;
+    int connected = 0;
+    int echoed = 0;
+    for (int i = 0; i < kClients; ++i) {
+        auto client = std::make_shared<avrtc::ClientSocket>(server.address_);
+        avrtc::ClientSocket* raw = client.get();
+        client->SetOnConnected([&, raw]() {
+            ++connected;
+            EXPECT_EQ(raw->GetState(), avrtc::ClientSocket::State::kConnected);
+            raw->Send(std::string("ping"));
+        });
+        client->SetOnReceive(
+            [&](std::shared_ptr<avrtc::SessionSocket>, char* buffer,
+                size_t length) {
+                EXPECT_EQ(std::string(buffer, length), "ping");
+                ++echoed;
+            });
+        client->ConnectAsync(&loop);
+        clients.push_back(client);
+    }
+    for (int i = 0; i < 1000 && echoed < kClients; ++i) {
+        loop.RunOnce(10);
+    }
+    EXPECT_EQ(connected, kClients);
+    EXPECT_EQ(echoed, kClients);
+
+    for (auto& client : clients) {
+        client->Stop();
+    }
+    loop.RunOnce(0);
+    for (auto& client : clients) {
+        EXPECT_EQ(client->GetState(),
+                  avrtc::ClientSocket::State::kDisconnected);
+        EXPECT_EQ(client->GetFD(), -1);
+    }
+    server.Stop();
+    server_thread.join();
+}
+
+TEST(ClientSocketTest, ReconnectWithBackoff) {
+    // 取一个当前没有监听的端口
+    int probe = socket(AF_INET, SOCK_STREAM, 0);
+    avrtc::SocketAddress address("127.0.0.1", 0);
+    ASSERT_EQ(bind(probe, address.GetSockAddr(), address.GetSockLen()), 0);
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    getsockname(probe, (struct sockaddr*)&local, &len);
+    close(probe);
+    address = avrtc::SocketAddress(local);
+
+    avrtc::EventLoop loop;
+    auto client = std::make_shared<avrtc::ClientSocket>(address);
+    avrtc::ClientSocket::ConnectOptions options;
+    options.reconnect = true;
+    options.initial_backoff_ms = 10;
+    options.max_backoff_ms = 40;
+    client->SetConnectOptions(options);
+
+    std::vector<std::chrono::steady_clock::time_point> failures;
+    client->SetOnConnectFailed([&](int error) {
+        EXPECT_EQ(error, ECONNREFUSED);
+        failures.push_back(std::chrono::steady_clock::now());
+    });
+    client->ConnectAsync(&loop);
+    while (failures.size() < 4) {
+        loop.RunOnce(100);
+    }
+    client->Stop();
+    loop.RunOnce(0);
+    EXPECT_EQ(client->GetState(), avrtc::ClientSocket::State::kDisconnected);
+
+    // 退避时间10、20、40ms，每次至少等待一半
+    auto gap = [&](int i) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   failures[i] - failures[i - 1])
+            .count();
+    };
+    EXPECT_GE(gap(1), 5);
+    EXPECT_GE(gap(2), 10);
+    EXPECT_GE(gap(3), 20);
+}
+
+TEST(ClientSocketTest, BlockingConnectStopsFromOtherThread) {
+    avrtc::ServerSocket server(avrtc::SocketAddress("127.0.0.1", 0));
+    std::thread server_thread([&]() { server.Start(); });
+
+    auto client = std::make_shared<avrtc::ClientSocket>(server.address_);
+    std::atomic<bool> connected{false};
+    client->SetOnConnected([&]() { connected = true; });
+    std::thread client_thread([&]() { client->Connect(); });
+    ASSERT_TRUE(WaitFor([&]() { return connected.load(); }));
+
+    // Connect()在事件循环中等待数据，Stop()可以让它返回
+    client->Stop();
+    client_thread.join();
+    EXPECT_EQ(client->GetFD(), -1);
+
+    server.Stop();
+    server_thread.join();
+}
+
+TEST(UdpSocketTest, RecvBatchWithKernelTimestamps) {
+    avrtc::UdpSocket sender(avrtc::SocketAddress("127.0.0.1", 0));
+    avrtc::UdpSocket receiver(avrtc::SocketAddress("127.0.0.1", 0));
+    ASSERT_TRUE(sender.Bind());
+    ASSERT_TRUE(receiver.Bind());
+    receiver.SetNonBlocking();
+    ASSERT_TRUE(receiver.EnableReceiveTimestamps(
+        avrtc::UdpSocket::TimestampMode::kSoftware));
+    // 进程中第一次开启时间戳时，内核延迟打开全局的打时间戳开关，
+    // 在此之前到达的数据报只能在读取时补打时间戳
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    for (int i = 0; i < 3; ++i) {
+        std::string datagram(100 + i, 'a' + i);
+        ASSERT_EQ(sender.SendTo(datagram.data(), datagram.size(),
+                                receiver.address_),
+                  datagram.size());
+    }
+    // 延迟读取，内核时间戳仍然是数据报到达的时间
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    const int kMaxCount = 8;
+    const size_t kDatagramSize = 2048;
+    std::vector<char> buffer(kMaxCount * kDatagramSize);
+    avrtc::UdpSocket::Datagram datagrams[kMaxCount];
+    int count = receiver.RecvBatch(buffer.data(), kDatagramSize, datagrams,
+                                   kMaxCount);
+    ASSERT_EQ(count, 3);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t now_ns = static_cast<int64_t>(now.tv_sec) * 1000000000 +
+                     now.tv_nsec;
+    for (int i = 0; i < count; ++i) {
+        EXPECT_EQ(datagrams[i].length, 100 + i);
+        EXPECT_EQ(datagrams[i].data[0], 'a' + i);
+        EXPECT_EQ(datagrams[i].from.GetPort(), sender.address_.GetPort());
+        EXPECT_GE(now_ns - datagrams[i].arrival_ns, 40 * 1000000);
+    }
+    EXPECT_EQ(receiver.RecvBatch(buffer.data(), kDatagramSize, datagrams,
+                                 kMaxCount),
+              -1);
+    EXPECT_EQ(errno, EAGAIN);
+}
+
+TEST(UdpSocketTest, HardwareModeKeepsRealtimeArrival) {
+    avrtc::UdpSocket sender(avrtc::SocketAddress("127.0.0.1", 0));
+    avrtc::UdpSocket receiver(avrtc::SocketAddress("127.0.0.1", 0));
+    ASSERT_TRUE(sender.Bind());
+    ASSERT_TRUE(receiver.Bind());
+    receiver.SetNonBlocking();
+    ASSERT_TRUE(receiver.EnableReceiveTimestamps(
+        avrtc::UdpSocket::TimestampMode::kHardware));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    ASSERT_EQ(sender.SendTo("x", 1, receiver.address_), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    char buffer[2048];
+    avrtc::UdpSocket::Datagram datagram;
+    ASSERT_EQ(receiver.RecvBatch(buffer, sizeof(buffer), &datagram, 1), 1);
+
+    // 到达时间总是CLOCK_REALTIME，回环接口没有硬件时间戳
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t now_ns = static_cast<int64_t>(now.tv_sec) * 1000000000 +
+                     now.tv_nsec;
+    EXPECT_GE(now_ns - datagram.arrival_ns, 40 * 1000000);
+    EXPECT_LT(now_ns - datagram.arrival_ns, 10 * 1000000000LL);
+    EXPECT_EQ(datagram.hardware_ns, 0);
+}
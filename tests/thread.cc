@@ -0,0 +1,712 @@
+#include "base/thread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/event_loop.h"
+#include "base/mpsc_queue.h"
+#include "base/task.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+TEST(MpscQueueTest, MultiProducerKeepsPerProducerOrder) {
+    avrtc::MpscQueue<uint64_t> queue;
+    const int kProducers = 4;
+    const uint64_t kPerProducer = 100000;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (uint64_t i = 0; i < kPerProducer; ++i)
+                queue.Push(static_cast<uint64_t>(p) << 32 | i);
+        });
+    }
+
+    std::vector<uint64_t> next(kProducers, 0);
+    uint64_t total = 0;
+    while (total < kProducers * kPerProducer) {
+        uint64_t value;
+        if (!queue.Pop(&value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int producer = static_cast<int>(value >> 32);
+        ASSERT_EQ(value & 0xffffffff, next[producer]);
+        ++next[producer];
+        ++total;
+    }
+    for (auto& producer : producers)
+        producer.join();
+    EXPECT_TRUE(queue.Empty());
+}
+
+TEST(MpscQueueTest, DestroysRemainingElements) {
+    auto counter = std::make_shared<int>(0);
+    {
+        avrtc::MpscQueue<std::shared_ptr<int>> queue;
+        for (int i = 0; i < 100; ++i)
+            queue.Push(counter);
+        std::shared_ptr<int> value;
+        ASSERT_TRUE(queue.Pop(&value));
+        EXPECT_EQ(counter.use_count(), 101);
+    }
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(TaskTest, SmallCapturesStayInline) {
+    auto shared = std::make_shared<int>(42);
+    int result = 0;
+    avrtc::MpscQueue<avrtc::Task> queue;
+
+    // 捕获指针、shared_ptr和几个整数的lambda直接存放在Task内部
+    auto make = [&](int i) {
+        return [shared, &result, i, j = i * 2, k = i * 3]() {
+            result += *shared + i + j + k;
+        };
+    };
+    EXPECT_TRUE(avrtc::Task::FitsInline<decltype(make(0))>());
+    for (int i = 0; i < 10; ++i) {
+        queue.Push(make(i));
+    }
+    EXPECT_EQ(shared.use_count(), 11);
+    avrtc::Task task;
+    while (queue.Pop(&task))
+        task();
+    EXPECT_EQ(result, 42 * 10 + 45 * 6);
+    task.Reset();
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(TaskTest, MoveOnlyAndLargeCaptures) {
+    auto owned = std::make_unique<int>(7);
+    int result = 0;
+    avrtc::Task move_only([p = std::move(owned), &result]() { result = *p; });
+    avrtc::Task moved = std::move(move_only);
+    EXPECT_FALSE(move_only);
+    moved();
+    EXPECT_EQ(result, 7);
+
+    // 超过内联大小的可调用对象放到堆上，移动时只移动指针
+    struct Large {
+        char data[128];
+    };
+    Large large;
+    large.data[127] = 9;
+    EXPECT_FALSE(avrtc::Task::FitsInline<Large>());
+    avrtc::Task heap([large, &result]() { result = large.data[127]; });
+    avrtc::Task heap_moved = std::move(heap);
+    heap_moved();
+    EXPECT_EQ(result, 9);
+}
+
+namespace {
+void IncrementCounter() {
+    static int counter = 0;
+    ++counter;
+}
+}  // namespace
+
+TEST(TaskTest, EmptyCallablesMakeEmptyTasks) {
+    std::function<void()> empty_function;
+    EXPECT_FALSE(avrtc::Task(empty_function));
+    EXPECT_FALSE(avrtc::Task(std::function<void()>()));
+    void (*null_pointer)() = nullptr;
+    EXPECT_FALSE(avrtc::Task(null_pointer));
+
+    int result = 0;
+    std::function<void()> function = [&result]() { result = 1; };
+    avrtc::Task from_function(function);
+    ASSERT_TRUE(from_function);
+    from_function();
+    EXPECT_EQ(result, 1);
+    EXPECT_TRUE(avrtc::Task(IncrementCounter));
+    EXPECT_TRUE(avrtc::Task(&IncrementCounter));
+    // 不带捕获的lambda可以转换成函数指针，但不是可能为空的类型
+    EXPECT_TRUE(avrtc::Task([]() {}));
+
+    // 投递空任务不会在线程中调用空的std::function
+    avrtc::Thread thread;
+    thread.AddTask(std::function<void()>());
+    thread.AddTask([&]() { thread.Stop(); });
+    thread.Join();
+}
+
+TEST(ThreadTest, TasksRunInOrderAcrossParking) {
+    avrtc::Thread thread;
+    std::atomic<int> executed{0};
+    std::vector<int> order;
+    for (int i = 0; i < 1000; ++i) {
+        thread.AddTask([&, i]() {
+            order.push_back(i);
+            ++executed;
+        });
+        // 间隔投递，让工作线程反复进入睡眠再被唤醒
+        if (i % 100 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    thread.AddTask([&]() { thread.Stop(); });
+    thread.Join();
+
+    ASSERT_EQ(executed, 1000);
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_EQ(order[i], i);
+}
+
+TEST(ThreadTest, DelayedTasksRunInDeadlineOrder) {
+    avrtc::Thread thread;
+    std::vector<int> order;
+    std::atomic<bool> finished{false};
+    int64_t start = avrtc::EventLoop::NowNs();
+    int64_t elapsed_ns = 0;
+    thread.PostDelayedTask(30, [&]() { order.push_back(3); });
+    thread.PostDelayedTask(10, [&]() { order.push_back(1); });
+    thread.PostDelayedTask(20, [&]() { order.push_back(2); });
+    avrtc::TaskHandle cancelled =
+        thread.PostDelayedTask(15, [&]() { order.push_back(-1); });
+    cancelled.Cancel();
+    EXPECT_TRUE(cancelled.IsCancelled());
+    thread.PostDelayedTask(40, [&]() {
+        elapsed_ns = avrtc::EventLoop::NowNs() - start;
+        finished = true;
+    });
+    // 普通任务不受延迟任务影响，立即执行
+    thread.AddTask([&]() { order.push_back(0); });
+    while (!finished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    thread.AddTask([&]() { thread.Stop(); });
+    thread.Join();
+
+    EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3}));
+    EXPECT_GE(elapsed_ns, 40 * 1000000);
+}
+
+TEST(ThreadTest, RepeatingTaskRunsUntilCancelled) {
+    avrtc::Thread thread;
+    std::atomic<int> runs{0};
+    avrtc::TaskHandle handle;
+    handle = thread.PostRepeatingTask(5, [&]() { ++runs; });
+    while (runs < 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    handle.Cancel();
+    // 取消之后最多还有一次已经开始的执行
+    int after_cancel = runs;
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_LE(runs, after_cancel + 1);
+    thread.AddTask([&]() { thread.Stop(); });
+    thread.Join();
+}
+
+TEST(ThreadTest, CancelReleasesClosureImmediately) {
+    avrtc::Thread thread;
+    auto resource = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = resource;
+    avrtc::TaskHandle handle =
+        thread.PostDelayedTask(60 * 1000, [resource]() { ++*resource; });
+    resource.reset();
+    EXPECT_FALSE(weak.expired());
+    // 不等到期，闭包捕获的对象在取消时释放
+    handle.Cancel();
+    EXPECT_TRUE(weak.expired());
+    thread.AddTask([&]() { thread.Stop(); });
+    thread.Join();
+}
+
+TEST(ThreadTest, OptionsApplyNameAndAffinity) {
+    std::vector<int> allowed = avrtc::ThreadManager::GetAllowedCpus();
+    ASSERT_FALSE(allowed.empty());
+
+    avrtc::ThreadOptions options;
+    options.name = "avrtc-test-thread-name";
+    options.cpus = {allowed.back()};
+    options.stack_size = 256 * 1024;
+    // 没有权限时只打印警告，线程照常运行
+    options.sched_policy = SCHED_FIFO;
+    options.sched_priority = 10;
+    avrtc::Thread thread(options);
+
+    std::atomic<bool> finished{false};
+    char name[16] = {};
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    thread.AddTask([&]() {
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        sched_getaffinity(0, sizeof(set), &set);
+        finished = true;
+    });
+    while (!finished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    thread.AddTask([&]() { thread.Stop(); });
+    thread.Join();
+
+    EXPECT_STREQ(name, "avrtc-test-thre");
+    EXPECT_EQ(CPU_COUNT(&set), 1);
+    EXPECT_TRUE(CPU_ISSET(allowed.back(), &set));
+}
+
+TEST(ThreadManagerTest, PlanReactorsPinsOnePerCore) {
+    std::vector<int> allowed = avrtc::ThreadManager::GetAllowedCpus();
+    avrtc::ThreadManager::ReactorPolicy policy;
+    policy.name_prefix = "rx";
+    std::vector<avrtc::ThreadOptions> plans =
+        avrtc::ThreadManager::Instance()->PlanReactors(policy);
+    ASSERT_FALSE(plans.empty());
+    EXPECT_LE(plans.size(), allowed.size());
+    std::vector<int> used;
+    for (const auto& options : plans) {
+        ASSERT_EQ(options.cpus.size(), 1u);
+        EXPECT_EQ(options.name, "rx-" + std::to_string(options.cpus[0]));
+        EXPECT_EQ(std::count(used.begin(), used.end(), options.cpus[0]), 0);
+        used.push_back(options.cpus[0]);
+    }
+
+    policy.max_reactors = 1;
+    policy.exclude_cpus = {plans[0].cpus[0]};
+    std::vector<avrtc::ThreadOptions> limited =
+        avrtc::ThreadManager::Instance()->PlanReactors(policy);
+    ASSERT_LE(limited.size(), 1u);
+    if (!limited.empty()) {
+        EXPECT_NE(limited[0].cpus[0], plans[0].cpus[0]);
+    }
+}
+
+TEST(ThreadManagerTest, RegistryTracksCreatedAndDestroyedThreads) {
+    avrtc::ThreadManager* manager = avrtc::ThreadManager::Instance();
+    EXPECT_EQ(manager->CurrentThread(), nullptr);
+    size_t base_count = manager->GetThreadCount();
+    std::vector<std::unique_ptr<avrtc::Thread>> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back(new avrtc::Thread);
+    }
+    EXPECT_EQ(manager->GetThreadCount(), base_count + 4);
+
+    int found = 0;
+    manager->ForEachThread([&](avrtc::Thread* thread) {
+        for (auto& owned : threads) {
+            found += owned.get() == thread;
+        }
+    });
+    EXPECT_EQ(found, 4);
+
+    // 一边枚举一边创建和销毁线程
+    std::atomic<bool> done{false};
+    std::thread enumerator([&]() {
+        while (!done) {
+            manager->ForEachThread([](avrtc::Thread* thread) {
+                thread->GetStats();
+            });
+        }
+    });
+    for (int i = 0; i < 20; ++i) {
+        threads.emplace_back(new avrtc::Thread);
+        threads.erase(threads.begin());
+    }
+    done = true;
+    enumerator.join();
+    EXPECT_EQ(manager->GetThreadCount(), base_count + 4);
+
+    // 停止前投递的任务在退出前执行完，Join()不会一直等待
+    std::atomic<int> executed{0};
+    for (auto& thread : threads) {
+        thread->AddTask([&executed]() { ++executed; });
+    }
+    manager->StopAll(avrtc::Thread::StopMode::kDrainPending);
+    for (auto& thread : threads) {
+        thread->Join();
+    }
+    EXPECT_EQ(executed, 4);
+    threads.clear();
+    EXPECT_EQ(manager->GetThreadCount(), base_count);
+}
+
+TEST(ThreadManagerTest, CallbackCanCreateThreads) {
+    avrtc::ThreadManager* manager = avrtc::ThreadManager::Instance();
+    size_t base_count = manager->GetThreadCount();
+    std::unique_ptr<avrtc::Thread> first(new avrtc::Thread);
+    std::vector<std::unique_ptr<avrtc::Thread>> created;
+    // 回调中创建线程，同时另一个线程销毁线程，销毁方在锁外等待枚举结束
+    std::thread destroyer;
+    manager->ForEachThread([&](avrtc::Thread* thread) {
+        if (thread != first.get()) {
+            return;
+        }
+        created.emplace_back(new avrtc::Thread);
+        destroyer = std::thread([&]() { first.reset(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        created.emplace_back(new avrtc::Thread);
+    });
+    destroyer.join();
+    EXPECT_EQ(first, nullptr);
+    EXPECT_EQ(created.size(), 2u);
+    EXPECT_EQ(manager->GetThreadCount(), base_count + 2);
+    created.clear();
+    EXPECT_EQ(manager->GetThreadCount(), base_count);
+}
+
+TEST(ThreadManagerTest, CallbackCanWaitOnThreadThatDestroysAnother) {
+    avrtc::ThreadManager* manager = avrtc::ThreadManager::Instance();
+    std::unique_ptr<avrtc::Thread> reactor(new avrtc::Thread);
+    std::unique_ptr<avrtc::Thread> room(new avrtc::Thread);
+    avrtc::Thread* room_thread = room.get();
+
+    // 枚举方阻塞在反应器上，反应器销毁房间线程，不需要等这次枚举结束
+    bool room_visited = false;
+    manager->ForEachThread([&](avrtc::Thread* thread) {
+        room_visited |= thread == room_thread;
+        if (thread == reactor.get()) {
+            reactor->BlockingInvoke([&]() { room.reset(); });
+        }
+    });
+    EXPECT_EQ(room, nullptr);
+    // 房间线程排在反应器之后，删除后不再回调
+    EXPECT_FALSE(room_visited);
+}
+
+TEST(ThreadManagerTest, HooksRunOnTheThread) {
+    avrtc::ThreadManager* manager = avrtc::ThreadManager::Instance();
+    std::atomic<int> started{0};
+    std::atomic<int> exited{0};
+    avrtc::ThreadManager::ThreadHooks hooks;
+    hooks.on_start = [&](avrtc::Thread* thread) {
+        EXPECT_TRUE(thread->IsCurrent());
+        EXPECT_EQ(avrtc::ThreadManager::CurrentThread(), thread);
+        ++started;
+    };
+    hooks.on_exit = [&](avrtc::Thread* thread) {
+        EXPECT_TRUE(thread->IsCurrent());
+        ++exited;
+    };
+    int id = manager->AddHooks(hooks);
+    {
+        avrtc::Thread first;
+        avrtc::Thread second;
+        first.BlockingInvoke([]() {});
+        second.BlockingInvoke([]() {});
+        EXPECT_EQ(started, 2);
+    }
+    EXPECT_EQ(exited, 2);
+
+    manager->RemoveHooks(id);
+    { avrtc::Thread thread; }
+    EXPECT_EQ(started, 2);
+    EXPECT_EQ(exited, 2);
+}
+
+TEST(ThreadTest, StopDrainsOrDiscardsPendingTasks) {
+    for (auto mode : {avrtc::Thread::StopMode::kDrainPending,
+                      avrtc::Thread::StopMode::kDiscardPending}) {
+        std::atomic<bool> release{false};
+        std::atomic<int> executed{0};
+        avrtc::Thread thread;
+        thread.AddTask([&]() {
+            while (!release) {
+                std::this_thread::yield();
+            }
+        });
+        for (int i = 0; i < 100; ++i) {
+            thread.AddTask([&]() { ++executed; });
+        }
+        thread.Stop(mode);
+        release = true;
+        thread.Join();
+        EXPECT_EQ(executed,
+                  mode == avrtc::Thread::StopMode::kDrainPending ? 100 : 0);
+        avrtc::ThreadStats stats = thread.GetStats();
+        EXPECT_EQ(stats.queue_depth, 0u);
+        EXPECT_EQ(stats.tasks_posted, 101u);
+    }
+}
+
+TEST(ThreadTest, StopWakesIdleThread) {
+    avrtc::Thread thread;
+    thread.BlockingInvoke([]() {});
+    // 线程已经在futex上无超时睡眠，Stop()必须唤醒它
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    int64_t start = avrtc::EventLoop::NowNs();
+    thread.Stop();
+    thread.Join();
+    EXPECT_LT(avrtc::EventLoop::NowNs() - start, 1000000000);
+    // 重复Join()和析构时的Join()直接返回
+    thread.Join();
+}
+
+TEST(ThreadTest, InvokeReturnsValuesAndExceptions) {
+    avrtc::Thread thread;
+    int counter = 0;
+    EXPECT_EQ(thread.BlockingInvoke([&]() { return ++counter; }), 1);
+    // 在本线程中调用直接执行
+    EXPECT_EQ(thread.BlockingInvoke([&]() {
+        return thread.BlockingInvoke([&]() { return ++counter; }) * 10;
+    }),
+              20);
+    thread.BlockingInvoke([&]() { EXPECT_TRUE(thread.IsCurrent()); });
+    EXPECT_FALSE(thread.IsCurrent());
+
+    std::future<std::string> text =
+        thread.InvokeAsync([]() { return std::string("stats"); });
+    EXPECT_EQ(text.get(), "stats");
+    std::future<int> failed =
+        thread.InvokeAsync([]() -> int { throw std::runtime_error("x"); });
+    EXPECT_THROW(failed.get(), std::runtime_error);
+
+    // 停止后投递的任务直接析构，future立即报告broken_promise
+    thread.Stop();
+    std::future<void> dropped = thread.InvokeAsync([]() {});
+    try {
+        dropped.get();
+        ADD_FAILURE() << "Expected broken_promise";
+    } catch (const std::future_error& e) {
+        EXPECT_EQ(e.code(), std::future_errc::broken_promise);
+    }
+    thread.Join();
+}
+
+TEST(ThreadTest, ExitDestroysPendingAndDelayedTasks) {
+    std::future<int> queued;
+    std::future<int> delayed;
+    {
+        avrtc::Thread thread;
+        std::atomic<bool> release{false};
+        thread.AddTask([&]() {
+            while (!release) {
+                std::this_thread::yield();
+            }
+        });
+        queued = thread.InvokeAsync([]() { return 1; });
+        std::promise<int> promise;
+        delayed = promise.get_future();
+        thread.PostDelayedTask(
+            60 * 1000,
+            [promise = std::move(promise)]() mutable { promise.set_value(2); });
+        thread.Stop();
+        release = true;
+        // 线程退出时析构队列中的任务和延迟任务，不必等Thread析构
+        thread.Join();
+        for (std::future<int>* future : {&queued, &delayed}) {
+            EXPECT_EQ(future->wait_for(std::chrono::milliseconds(0)),
+                      std::future_status::ready);
+        }
+    }
+    for (std::future<int>* future : {&queued, &delayed}) {
+        try {
+            future->get();
+            ADD_FAILURE() << "Expected broken_promise";
+        } catch (const std::future_error& e) {
+            EXPECT_EQ(e.code(), std::future_errc::broken_promise);
+        }
+    }
+}
+
+namespace {
+
+avrtc::Location Caller(avrtc::Location from = avrtc::Location::Current()) {
+    return from;
+}
+
+}  // namespace
+
+TEST(ThreadMetricsTest, LocationAndHistogram) {
+    avrtc::Location from = Caller();
+    EXPECT_EQ(from.line, __LINE__ - 1);
+    EXPECT_EQ(from.ToString(), "thread.cc:" + std::to_string(from.line));
+
+    EXPECT_EQ(avrtc::LatencyHistogram::GetBucket(500), 0);
+    EXPECT_EQ(avrtc::LatencyHistogram::GetBucket(1000), 1);
+    EXPECT_EQ(avrtc::LatencyHistogram::GetBucket(3999), 2);
+    EXPECT_EQ(avrtc::LatencyHistogram::GetBucket(int64_t(1) << 62),
+              avrtc::LatencyHistogram::kBuckets - 1);
+
+    avrtc::LatencyHistogram histogram;
+    for (int i = 0; i < 99; ++i)
+        histogram.Record(10 * 1000);
+    histogram.Record(5 * 1000 * 1000);
+    avrtc::LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+    EXPECT_EQ(snapshot.GetTotal(), 100u);
+    EXPECT_EQ(snapshot.GetPercentileUs(50), 16);
+    EXPECT_EQ(snapshot.GetPercentileUs(100), 8192);
+}
+
+TEST(ThreadMetricsTest, StatsCountTasksAndLongTasks) {
+    avrtc::ThreadOptions options;
+    options.name = "metrics";
+    options.long_task_threshold_ms = 5;
+    avrtc::Thread thread(options);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    thread.AddTask(
+        []() { std::this_thread::sleep_for(std::chrono::milliseconds(10)); });
+    for (int i = 0; i < 10; ++i) {
+        thread.AddTask([]() {});
+    }
+    avrtc::ThreadStats stats = thread.BlockingInvoke(
+        [&]() { return thread.GetStats(); });
+
+    // BlockingInvoke自己的任务正在执行，还没有计入执行时间
+    EXPECT_EQ(stats.tasks_posted, 12u);
+    EXPECT_EQ(stats.tasks_run, 12u);
+    EXPECT_EQ(stats.queue_depth, 0u);
+    EXPECT_EQ(stats.long_tasks, 1u);
+    EXPECT_EQ(stats.run_time.GetTotal(), 11u);
+    EXPECT_EQ(stats.queue_latency.GetTotal(), 11u);
+    EXPECT_GE(stats.busy_ns, 10 * 1000000);
+    EXPECT_GT(stats.idle_ns, 0);
+    EXPECT_GT(stats.busy_ratio, 0);
+    EXPECT_LT(stats.busy_ratio, 1);
+}
+
+TEST(ThreadMetricsTest, LoopTaskIsNotTimed) {
+    avrtc::ThreadOptions options;
+    options.long_task_threshold_ms = 5;
+    avrtc::Thread thread(options);
+    avrtc::EventLoop loop;
+    // 定时器要在运行循环的线程中添加
+    thread.AddTask([&loop]() {
+        loop.RunAfter(10, [&loop]() { loop.Stop(); });
+        loop.Run();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    // 事件循环运行了10ms以上，按循环任务统计，不计为慢任务
+    avrtc::ThreadStats stats = thread.BlockingInvoke(
+        [&]() { return thread.GetStats(); });
+    EXPECT_EQ(stats.tasks_run, 2u);
+    EXPECT_EQ(stats.long_tasks, 0u);
+    EXPECT_EQ(stats.run_time.GetTotal(), 0u);
+    EXPECT_LT(stats.busy_ns, 5 * 1000000);
+}
+
+namespace {
+
+/**
+ * 阻塞线程直到Release()，期间投递的任务都在队列中等待
+ */
+class Gate {
+   public:
+    explicit Gate(avrtc::Thread* thread) {
+        thread->AddTask([this]() {
+            while (!released_) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    void Release() { released_ = true; }
+
+   private:
+    std::atomic<bool> released_{false};
+};
+
+/**
+ * 按执行顺序记录任务名，Wait()等待记录到指定个数
+ */
+class OrderRecorder {
+   public:
+    avrtc::Task Record(const std::string& name) {
+        return [this, name]() {
+            order_.push_back(name);
+            ++count_;
+        };
+    }
+    const std::vector<std::string>& Wait(size_t count) {
+        while (count_ < count) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return order_;
+    }
+
+   private:
+    std::vector<std::string> order_;
+    std::atomic<size_t> count_{0};
+};
+
+}  // namespace
+
+TEST(ThreadPriorityTest, HigherClassesRunFirst) {
+    avrtc::Thread thread;
+    OrderRecorder recorder;
+    Gate gate(&thread);
+    thread.PostTask(avrtc::TaskPriority::kBackground,
+                    recorder.Record("background"));
+    thread.AddTask(recorder.Record("normal"));
+    thread.PostTask(avrtc::TaskPriority::kRealtime,
+                    recorder.Record("realtime1"));
+    thread.PostTask(avrtc::TaskPriority::kRealtime,
+                    recorder.Record("realtime2"));
+    gate.Release();
+
+    EXPECT_EQ(recorder.Wait(4),
+              std::vector<std::string>(
+                  {"realtime1", "realtime2", "normal", "background"}));
+}
+
+TEST(ThreadPriorityTest, StarvationLimitLetsLowerClassRun) {
+    avrtc::ThreadOptions options;
+    options.starvation_limit = 4;
+    avrtc::Thread thread(options);
+    OrderRecorder recorder;
+    Gate gate(&thread);
+    thread.PostTask(avrtc::TaskPriority::kBackground,
+                    recorder.Record("background"));
+    for (int i = 0; i < 10; ++i) {
+        thread.PostTask(avrtc::TaskPriority::kRealtime,
+                        recorder.Record(std::to_string(i)));
+    }
+    gate.Release();
+
+    EXPECT_EQ(recorder.Wait(11)[4], "background");
+}
+
+TEST(ThreadPriorityTest, DueDeadlinePreemptsHigherClasses) {
+    avrtc::Thread thread;
+    OrderRecorder recorder;
+    Gate gate(&thread);
+    for (int i = 0; i < 3; ++i) {
+        thread.PostTask(avrtc::TaskPriority::kRealtime,
+                        recorder.Record("realtime"));
+    }
+    // 截止时间很远的任务仍然按类别排队
+    thread.PostTaskWithDeadline(avrtc::TaskPriority::kBackground, 10000,
+                                recorder.Record("relaxed"));
+    thread.PostTaskWithDeadline(avrtc::TaskPriority::kBackground, 0,
+                                recorder.Record("flush"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    gate.Release();
+
+    // 类别内先进先出，截止时间已到的任务排在relaxed之后，只能随它一起提前
+    EXPECT_EQ(recorder.Wait(5),
+              std::vector<std::string>(
+                  {"realtime", "realtime", "realtime", "relaxed", "flush"}));
+
+    avrtc::Thread urgent_thread;
+    OrderRecorder urgent;
+    Gate urgent_gate(&urgent_thread);
+    for (int i = 0; i < 3; ++i) {
+        urgent_thread.PostTask(avrtc::TaskPriority::kRealtime,
+                               urgent.Record("realtime"));
+    }
+    urgent_thread.PostTaskWithDeadline(avrtc::TaskPriority::kBackground, 0,
+                                       urgent.Record("flush"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    urgent_gate.Release();
+    EXPECT_EQ(urgent.Wait(4),
+              std::vector<std::string>(
+                  {"flush", "realtime", "realtime", "realtime"}));
+
+    avrtc::ThreadStats stats = urgent_thread.GetStats();
+    const avrtc::TaskClassStats& background =
+        stats.classes[static_cast<int>(avrtc::TaskPriority::kBackground)];
+    const avrtc::TaskClassStats& realtime =
+        stats.classes[static_cast<int>(avrtc::TaskPriority::kRealtime)];
+    EXPECT_EQ(background.tasks_run, 1u);
+    EXPECT_EQ(background.deadline_misses, 1u);
+    EXPECT_EQ(realtime.tasks_posted, 3u);
+    EXPECT_EQ(realtime.tasks_run, 3u);
+    EXPECT_EQ(realtime.deadline_misses, 0u);
+}
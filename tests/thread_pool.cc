@@ -0,0 +1,186 @@
+#include "base/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "base/work_stealing_deque.h"
+#include "gtest/gtest.h"
+
+TEST(WorkStealingDequeTest, OwnerAndThievesTakeEachElementOnce) {
+    avrtc::WorkStealingDeque<int*> deque(4);
+    const int kCount = 100000;
+    std::vector<int> values(kCount);
+    std::vector<std::atomic<int>> taken(kCount);
+    std::atomic<bool> done{false};
+    std::atomic<int> total{0};
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t) {
+        thieves.emplace_back([&]() {
+            int* value = nullptr;
+            while (!done || !deque.Empty()) {
+                if (deque.Steal(&value)) {
+                    ++taken[value - values.data()];
+                    ++total;
+                }
+            }
+        });
+    }
+    // 所有者交替放入和取出，队列会多次扩容
+    int* value = nullptr;
+    for (int i = 0; i < kCount; ++i) {
+        deque.Push(&values[i]);
+        if (i % 3 == 0 && deque.Pop(&value)) {
+            ++taken[value - values.data()];
+            ++total;
+        }
+    }
+    while (deque.Pop(&value)) {
+        ++taken[value - values.data()];
+        ++total;
+    }
+    done = true;
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+    EXPECT_EQ(total, kCount);
+    for (int i = 0; i < kCount; ++i) {
+        ASSERT_EQ(taken[i], 1) << i;
+    }
+}
+
+TEST(ThreadPoolTest, RunsTasksFromInsideAndOutside) {
+    avrtc::ThreadPool pool(4);
+    std::atomic<int> executed{0};
+    for (int i = 0; i < 100; ++i) {
+        pool.Post([&pool, &executed]() {
+            EXPECT_EQ(avrtc::ThreadPool::Current(), &pool);
+            // 工作线程中投递的任务放入本线程队列，可以被其他线程窃取
+            for (int j = 0; j < 10; ++j) {
+                pool.Post([&executed]() { ++executed; });
+            }
+            ++executed;
+        });
+    }
+    while (executed < 1100) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(avrtc::ThreadPool::Current(), nullptr);
+}
+
+TEST(ThreadPoolTest, DefaultWorkerCountIsBounded) {
+    size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    size_t expected = cpus < avrtc::ThreadPool::kMaxWorkers
+                          ? cpus
+                          : avrtc::ThreadPool::kMaxWorkers;
+    EXPECT_EQ(avrtc::ThreadPool::GetDefaultWorkerCount(), expected);
+    avrtc::ThreadPool pool;
+    EXPECT_EQ(pool.GetWorkerCount(), expected);
+}
+
+TEST(ThreadPoolTest, WorkersReportIdleTime) {
+    avrtc::ThreadPool pool(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::promise<avrtc::ThreadStats> result;
+    pool.Post([&result]() {
+        result.set_value(avrtc::ThreadManager::CurrentThread()->GetStats());
+    });
+    avrtc::ThreadStats stats = result.get_future().get();
+    // 工作循环本身不计入忙碌时间，睡眠计入空闲时间
+    EXPECT_GE(stats.idle_ns, 5 * 1000000);
+    EXPECT_LT(stats.busy_ratio, 0.5);
+    EXPECT_EQ(stats.long_tasks, 0u);
+}
+
+TEST(ThreadPoolTest, CurrentThreadInsidePoolTask) {
+    avrtc::ThreadPool pool(2);
+    std::atomic<int> executed{0};
+    pool.Post([&executed]() {
+        avrtc::Thread* thread =
+            avrtc::ThreadManager::Instance()->CurrentThread();
+        std::thread::id id = std::this_thread::get_id();
+        // 投递给工作线程Thread的任务在同一个工作线程中执行
+        thread->AddTask([&executed, id]() {
+            EXPECT_EQ(std::this_thread::get_id(), id);
+            ++executed;
+        });
+        thread->PostDelayedTask(5, [&executed, id]() {
+            EXPECT_EQ(std::this_thread::get_id(), id);
+            ++executed;
+        });
+    });
+    while (executed < 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+    avrtc::ThreadPool pool(4);
+    const size_t kCount = 10000;
+    std::vector<std::atomic<int>> visits(kCount);
+    pool.ParallelFor(0, kCount, [&](size_t i) { ++visits[i]; }, 16);
+    for (size_t i = 0; i < kCount; ++i) {
+        ASSERT_EQ(visits[i], 1) << i;
+    }
+
+    // 在工作线程中嵌套调用不会死锁
+    std::atomic<int> nested{0};
+    std::atomic<bool> finished{false};
+    pool.Post([&]() {
+        pool.ParallelFor(0, 8, [&](size_t) {
+            pool.ParallelFor(0, 100, [&](size_t) { ++nested; });
+        });
+        finished = true;
+    });
+    while (!finished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(nested, 800);
+}
+
+TEST(ThreadPoolTest, StrandKeepsOrderWithoutOverlap) {
+    avrtc::ThreadPool pool(4);
+    const int kStrands = 8;
+    const int kTasks = 2000;
+    std::vector<std::shared_ptr<avrtc::Strand>> strands;
+    std::vector<std::vector<int>> orders(kStrands);
+    std::vector<std::atomic<int>> running(kStrands);
+    std::atomic<bool> overlapped{false};
+    std::atomic<int> executed{0};
+    for (int s = 0; s < kStrands; ++s) {
+        strands.push_back(pool.CreateStrand());
+    }
+
+    std::vector<std::thread> producers;
+    for (int s = 0; s < kStrands; ++s) {
+        producers.emplace_back([&, s]() {
+            for (int i = 0; i < kTasks; ++i) {
+                strands[s]->Post([&, s, i]() {
+                    if (running[s].fetch_add(1) != 0) {
+                        overlapped = true;
+                    }
+                    orders[s].push_back(i);
+                    running[s].fetch_sub(1);
+                    ++executed;
+                });
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    while (executed < kStrands * kTasks) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_FALSE(overlapped);
+    for (int s = 0; s < kStrands; ++s) {
+        ASSERT_EQ(orders[s].size(), static_cast<size_t>(kTasks));
+        for (int i = 0; i < kTasks; ++i) {
+            ASSERT_EQ(orders[s][i], i);
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#include "base/zerocopy.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/socket.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// 建立一对回环TCP连接，返回客户端fd，服务端fd写入peer_fd
+int ConnectLoopback(int* peer_fd) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    avrtc::SocketAddress address("127.0.0.1", 0);
+    bind(listen_fd, address.GetSockAddr(), address.GetSockLen());
+    listen(listen_fd, 1);
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    getsockname(listen_fd, (struct sockaddr*)&local, &len);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    connect(fd, (struct sockaddr*)&local, len);
+    *peer_fd = accept(listen_fd, nullptr, nullptr);
+    close(listen_fd);
+    return fd;
+}
+
+size_t DrainPeer(int fd) {
+    size_t total = 0;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        total += n;
+    }
+    return total;
+}
+
+}  // namespace
+
+TEST(ZeroCopyTest, SessionSocketReleasesBuffersOnCompletion) {
+    int peer_fd;
+    int fd = ConnectLoopback(&peer_fd);
+    ASSERT_NE(peer_fd, -1);
+    auto session = std::make_shared<avrtc::SessionSocket>(
+        fd, avrtc::SocketAddress("127.0.0.1", 0));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    if (!session->EnableZeroCopy(16 * 1024)) {
+        close(peer_fd);
+        GTEST_SKIP() << "MSG_ZEROCOPY is not supported";
+    }
+
+    avrtc::EventLoop loop;
+    avrtc::SessionSocket* raw = session.get();
+    loop.AddFD(fd, EPOLLIN, [raw](uint32_t events) {
+        if (events & EPOLLERR)
+            raw->HandleErrorQueue();
+        if (events & EPOLLOUT)
+            raw->HandleWrite();
+    });
+    session->AttachLoop(&loop);
+
+    // 发送方不再持有引用，缓冲区只由发送队列和零拷贝跟踪保留
+    std::vector<std::weak_ptr<const std::string>> sent_buffers;
+    size_t sent = 0;
+    for (int i = 0; i < 8; ++i) {
+        auto message = std::make_shared<const std::string>(64 * 1024, 'a' + i);
+        sent_buffers.push_back(message);
+        ASSERT_EQ(session->Send(std::move(message)), 64 * 1024);
+        sent += avrtc::FrameCodec::kHeaderSize + 64 * 1024;
+    }
+
+    size_t received = 0;
+    for (int i = 0; i < 1000 && (received < sent ||
+                                 session->GetZeroCopyPending() > 0);
+         ++i) {
+        received += DrainPeer(peer_fd);
+        loop.RunOnce(10);
+    }
+    EXPECT_EQ(received, sent);
+    EXPECT_EQ(session->GetQueuedBytes(), 0);
+    EXPECT_EQ(session->GetZeroCopyPending(), 0);
+    for (auto& buffer : sent_buffers) {
+        EXPECT_TRUE(buffer.expired());
+    }
+
+    loop.RemoveFD(fd);
+    close(peer_fd);
+}
+
+TEST(ZeroCopyTest, UdpSendTo) {
+    avrtc::UdpSocket sender(avrtc::SocketAddress("127.0.0.1", 0));
+    avrtc::UdpSocket receiver(avrtc::SocketAddress("127.0.0.1", 0));
+    ASSERT_TRUE(sender.Bind());
+    ASSERT_TRUE(receiver.Bind());
+    if (!sender.EnableZeroCopy(1024)) {
+        GTEST_SKIP() << "MSG_ZEROCOPY is not supported";
+    }
+
+    auto datagram = std::make_shared<const std::string>(32 * 1024, 'x');
+    std::weak_ptr<const std::string> weak = datagram;
+    ASSERT_EQ(sender.SendTo(std::move(datagram), receiver.address_),
+              32 * 1024);
+    // 小于阈值的数据报走普通发送，不需要等待完成通知
+    auto small = std::make_shared<const std::string>(100, 'y');
+    ASSERT_EQ(sender.SendTo(small, receiver.address_), 100);
+
+    std::vector<char> buffer(64 * 1024);
+    EXPECT_EQ(receiver.RecvFrom(buffer.data(), buffer.size(), nullptr),
+              32 * 1024);
+    EXPECT_EQ(receiver.RecvFrom(buffer.data(), buffer.size(), nullptr), 100);
+
+    sender.SetNonBlocking();
+    for (int i = 0; i < 100 && sender.GetZeroCopyPending() > 0; ++i) {
+        sender.HandleErrorQueue();
+        if (sender.GetZeroCopyPending() > 0)
+            usleep(1000);
+    }
+    EXPECT_EQ(sender.GetZeroCopyPending(), 0);
+    EXPECT_TRUE(weak.expired());
+}